@@ -157,6 +157,7 @@ enum {
 	GL_MAX_DISPLAY_LISTS = 0xf006,
 	GL_ERROR_CHECK_LEVEL = 0xf007,
 	GL_IS_SPECULAR_ENABLED = 0xf008,
+	GL_IS_TEXTURE_TILES_ENABLED = 0xf009,
 	
 	/* Depth buffer */
 	GL_NEVER			= 0x0200,
@@ -665,7 +666,11 @@ enum {
 	GL_COLOR_ARRAY_POINTER_EXT	= 0x8090,
 	GL_INDEX_ARRAY_POINTER_EXT	= 0x8091,
 	GL_TEXTURE_COORD_ARRAY_POINTER_EXT= 0x8092,
-	GL_EDGE_FLAG_ARRAY_POINTER_EXT	= 0x8093
+	GL_EDGE_FLAG_ARRAY_POINTER_EXT	= 0x8093,
+
+	/* GL_EXT_paletted_texture */
+	GL_COLOR_INDEX4_EXT		= 0x80E4,
+	GL_COLOR_INDEX8_EXT		= 0x80E5
 
 };
 
@@ -800,6 +805,7 @@ void* glGetTexturePixmap(GLint text, GLint level, GLint* xsize, GLint* ysize);
 void glDrawText(const GLubyte* text, GLint x, GLint y, GLuint pixel); 
 void glTextSize(GLTEXTSIZE mode); 
 void glPlotPixel(GLint x, GLint y, GLuint pixel); 
+void glSetGuardBand(GLint pixels); 
 
 #define PROTO_GL1(name)				\
 void gl ## name ## 1f(GLfloat);	\
@@ -905,6 +911,8 @@ void glCopyTexImage2D(	GLenum target,
 					 	GLsizei width,
 					 	GLsizei height,
 					 	GLint border);
+void glColorTableEXT(GLenum target, GLenum internalformat, GLsizei width,
+		     GLenum format, GLenum type, const void *table);
 void glTexEnvi(GLint target,GLint pname,GLint param);
 
 void glTexParameteri(GLint target,GLint pname,GLint param);
@@ -939,6 +947,7 @@ void glFrontFace(GLint mode);
 void glEnableClientState(GLenum array);
 void glDisableClientState(GLenum array);
 void glArrayElement(GLint i);
+void glDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices);
 void glVertexPointer(GLint size, GLenum type, GLsizei stride, 
                      const GLvoid *pointer);
 void glColorPointer(GLint size, GLenum type, GLsizei stride, 
@@ -1009,6 +1018,33 @@ void glDebug(GLint mode);
 
 void glInit(void *zbuffer);
 void glClose(void);
+/*
+ * Creates a context rendering to zbuffer, which no other context may render to at the same time. With share_context,
+ * display lists, textures and buffers are shared with it, creating and deleting them must then be serialized by the
+ * application, and so must creating and destroying the contexts which share them. Returns NULL if out of memory.
+ * The current context of the calling thread doesn't change. Needs TGL_FEATURE_MULTI_CONTEXT.
+ */
+void *glCreateContext(void *zbuffer, void *share_context);
+/* Makes context the current context of the calling thread. NULL, the default, is the glInit() context. */
+void glMakeCurrent(void *context);
+void *glGetCurrentContext(void);
+/* Destroys context, the shared objects with it once no other context shares them. See glCreateContext(). */
+void glDestroyContext(void *context);
+/*
+ * Starts (enable set) or stops a thread executing the ops of the current context, which the gl calls then only
+ * queue. Call glFinish() before reading the zbuffer directly, with ZB_copyFrameBuffer() for instance.
+ */
+void glSetRenderThread(GLint enable);
+/*
+ * Returns how many ops the list held when glEndList() was called, and how many are left after the list optimizer.
+ * Both are 0 for a list which isn't defined.
+ */
+void glGetListOpCounts(GLuint list, GLint* compiled, GLint* optimized);
+/*
+ * Textures whose images are specified while s is set are stored in 4x4 texel tiles, which turned triangles sample with
+ * fewer cache misses, instead of rows. glGetTexturePixmap() returns their pixmaps as they are stored.
+ */
+void glSetTextureTiles(GLint s);
 
 #ifdef __cplusplus
 }
@@ -188,7 +188,9 @@ void glPolygonMode(GLint face, GLint mode) {
 
 void glDepthMask(GLint i) {
 #include "error_check_no_context.h"
+	gl_render_sync();
 	gl_get_context()->zb->depth_write = (i == GL_TRUE);
+	gl_get_context()->fill_funcs_dirty = 1;
 }
 /* glEnable / glDisable */
 /* TODO go to glopEnableDisable and add error checking there on values there.*/
@@ -239,6 +241,8 @@ void glEnd(void) {
 	p[0].op = OP_End;
 
 	gl_add_op(p);
+	/* the application may change its arrays once glEnd() returns */
+	gl_render_sync_arrays();
 }
 
 /* matrix */
@@ -510,6 +514,8 @@ void glTexImage2D(GLint target, GLint level, GLint components, GLint width, GLin
 	p[9].p = pixels;
 
 	gl_add_op(p);
+	/* pixels is only read when the op is executed */
+	gl_render_sync();
 }
 
 void glTexImage1D(GLint target, GLint level, GLint components, GLint width, GLint border, GLint format, GLint type, void* pixels) {
@@ -525,6 +531,22 @@ void glTexImage1D(GLint target, GLint level, GLint components, GLint width, GLin
 	p[7].i = type;
 	p[8].p = pixels;
 	gl_add_op(p);
+	gl_render_sync();
+}
+
+void glColorTableEXT(GLenum target, GLenum internalformat, GLsizei width, GLenum format, GLenum type, const void* table) {
+	GLParam p[7];
+#include "error_check_no_context.h"
+	p[0].op = OP_ColorTable;
+	p[1].i = target;
+	p[2].i = internalformat;
+	p[3].i = width;
+	p[4].i = format;
+	p[5].i = type;
+	p[6].p = (void*)table;
+	gl_add_op(p);
+	/* table is only read when the op is executed */
+	gl_render_sync();
 }
 
 void glBindTexture(GLint target, GLint texture) {
@@ -632,7 +654,12 @@ void glCallList(GLuint list) {
 
 	gl_add_op(p);
 }
-void glFlush(void) { /* nothing to do */
+void glFlush(void) {
+	/* the tiled and band rasterizers draw everything binned so far */
+	ZBuffer* zb = gl_get_context()->zb;
+	gl_render_sync();
+	ZB_flushTiles(zb);
+	ZB_renderBands(zb);
 }
 
 void glHint(GLint target, GLint mode) {
@@ -644,5 +671,6 @@ void glHint(GLint target, GLint mode) {
 void glDebug(GLint mode) {
 	GLContext* c = gl_get_context();
 #include "error_check.h"
+	gl_render_sync();
 	c->print_flag = mode;
 }
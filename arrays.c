@@ -54,6 +54,7 @@ static GLint check_buffer(GLint handle) {
 	return 0;
 }
 GLboolean glIsBuffer(GLuint buffer) {
+	gl_render_sync();
 	if (check_buffer(buffer) == 1)
 		return GL_TRUE;
 	return GL_FALSE;
@@ -98,6 +99,7 @@ void glGenBuffers(GLsizei n, GLuint* buffers) {
 	GLint i;
 	GLContext* c = gl_get_context();
 #include "error_check.h"
+	gl_render_sync();
 	if (n > MAX_BUFFERS)
 		goto error;
 
@@ -128,6 +130,7 @@ void glDeleteBuffers(GLsizei n, const GLuint* buffers) {
 	GLint i;
 	GLContext* c = gl_get_context();
 #include "error_check.h"
+	gl_render_sync();
 	for (i = 0; i < n; i++)
 		free_buffer(buffers[i]);
 }
@@ -136,6 +139,7 @@ void glDeleteBuffers(GLsizei n, const GLuint* buffers) {
 void glBindBuffer(GLenum target, GLuint buffer) {
 	GLContext* c = gl_get_context();
 #include "error_check.h"
+	gl_render_sync();
 	if (buffer == 0 || check_buffer(buffer) == 1) {
 		if (target == GL_ARRAY_BUFFER)
 			c->boundarraybuffer = buffer;
@@ -149,6 +153,7 @@ void glBindBufferAsArray(GLenum target, GLuint buffer,
 						 GLint stride) { 
 	GLContext* c = gl_get_context();
 #include "error_check.h"
+	gl_render_sync();
 	if (target != GL_VERTEX_BUFFER && target != GL_NORMAL_BUFFER && target != GL_COLOR_BUFFER && target != GL_TEXTURE_COORD_BUFFER) {
 #if TGL_FEATURE_ERROR_CHECK == 1
 #define ERROR_FLAG GL_INVALID_ENUM
@@ -237,6 +242,7 @@ void* glMapBuffer(GLenum target, GLenum access) {
 	GLContext* c = gl_get_context();
 #define RETVAL NULL
 #include "error_check.h"
+	gl_render_sync();
 	GLint handle = 0;
 	if (target == GL_ARRAY_BUFFER)
 		handle = c->boundarraybuffer;
@@ -265,6 +271,7 @@ void glBufferData(GLenum target, GLsizei size, const void* data,
 {
 	GLContext* c = gl_get_context();
 #include "error_check.h"
+	gl_render_sync();
 	GLint handle = 0;
 	GLBuffer* buf = NULL;
 	if (target == GL_ARRAY_BUFFER)
@@ -307,11 +314,10 @@ void glBufferData(GLenum target, GLsizei size, const void* data,
 		memcpy(buf->data, data, size);
 }
 
-void glopArrayElement(GLParam* param) {
+/* Sets the current color, normal and texture coordinates of the enabled arrays' element idx. */
+static void gl_array_attribs(GLContext* c, GLint idx) {
 	GLint i;
-	GLContext* c = gl_get_context();
 	GLint states = c->client_states;
-	GLint idx = param[1].i;
 
 	if (states & COLOR_ARRAY) {
 		GLParam p[5];
@@ -338,7 +344,15 @@ void glopArrayElement(GLParam* param) {
 		c->current_tex_coord.Z = (size > 2) ? c->texcoord_array[i + 2] : 0.0f;
 		c->current_tex_coord.W = (size > 3) ? c->texcoord_array[i + 3] : 1.0f;
 	}
-	if (states & VERTEX_ARRAY) {
+}
+
+void glopArrayElement(GLParam* param) {
+	GLint i;
+	GLContext* c = gl_get_context();
+	GLint idx = param[1].i;
+
+	gl_array_attribs(c, idx);
+	if (c->client_states & VERTEX_ARRAY) {
 		GLParam p[5];
 		GLint size = c->vertex_array_size;
 		i = idx * (size + c->vertex_array_stride);
@@ -350,6 +364,104 @@ void glopArrayElement(GLParam* param) {
 	}
 }
 
+/* Returns the index i of an array of GL_UNSIGNED_BYTE, GL_UNSIGNED_SHORT or GL_UNSIGNED_INT indices. */
+static GLint gl_array_index(GLenum type, const void* indices, GLint i) {
+	switch (type) {
+	case GL_UNSIGNED_BYTE:
+		return ((const GLubyte*)indices)[i];
+	case GL_UNSIGNED_SHORT:
+		return ((const GLushort*)indices)[i];
+	default:
+		return ((const GLuint*)indices)[i];
+	}
+}
+
+void glopDrawElements(GLParam* p) {
+	GLContext* c = gl_get_context();
+	GLVertexCacheEntry* cache = c->vertex_cache;
+	GLVertexBlock* b = &c->vertex_block;
+	GLVertexCacheEntry* entry[TGL_VERTEX_CACHE_SIZE];
+	GLint lane[TGL_VERTEX_CACHE_SIZE];
+	GLVertexCacheEntry* e;
+	GLint count = p[2].i, type = p[3].i;
+	const void* indices = p[4].p;
+	GLint i, j, k, m, n, idx, size, shade;
+	GLParam q[2];
+
+	/* the block is lit together, unless the colors of the elements change the material */
+	shade = c->lighting_enabled && !(c->color_material_enabled && (c->client_states & COLOR_ARRAY));
+	q[1].i = p[1].i;
+	glopBegin(q);
+	if (!(c->client_states & VERTEX_ARRAY)) {
+		/* nothing is drawn, but the attributes of the last element are current */
+		for (i = 0; i < count; i++)
+			gl_array_attribs(c, gl_array_index(type, indices, i));
+		glopEnd(q);
+		return;
+	}
+	/*
+	 * An element used again while still in the cache is copied from it as it was transformed and lit. The attributes
+	 * then don't become current, which OpenGL allows: they are undefined after glDrawElements().
+	 */
+	for (i = 0; i < TGL_VERTEX_CACHE_SIZE; i++)
+		cache[i].index = -1;
+	size = c->vertex_array_size;
+	for (i = 0; i < count; i += n) {
+		/*
+		 * The elements missing from the cache are transformed together, up to TGL_VERTEX_BLOCK of them, and take their
+		 * entries when they are drawn. So a block of elements ends before one would take an entry which one of the
+		 * elements before it uses.
+		 */
+		m = 0;
+		for (n = 0; n < TGL_VERTEX_CACHE_SIZE && i + n < count; n++) {
+			idx = gl_array_index(type, indices, i + n);
+			e = &cache[idx & (TGL_VERTEX_CACHE_SIZE - 1)];
+			lane[n] = -1;
+			if (e->index != idx) {
+				if (m == TGL_VERTEX_BLOCK)
+					break;
+				for (k = 0; k < n && entry[k] != e; k++)
+					;
+				if (k < n)
+					break;
+				e->index = idx;
+				j = idx * (size + c->vertex_array_stride);
+				b->x[m] = c->vertex_array[j];
+				b->y[m] = c->vertex_array[j + 1];
+				b->z[m] = (size > 2) ? c->vertex_array[j + 2] : 0.0f;
+				if (c->client_states & NORMAL_ARRAY) {
+					j = idx * (3 + c->normal_array_stride);
+					b->nx[m] = c->normal_array[j];
+					b->ny[m] = c->normal_array[j + 1];
+					b->nz[m] = c->normal_array[j + 2];
+				} else {
+					b->nx[m] = c->current_normal.X;
+					b->ny[m] = c->current_normal.Y;
+					b->nz[m] = c->current_normal.Z;
+				}
+				lane[n] = m++;
+			}
+			entry[n] = e;
+		}
+		if (m > 0) {
+			gl_vertex_transform_block(b, m);
+			if (shade)
+				gl_shade_block(b, m);
+		}
+		for (k = 0; k < n; k++) {
+			e = entry[k];
+			if (lane[k] >= 0) {
+				gl_array_attribs(c, e->index);
+				gl_vertex_from_block(&e->v, b, lane[k]);
+#include "error_check.h"
+			}
+			c->vertex[c->vertex_n] = e->v;
+			gl_vertex_assemble();
+		}
+	}
+	glopEnd(q);
+}
+
 void glArrayElement(GLint i) {
 	GLParam p[2];
 #include "error_check_no_context.h"
@@ -358,16 +470,128 @@ void glArrayElement(GLint i) {
 	gl_add_op(p);
 }
 
+void glopDrawArrays(GLParam* p) {
+	GLContext* c = gl_get_context();
+	GLint states = c->client_states;
+	GLint first = p[2].i, count = p[3].i;
+	GLint vsize = c->vertex_array_size, csize = c->color_array_size, tsize = c->texcoord_array_size;
+	GLint vstep = vsize + c->vertex_array_stride, cstep = csize + c->color_array_stride;
+	GLint nstep = 3 + c->normal_array_stride, tstep = tsize + c->texcoord_array_stride;
+	GLfloat *vp = NULL, *cp = NULL, *np = NULL, *tp = NULL;
+	GLVertexBlock* b = &c->vertex_block;
+	GLParam q[5];
+	GLint i, k, n, shade;
+
+	/* the block is lit together, unless the colors of the vertices change the material */
+	shade = c->lighting_enabled && !(c->color_material_enabled && (states & COLOR_ARRAY));
+	/* the arrays are walked with pointers, which are only set up for the enabled ones */
+	if (states & VERTEX_ARRAY)
+		vp = c->vertex_array + first * vstep;
+	if (states & COLOR_ARRAY)
+		cp = c->color_array + first * cstep;
+	if (states & NORMAL_ARRAY)
+		np = c->normal_array + first * nstep;
+	if (states & TEXCOORD_ARRAY)
+		tp = c->texcoord_array + first * tstep;
+
+	q[1].i = p[1].i;
+	glopBegin(q);
+	for (i = 0; i < count; i += n) {
+		n = (count - i < TGL_VERTEX_BLOCK) ? count - i : TGL_VERTEX_BLOCK;
+		/* the block's coordinates and normals are transformed together, then its vertices are lit */
+		if (vp != NULL) {
+			for (k = 0; k < n; k++) {
+				b->x[k] = vp[0];
+				b->y[k] = vp[1];
+				b->z[k] = (vsize > 2) ? vp[2] : 0.0f;
+				vp += vstep;
+				if (np != NULL) {
+					b->nx[k] = np[k * nstep];
+					b->ny[k] = np[k * nstep + 1];
+					b->nz[k] = np[k * nstep + 2];
+				} else {
+					b->nx[k] = c->current_normal.X;
+					b->ny[k] = c->current_normal.Y;
+					b->nz[k] = c->current_normal.Z;
+				}
+			}
+			gl_vertex_transform_block(b, n);
+			if (shade)
+				gl_shade_block(b, n);
+		}
+		for (k = 0; k < n; k++) {
+			if (cp != NULL) {
+				q[1].f = cp[0];
+				q[2].f = cp[1];
+				q[3].f = cp[2];
+				q[4].f = (csize > 3) ? cp[3] : 1.0f;
+				glopColor(q);
+				cp += cstep;
+			}
+			if (np != NULL) {
+				c->current_normal.X = np[0];
+				c->current_normal.Y = np[1];
+				c->current_normal.Z = np[2];
+				np += nstep;
+			}
+			if (tp != NULL) {
+				c->current_tex_coord.X = tp[0];
+				c->current_tex_coord.Y = tp[1];
+				c->current_tex_coord.Z = (tsize > 2) ? tp[2] : 0.0f;
+				c->current_tex_coord.W = (tsize > 3) ? tp[3] : 1.0f;
+				tp += tstep;
+			}
+			if (vp != NULL) {
+				gl_vertex_from_block(&c->vertex[c->vertex_n], b, k);
+#include "error_check.h"
+				gl_vertex_assemble();
+			}
+		}
+	}
+	glopEnd(q);
+}
+
 void glDrawArrays(GLenum mode, GLint first, GLsizei count) {
-	GLint i;
-	GLint end;
-	
+	GLParam p[4];
 #include "error_check_no_context.h"
-	end = first + count;
-	glBegin(mode);
-	for (i = first; i < end; i++)
-		glArrayElement(i);
-	glEnd();
+	p[0].op = OP_DrawArrays;
+	p[1].i = mode;
+	p[2].i = first;
+	p[3].i = count;
+	/* a list keeps the range, the arrays are read when it is called as with glArrayElement() */
+	gl_add_op(p);
+	gl_render_sync_arrays();
+}
+
+void glDrawElements(GLenum mode, GLsizei count, GLenum type, const GLvoid* indices) {
+	GLParam p[5];
+	GLint i;
+	GLContext* c = gl_get_context();
+#include "error_check.h"
+#if TGL_FEATURE_ERROR_CHECK == 1
+	if (type != GL_UNSIGNED_BYTE && type != GL_UNSIGNED_SHORT && type != GL_UNSIGNED_INT)
+#define ERROR_FLAG GL_INVALID_ENUM
+#include "error_check.h"
+	if (count < 0)
+#define ERROR_FLAG GL_INVALID_VALUE
+#include "error_check.h"
+#endif
+	if (c->compile_flag) {
+		/* a list can't keep a pointer to the indices */
+		glBegin(mode);
+		for (i = 0; i < count; i++)
+			glArrayElement(gl_array_index(type, indices, i));
+		glEnd();
+		return;
+	}
+	p[0].op = OP_DrawElements;
+	p[1].i = mode;
+	p[2].i = count;
+	p[3].i = type;
+	p[4].p = (void*)indices;
+	gl_add_op(p);
+	/* indices is only read when the op is executed */
+	gl_render_sync();
 }
 
 void glopEnableClientState(GLParam* p) { gl_get_context()->client_states |= p[1].i; }
@@ -231,6 +231,54 @@ static void updateTmp(GLVertex* q, GLVertex* p0, GLVertex* p1, GLfloat t) {
 
 static void gl_draw_triangle_clip(GLVertex* p0, GLVertex* p1, GLVertex* p2, GLint clip_bit); 
 
+void glSetGuardBand(GLint pixels) {
+	GLParam p[2];
+#include "error_check_no_context.h"
+	p[0].op = OP_SetGuardBand;
+	p[1].i = pixels;
+	gl_add_op(p);
+}
+void glopSetGuardBand(GLParam* p) {
+#if TGL_FEATURE_GUARD_BAND == 1
+	GLContext* c = gl_get_context();
+	GLint pixels = p[1].i;
+	if (pixels < 0)
+		pixels = 0;
+	if (pixels > TGL_GUARD_BAND_MAX)
+		pixels = TGL_GUARD_BAND_MAX;
+	c->guard_band = pixels;
+	gl_eval_viewport();
+#endif
+}
+
+#if TGL_FEATURE_GUARD_BAND == 1
+/*
+ * Returns 1 when the triangle only needs clipping against the x/y planes and fits in the guard band,
+ * so the rasterizer can scissor it. Only filled triangles are rasterized with a scissor.
+ * The vertices outside of the viewport are transformed to screen coordinates.
+ */
+static GLint gl_guard_band_accept(GLContext* c, GLVertex* p0, GLVertex* p1, GLVertex* p2, GLint co) {
+	GLVertex* p[3];
+	GLint i;
+	if (co & (CLIP_ZMIN | CLIP_ZMAX))
+		return 0;
+	if (c->draw_triangle_front != gl_draw_triangle_fill || c->draw_triangle_back != gl_draw_triangle_fill)
+		return 0;
+	p[0] = p0;
+	p[1] = p1;
+	p[2] = p2;
+	for (i = 0; i < 3; i++) {
+		GLfloat w = p[i]->pc.W;
+		if (p[i]->clip_code && !(w > 0 && fabs(p[i]->pc.X) <= c->viewport.guard_x * w && fabs(p[i]->pc.Y) <= c->viewport.guard_y * w))
+			return 0;
+	}
+	for (i = 0; i < 3; i++)
+		if (p[i]->clip_code)
+			gl_transform_to_viewport_clip_c(p[i]);
+	return 1;
+}
+#endif
+
 void gl_draw_triangle(GLVertex* p0, GLVertex* p1, GLVertex* p2) {
 	GLContext* c = gl_get_context();
 	GLint co, cc[3], front;
@@ -240,6 +288,10 @@ void gl_draw_triangle(GLVertex* p0, GLVertex* p1, GLVertex* p2) {
 	cc[2] = p2->clip_code;
 
 	co = cc[0] | cc[1] | cc[2];
+#if TGL_FEATURE_GUARD_BAND == 1
+	if (co != 0 && (cc[0] & cc[1] & cc[2]) == 0 && gl_guard_band_accept(c, p0, p1, p2, co))
+		co = 0;
+#endif
 
 	/* we handle the non clipped case here to go faster */
 	if (co == 0) {
@@ -398,6 +450,8 @@ int count_triangles, count_triangles_textured, count_pixels;
 /* see vertex.c to see how the draw functions are assigned.*/
 void gl_draw_triangle_fill(GLVertex* p0, GLVertex* p1, GLVertex* p2) { 
 	GLContext* c = gl_get_context();
+	ZB_fillTriangleFunc fill;
+	GLint kind, i;
 	if (c->texture_2d_enabled) {
 		/* if(c->current_texture)*/
 #if TGL_FEATURE_LIT_TEXTURES == 1
@@ -412,34 +466,45 @@ void gl_draw_triangle_fill(GLVertex* p0, GLVertex* p1, GLVertex* p2) {
 		}
 #endif
 
-		ZB_setTexture(c->zb, c->current_texture->images[0].pixmap);
-#if TGL_FEATURE_BLEND == 1
-		if (c->zb->enable_blend)
-			ZB_fillTriangleMappingPerspective(c->zb, &p0->zp, &p1->zp, &p2->zp);
-		else
-			ZB_fillTriangleMappingPerspectiveNOBLEND(c->zb, &p0->zp, &p1->zp, &p2->zp);
-#else
-		ZB_fillTriangleMappingPerspectiveNOBLEND(c->zb, &p0->zp, &p1->zp, &p2->zp);
+		{
+			GLTexture* t = c->current_texture;
+			PIXEL* levels[MAX_TEXTURE_LEVELS];
+			for (i = 0; i < t->level_count; i++)
+				levels[i] = t->images[i].pixmap;
+			ZB_setTexture(c->zb, levels, t->level_count, t->images[0].xsize_log2, t->images[0].ysize_log2, t->tiled);
+			kind = ZB_FILL_MAPPING;
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+			if (t->index_bits) {
+				ZB_setTexturePalette(c->zb, t->palette, t->palette_size, t->index_bits);
+				kind = ZB_FILL_MAPPING_INDEXED;
+			}
 #endif
+		}
 	} else if (c->current_shade_model == GL_SMOOTH) {
-#if TGL_FEATURE_BLEND == 1
-		if (c->zb->enable_blend)
-			ZB_fillTriangleSmooth(c->zb, &p0->zp, &p1->zp, &p2->zp);
-		else
-			ZB_fillTriangleSmoothNOBLEND(c->zb, &p0->zp, &p1->zp, &p2->zp);
-#else
-		ZB_fillTriangleSmoothNOBLEND(c->zb, &p0->zp, &p1->zp, &p2->zp);
-#endif
+		kind = ZB_FILL_SMOOTH;
 	} else {
-#if TGL_FEATURE_BLEND == 1
-		if (c->zb->enable_blend)
-			ZB_fillTriangleFlat(c->zb, &p0->zp, &p1->zp, &p2->zp);
-		else
-			ZB_fillTriangleFlatNOBLEND(c->zb, &p0->zp, &p1->zp, &p2->zp);
-#else
-		ZB_fillTriangleFlatNOBLEND(c->zb, &p0->zp, &p1->zp, &p2->zp);
+		kind = ZB_FILL_FLAT;
+	}
+	if (c->fill_funcs_dirty) {
+		for (i = 0; i < ZB_FILL_KINDS; i++)
+			c->fill_funcs[i] = ZB_getFillFunc(c->zb, i);
+		c->fill_funcs_dirty = 0;
+	}
+	fill = c->fill_funcs[kind];
+	ZB_touchTriangle(c->zb, &p0->zp, &p1->zp, &p2->zp);
+#if TGL_FEATURE_TILED_RASTER == 1
+	if (c->zb->raster_mode == ZB_RASTER_TILED) {
+		ZB_binTriangle(c->zb, fill, &p0->zp, &p1->zp, &p2->zp);
+		return;
+	}
 #endif
+#if TGL_FEATURE_BAND_RASTER == 1
+	if (c->zb->band_recording) {
+		ZB_bandTriangle(c->zb, fill, &p0->zp, &p1->zp, &p2->zp);
+		return;
 	}
+#endif
+	fill(c->zb, &p0->zp, &p1->zp, &p2->zp);
 }
 
 /* Render a clipped triangle in line mode */
@@ -0,0 +1,154 @@
+/*
+ * Texel fetch benchmark: draws a textured quad covering the whole
+ * framebuffer, about one texel per pixel, turned to several angles,
+ * with the texture stored in rows and in 4x4 texel tiles
+ * (glSetTextureTiles), and with 8 and 4 bit palette indices
+ * (glColorTableEXT), and prints the time per pixel of each.
+ *
+ * Turned quads read the texture across its rows, which is where the
+ * tiles help. The indexed textures are smaller but take a palette
+ * lookup per texel.
+ *
+ * usage: texbench [frames]
+ */
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "zbuffer.h"
+#include <GL/gl.h>
+
+#define WIDTH 320
+#define HEIGHT 240
+#define TEX_SIZE 256
+
+#define LAYOUTS 4
+
+static const char *layout_names[LAYOUTS] = {"rows", "tiles", "index8", "index4"};
+
+/* the same image as RGB pixels and as indices into a 16 color palette */
+static GLubyte texture[TEX_SIZE * TEX_SIZE * 3];
+static GLubyte indices[TEX_SIZE * TEX_SIZE];
+static GLubyte palette[16 * 3];
+
+static void make_texture(void)
+{
+  int i, j;
+  unsigned int seed = 1;
+
+  for (i = 0; i < 16; i++) {
+    palette[i * 3] = (i & 1) ? 255 : i * 16;
+    palette[i * 3 + 1] = (i & 2) ? 200 : 30;
+    palette[i * 3 + 2] = i * 17;
+  }
+  for (i = 0; i < TEX_SIZE; i++)
+    for (j = 0; j < TEX_SIZE; j++) {
+      seed = seed * 1103515245 + 12345;
+      indices[i * TEX_SIZE + j] = ((i ^ j) & 16) ? 1 : (seed >> 16) & 15;
+      memcpy(texture + (i * TEX_SIZE + j) * 3, palette + indices[i * TEX_SIZE + j] * 3, 3);
+    }
+}
+
+/* ns per pixel of drawing the quad turned by angle degrees */
+static double draw_quad(GLfloat angle, int frames)
+{
+  /* large enough to cover the framebuffer at any angle */
+  GLfloat size = WIDTH + HEIGHT, reps = size / TEX_SIZE;
+  clock_t start;
+  int i;
+
+  start = clock();
+  for (i = 0; i < frames; i++) {
+    glClear(GL_COLOR_BUFFER_BIT | GL_DEPTH_BUFFER_BIT);
+    glLoadIdentity();
+    glTranslatef(0.0, 0.0, -1.0);
+    glRotatef(angle, 0.0, 0.0, 1.0);
+    glBegin(GL_QUADS);
+    glTexCoord2f(0.0, 0.0);
+    glVertex2f(-size / 2, -size / 2);
+    glTexCoord2f(reps, 0.0);
+    glVertex2f(size / 2, -size / 2);
+    glTexCoord2f(reps, reps);
+    glVertex2f(size / 2, size / 2);
+    glTexCoord2f(0.0, reps);
+    glVertex2f(-size / 2, size / 2);
+    glEnd();
+  }
+  glFinish();
+  return (double)(clock() - start) / CLOCKS_PER_SEC * 1e9 / ((double)frames * WIDTH * HEIGHT);
+}
+
+int main(int argc, char **argv)
+{
+  static const GLfloat angles[] = {0.0, 15.0, 45.0, 90.0};
+  ZBuffer *zb;
+  GLuint tex[LAYOUTS];
+  double ns[LAYOUTS][4], t;
+  int frames = (argc > 1) ? atoi(argv[1]) : 20;
+  int round, layout, i;
+
+  zb = ZB_open(WIDTH, HEIGHT,
+#if TGL_FEATURE_RENDER_BITS == 32
+               ZB_MODE_RGBA,
+#else
+               ZB_MODE_5R6G5B,
+#endif
+               NULL);
+  if (zb == NULL) {
+    fprintf(stderr, "ZB_open failed\n");
+    return 1;
+  }
+  glInit(zb);
+  glViewport(0, 0, WIDTH, HEIGHT);
+  glMatrixMode(GL_PROJECTION);
+  glLoadIdentity();
+  /* one unit is one pixel at z = -1 */
+  glFrustum(-WIDTH / 2, WIDTH / 2, -HEIGHT / 2, HEIGHT / 2, 1.0, 10.0);
+  glMatrixMode(GL_MODELVIEW);
+  glEnable(GL_TEXTURE_2D);
+  glColor3f(1.0, 1.0, 1.0);
+
+  /* the same image in each layout, which is chosen when it is specified */
+  make_texture();
+  glGenTextures(LAYOUTS, tex);
+  for (layout = 0; layout < LAYOUTS; layout++) {
+    glSetTextureTiles(layout == 1);
+    glBindTexture(GL_TEXTURE_2D, tex[layout]);
+    if (layout < 2) {
+      glTexImage2D(GL_TEXTURE_2D, 0, 3, TEX_SIZE, TEX_SIZE, 0, GL_RGB, GL_UNSIGNED_BYTE, texture);
+    } else {
+      glColorTableEXT(GL_TEXTURE_2D, GL_RGB, 16, GL_RGB, GL_UNSIGNED_BYTE, palette);
+      glTexImage2D(GL_TEXTURE_2D, 0, (layout == 2) ? GL_COLOR_INDEX8_EXT : GL_COLOR_INDEX4_EXT, TEX_SIZE, TEX_SIZE, 0,
+                   GL_COLOR_INDEX, GL_UNSIGNED_BYTE, indices);
+    }
+  }
+
+  /* the best of 10 rounds, taking turns */
+  for (round = 0; round < 10; round++)
+    for (i = 0; i < 4; i++)
+      for (layout = 0; layout < LAYOUTS; layout++) {
+        glBindTexture(GL_TEXTURE_2D, tex[layout]);
+        t = draw_quad(angles[i], frames);
+        if (round == 0 || t < ns[layout][i])
+          ns[layout][i] = t;
+      }
+
+  printf("%dx%d, %dx%d texture, %d frames, ns/pixel\n", WIDTH, HEIGHT, TEX_SIZE, TEX_SIZE, frames);
+  printf("angle");
+  for (layout = 0; layout < LAYOUTS; layout++)
+    printf("  %8s", layout_names[layout]);
+  printf("\n");
+  for (i = 0; i < 4; i++) {
+    printf("%5.0f", angles[i]);
+    for (layout = 0; layout < LAYOUTS; layout++)
+      printf("  %8.2f", ns[layout][i]);
+    printf("\n");
+  }
+
+  glDeleteTextures(LAYOUTS, tex);
+  glClose();
+  ZB_close(zb);
+  return 0;
+}
@@ -101,6 +101,9 @@ const GLubyte* extensions_string =
 #if TGL_FEATURE_NO_DRAW_COLOR == 1
 																						 "TGL_FEATURE_NO_DRAW_COLOR "
 #endif
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+																						 "GL_EXT_paletted_texture "
+#endif
 
 #if TGL_FEATURE_NO_COPY_COLOR == 1
 																						 "TGL_FEATURE_NO_COPY_COLOR "
@@ -173,6 +176,7 @@ const GLubyte* glGetString(GLenum name) {
 void glGetIntegerv(GLint pname, GLint* params) {
 	GLint i;
 	GLContext* c = gl_get_context();
+	gl_render_sync();
 	i = 0;
 	switch (pname) {
 	case GL_MAX_BUFFERS:
@@ -490,6 +494,9 @@ void glGetIntegerv(GLint pname, GLint* params) {
 	case GL_IS_SPECULAR_ENABLED:
 		*params = c->zEnableSpecular;
 		break;
+	case GL_IS_TEXTURE_TILES_ENABLED:
+		*params = c->texture_tiles;
+		break;
 	case GL_MAX_MODELVIEW_STACK_DEPTH:
 		*params = MAX_MODELVIEW_STACK_DEPTH;
 		break;
@@ -542,7 +549,7 @@ void glGetIntegerv(GLint pname, GLint* params) {
 		*params = MAX_LIGHTS;
 		break;
 	case GL_MAX_TEXTURE_SIZE:
-		*params = TGL_FEATURE_TEXTURE_DIM; /* not completely true, but... */
+		*params = TGL_FEATURE_TEXTURE_DIM;
 		break;
 	case GL_CULL_FACE:
 		*params = c->cull_face_enabled;
@@ -582,6 +589,7 @@ void glGetFloatv(GLint pname, GLfloat* v) {
 	GLContext* c;
 	mnr = 0; /* just a trick to return the correct matrix */
 	c = gl_get_context();
+	gl_render_sync();
 	switch (pname) {
 	case GL_BLUE_SCALE:
 	case GL_RED_SCALE:
@@ -32,6 +32,19 @@ void gl_convertRGB_to_8A8R8G8B(GLuint* pixmap, GLubyte* rgb, GLint xsize, GLint
 	}
 }
 
+/* 8 bit luminance for the 1 bit mode, (77 R + 150 G + 29 B) / 256 */
+void gl_convertRGB_to_L8(GLubyte* pixmap, GLubyte* rgb, GLint xsize, GLint ysize) {
+	GLint i, n;
+	GLubyte* p;
+
+	p = rgb;
+	n = xsize * ysize;
+	for (i = 0; i < n; i++) {
+		pixmap[i] = (77 * p[0] + 150 * p[1] + 29 * p[2]) >> 8;
+		p += 3;
+	}
+}
+
 /*
  * linear GLinterpolation with xf,yf normalized to 2^16
  */
@@ -122,3 +135,117 @@ void gl_resizeImageNoInterpolate(GLubyte* dest, GLint xsize_dest, GLint ysize_de
 		y1 += y1inc;
 	}
 }
+
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+
+/*
+ * palette index images, with 2^sh indices to a byte: 8 bit indices for sh 0, two 4 bit ones for sh 1, the first of
+ * which is in the low bits
+ */
+
+#define INDEX_MASK(sh) (0xff >> ((sh) << 2))
+#define INDEX_BIT(i, sh) (((i) & (sh)) << 2)
+#define GET_INDEX(p, i, sh) (((p)[(i) >> (sh)] >> INDEX_BIT(i, sh)) & INDEX_MASK(sh))
+#define SET_INDEX(p, i, sh, v)                                                                                          \
+	((p)[(i) >> (sh)] = ((p)[(i) >> (sh)] & ~(INDEX_MASK(sh) << INDEX_BIT(i, sh))) | (((v) & INDEX_MASK(sh)) << INDEX_BIT(i, sh)))
+
+/* Packs the xsize_src x ysize_src indices src, one to a byte, into the 2^xsize_log2 x 2^ysize_log2 image dest, resized without interpolation. */
+void gl_packIndexImage(GLubyte* dest, GLint xsize_log2, GLint ysize_log2, GLubyte* src, GLint xsize_src, GLint ysize_src, GLint index_shift) {
+	GLint x1, y1, x1inc, y1inc;
+	GLint x, y;
+
+	x1inc = (GLint)((GLfloat)((xsize_src) << FRAC_BITS) / (GLfloat)(1 << xsize_log2));
+	y1inc = (GLint)((GLfloat)((ysize_src) << FRAC_BITS) / (GLfloat)(1 << ysize_log2));
+
+	y1 = 0;
+	for (y = 0; y < (1 << ysize_log2); y++) {
+		x1 = 0;
+		for (x = 0; x < (1 << xsize_log2); x++) {
+			SET_INDEX(dest, (y << xsize_log2) + x, index_shift, src[(y1 >> FRAC_BITS) * xsize_src + (x1 >> FRAC_BITS)]);
+			x1 += x1inc;
+		}
+		y1 += y1inc;
+	}
+}
+
+/* The next mip level of an index image, like gl_halveImage() but keeping the first of each 2x2 indices, as they can't be averaged. */
+void gl_halveIndexImage(GLubyte* dest, GLubyte* src, GLint xsize_log2_src, GLint ysize_log2_src, GLint index_shift) {
+	GLint xs = (xsize_log2_src > 0), ys = (ysize_log2_src > 0);
+	GLint xsize_log2_dest = xsize_log2_src - xs, ysize_dest = 1 << (ysize_log2_src - ys);
+	GLint x, y;
+
+	for (y = 0; y < ysize_dest; y++) {
+		for (x = 0; x < (1 << xsize_log2_dest); x++) {
+			SET_INDEX(dest, (y << xsize_log2_dest) + x, index_shift, GET_INDEX(src, ((y << ys) << xsize_log2_src) + (x << xs), index_shift));
+		}
+	}
+}
+
+/* gl_tileImage() for an index image. */
+void gl_tileIndexImage(GLubyte* dest, GLubyte* src, GLint xsize_log2, GLint ysize_log2, GLint index_shift) {
+	GLint tw = (xsize_log2 < 2) ? xsize_log2 : 2, th = (ysize_log2 < 2) ? ysize_log2 : 2;
+	GLint tx_mask = (1 << tw) - 1, ty_mask = (1 << th) - 1;
+	GLint x, y, i = 0;
+
+	for (y = 0; y < (1 << ysize_log2); y++) {
+		for (x = 0; x < (1 << xsize_log2); x++, i++) {
+			SET_INDEX(dest, (x & tx_mask) | ((y & ty_mask) << tw) | ((x & ~tx_mask) << th) | ((y & ~ty_mask) << xsize_log2), index_shift,
+					  GET_INDEX(src, i, index_shift));
+		}
+	}
+}
+
+#endif
+
+/*
+ * box filtering of a mip level into the next one
+ */
+
+static PIXEL gl_box_filter(PIXEL a, PIXEL b, PIXEL c, PIXEL d) {
+#if TGL_FEATURE_RENDER_BITS == 32
+	/* two channels at a time, 8 bits apart: their sums of 4 fit */
+	GLuint rb = (a & 0x00ff00ff) + (b & 0x00ff00ff) + (c & 0x00ff00ff) + (d & 0x00ff00ff) + 0x00020002;
+	GLuint ag = ((a >> 8) & 0x00ff00ff) + ((b >> 8) & 0x00ff00ff) + ((c >> 8) & 0x00ff00ff) + ((d >> 8) & 0x00ff00ff) + 0x00020002;
+	return ((rb >> 2) & 0x00ff00ff) | (((ag >> 2) & 0x00ff00ff) << 8);
+#elif TGL_FEATURE_RENDER_BITS == 16
+	/* green is moved to the upper half, leaving room for the sums of 4 of each channel */
+	GLuint e = ((a | (a << 16)) & 0x07E0F81F) + ((b | (b << 16)) & 0x07E0F81F) + ((c | (c << 16)) & 0x07E0F81F) +
+			   ((d | (d << 16)) & 0x07E0F81F) + 0x00401002;
+	e = (e >> 2) & 0x07E0F81F;
+	return (PIXEL)(e | (e >> 16));
+#else
+	return (PIXEL)((a + b + c + d + 2) >> 2);
+#endif
+}
+
+/* Writes the next mip level of the 2^xsize_log2_src x 2^ysize_log2_src image src into dest, halving each size above 1. */
+void gl_halveImage(PIXEL* dest, PIXEL* src, GLint xsize_log2_src, GLint ysize_log2_src) {
+	GLint xs = (xsize_log2_src > 0), ys = (ysize_log2_src > 0);
+	GLint xsize_dest = 1 << (xsize_log2_src - xs), ysize_dest = 1 << (ysize_log2_src - ys);
+	GLint x, y;
+	PIXEL *row0, *row1;
+
+	for (y = 0; y < ysize_dest; y++) {
+		row0 = src + ((y << ys) << xsize_log2_src);
+		row1 = row0 + (ys << xsize_log2_src);
+		for (x = 0; x < xsize_dest; x++) {
+			*dest++ = gl_box_filter(row0[x << xs], row0[(x << xs) + xs], row1[x << xs], row1[(x << xs) + xs]);
+		}
+	}
+}
+
+/*
+Copies the 2^xsize_log2 x 2^ysize_log2 image src, stored in rows, into dest in 4x4 texel tiles, or as wide or tall as
+the image if it is smaller. The tiles are stored in rows, and the texels of a tile in rows.
+*/
+void gl_tileImage(PIXEL* dest, PIXEL* src, GLint xsize_log2, GLint ysize_log2) {
+	GLint tw = (xsize_log2 < 2) ? xsize_log2 : 2, th = (ysize_log2 < 2) ? ysize_log2 : 2;
+	GLint tx_mask = (1 << tw) - 1, ty_mask = (1 << th) - 1;
+	GLint x, y;
+
+	for (y = 0; y < (1 << ysize_log2); y++) {
+		for (x = 0; x < (1 << xsize_log2); x++) {
+			dest[(x & tx_mask) | ((y & ty_mask) << tw) | ((x & ~tx_mask) << th) | ((y & ~ty_mask) << xsize_log2)] = *src++;
+		}
+	}
+}
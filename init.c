@@ -1,10 +1,23 @@
 #include "msghandling.h"
 #include "zgl.h"
 GLContext gl_ctx;
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+TGL_THREAD_LOCAL GLContext* gl_current_ctx;
+#endif
 static const GLContext empty_gl_ctx = {0};
 
-static void initSharedState(GLContext* c) {
+static void initSharedState(GLContext* c, GLContext* share) {
 	GLSharedState* s = &c->shared_state;
+	if (share != NULL) {
+		/* the tables are shared, texture 0 included */
+		*s = share->shared_state;
+		(*s->refcount)++;
+		return;
+	}
+	s->refcount = gl_malloc(sizeof(GLint));
+	if (!s->refcount)
+		gl_fatal_error("TINYGL_CANNOT_INIT_OOM");
+	*s->refcount = 1;
 	s->lists = gl_zalloc(sizeof(GLList*) * MAX_DISPLAY_LISTS);
 	if (!s->lists)
 		gl_fatal_error("TINYGL_CANNOT_INIT_OOM");
@@ -21,19 +34,14 @@ static void initSharedState(GLContext* c) {
 static void endSharedState(GLContext* c) {
 	GLSharedState* s = &c->shared_state;
 	GLint i;
-	GLList* l;
-	GLParamBuffer *pb, *pb1;
 	GLTexture *t, *n;
+	if (--(*s->refcount) > 0)
+		return;
+	gl_flush_texture_users(c);
+	gl_free(s->refcount);
 	for (i = 0; i < MAX_DISPLAY_LISTS; i++)
 		if (s->lists[i]) {
-			l = s->lists[i];
-			pb = l->first_op_buffer;
-			while (pb != NULL) {
-				pb1 = pb->next;
-				gl_free(pb);
-				pb = pb1;
-			}
-			gl_free(l);
+			gl_free_list(s->lists[i]);
 			s->lists[i] = NULL;
 		}
 	gl_free(s->lists);
@@ -50,6 +58,7 @@ static void endSharedState(GLContext* c) {
 			n = t->next;
 			if (t->next != NULL)
 				t->next->prev = t->prev;
+			gl_free_texture_images(t);
 			gl_free(t);
 			t = n;
 		}
@@ -148,19 +157,19 @@ static int TinyGLRuntimeCompatibilityTest() {
 }
 #endif
 
-void glInit(void* zbuffer1) {
+/* Initializes the current context. */
+static void gl_init_context(ZBuffer* zbuffer, GLContext* share) {
 	GLContext* c;
 	GLViewport* v;
 	GLint i;
-	ZBuffer* zbuffer = (ZBuffer*)zbuffer1;
 #if TGL_FEATURE_TINYGL_RUNTIME_COMPAT_TEST == 1
 	if (TinyGLRuntimeCompatibilityTest())
 		gl_fatal_error("TINYGL_FAILED_RUNTIME_COMPAT_TEST");
 #endif
-	gl_ctx = empty_gl_ctx;
-	c = &gl_ctx;
+	c = gl_get_context();
 	if (!c)
 		gl_fatal_error("TINYGL_CANNOT_INIT_OOM");
+	*c = empty_gl_ctx;
 
 	c->zb = zbuffer;
 #if TGL_FEATURE_ERROR_CHECK == 1
@@ -176,12 +185,15 @@ void glInit(void* zbuffer1) {
 	v->ymin = 0;
 	v->xsize = zbuffer->xsize;
 	v->ysize = zbuffer->ysize;
+#if TGL_FEATURE_GUARD_BAND == 1
+	c->guard_band = TGL_GUARD_BAND;
+#endif
 	gl_eval_viewport();
 	/* buffer stuff GL 1.1 */
 	c->drawbuffer = GL_FRONT;
 	c->readbuffer = GL_FRONT;
 	/* shared state */
-	initSharedState(c);
+	initSharedState(c, share);
 	/* ztext */
 	c->textsize = 1;
 	/* buffer */
@@ -214,12 +226,17 @@ void glInit(void* zbuffer1) {
 		l->attenuation[1] = 0;
 		l->attenuation[2] = 0;
 		l->enabled = 0;
+#if TGL_FEATURE_SPOT_BUFFERS == 1
+		l->spot_buf = NULL;
+#endif
 	}
 	c->first_light = NULL;
 	c->ambient_light_model = gl_V4_New(0.2, 0.2, 0.2, 1);
 	c->local_light_model = 0;
 	c->lighting_enabled = 0;
 	c->light_model_two_side = 0;
+	c->shade_light_n = 0;
+	c->shade_dirty = SHADE_LIGHTS | SHADE_MATERIAL;
 
 	/* default materials */
 	for (i = 0; i < 2; i++) {
@@ -329,15 +346,17 @@ void glInit(void* zbuffer1) {
 
 	/* specular buffer */
 #if TGL_FEATURE_SPECULAR_BUFFERS == 1
-	c->specbuf_first = NULL;
-	c->specbuf_used_counter = 0;
-	c->specbuf_num_buffers = 0;
+	for (i = 0; i < SPECULAR_HASH_SIZE; i++)
+		c->specbufs.hash[i] = NULL;
+	c->specbufs.n = 0;
 #endif
 	c->zEnableSpecular = 0;
+	c->texture_tiles = 0;
 	/* depth test */
 	c->zb->depth_test = 0;
 	c->zb->depth_write = 1;
 	c->zb->pointsize = 1;
+	c->fill_funcs_dirty = 1;
 
 	/* raster position */
 	c->rasterpos.X = 0;
@@ -354,24 +373,75 @@ void glInit(void* zbuffer1) {
 	c->pzoomy = 1;
 }
 
+void glInit(void* zbuffer) {
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+	gl_current_ctx = NULL;
+#endif
+	gl_init_context((ZBuffer*)zbuffer, NULL);
+}
+
 void glClose(void) {
 
 	GLuint i;
 	GLContext* c = gl_get_context();
+#if TGL_FEATURE_RENDER_THREAD == 1
+	if (c->render_queue != NULL)
+		glSetRenderThread(0);
+#endif
 	for (i = 0; i < 3; i++) {
 		gl_free(c->matrix_stack[i]);
 	}
-	i = 0;
+#if TGL_FEATURE_SPOT_BUFFERS == 1
+	for (i = 0; i < MAX_LIGHTS; i++)
+		gl_free(c->lights[i].spot_buf);
+#endif
 #if TGL_FEATURE_SPECULAR_BUFFERS == 1
-	{
-		GLSpecBuf *b, *n = NULL;
-		for (b = c->specbuf_first; b != NULL; b = n) {
-			n = b->next;
-			gl_free(b);
-			i++;
-		}
-	}
+	for (i = 0; i < SPECULAR_HASH_SIZE; i++)
+		gl_free(c->specbufs.hash[i]);
 #endif
 	endSharedState(c);
-	gl_ctx = empty_gl_ctx;
+	*c = empty_gl_ctx;
+}
+
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+void* glCreateContext(void* zbuffer, void* share_context) {
+	GLContext* prev = gl_current_ctx;
+	GLContext* c = gl_malloc(sizeof(GLContext));
+	if (c == NULL)
+		return NULL;
+	/* the context is initialized through the gl functions, which use the current one */
+	gl_current_ctx = c;
+	gl_init_context((ZBuffer*)zbuffer, (GLContext*)share_context);
+	gl_current_ctx = prev;
+	return c;
+}
+
+void glMakeCurrent(void* context) { gl_current_ctx = (GLContext*)context; }
+
+void* glGetCurrentContext(void) { return gl_get_context(); }
+
+void glDestroyContext(void* context) {
+	GLContext* prev = gl_current_ctx;
+	gl_current_ctx = (GLContext*)context;
+	glClose();
+	gl_current_ctx = (prev == context) ? NULL : prev;
+	if (context != &gl_ctx)
+		gl_free(context);
 }
+#else
+void* glCreateContext(void* zbuffer, void* share_context) {
+	(void)zbuffer;
+	(void)share_context;
+	tgl_warning("\nTinyGL: glCreateContext() needs TGL_FEATURE_MULTI_CONTEXT.");
+	return NULL;
+}
+
+void glMakeCurrent(void* context) { (void)context; }
+
+void* glGetCurrentContext(void) { return &gl_ctx; }
+
+void glDestroyContext(void* context) {
+	if (context == &gl_ctx)
+		glClose();
+}
+#endif
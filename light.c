@@ -1,5 +1,6 @@
 #include "msghandling.h"
 #include "zgl.h"
+#include "zsimd.h"
 
 void glopMaterial(GLParam* p) {
 	GLContext* c = gl_get_context();
@@ -13,6 +14,7 @@ void glopMaterial(GLParam* p) {
 	GLint i;
 	GLMaterial* m;
 
+	c->shade_dirty |= SHADE_MATERIAL;
 	if (mode == GL_FRONT_AND_BACK) {
 		p[1].i = GL_FRONT;
 		glopMaterial(p);
@@ -93,6 +95,7 @@ void glopLight(GLParam* p) {
 #endif
 
 		l = &c->lights[light - GL_LIGHT0];
+	c->shade_dirty |= SHADE_LIGHTS;
 
 	for (i = 0; i < 4; i++)
 		if (type != GL_POSITION && type != GL_SPOT_DIRECTION && type != GL_SPOT_EXPONENT && type != GL_SPOT_CUTOFF && type != GL_LINEAR_ATTENUATION &&
@@ -134,6 +137,9 @@ void glopLight(GLParam* p) {
 		break;
 	case GL_SPOT_EXPONENT:
 		l->spot_exponent = v.v[0];
+#if TGL_FEATURE_SPOT_BUFFERS == 1
+		spotbuf_calc(l);
+#endif
 		break;
 	case GL_SPOT_CUTOFF: {
 		GLfloat a = v.v[0];
@@ -148,6 +154,9 @@ void glopLight(GLParam* p) {
 		l->spot_cutoff = a;
 		if (a != 180)
 			l->cos_spot_cutoff = cos(a * M_PI / 180.0);
+#if TGL_FEATURE_SPOT_BUFFERS == 1
+		spotbuf_calc(l);
+#endif
 	} break;
 	case GL_CONSTANT_ATTENUATION:
 		l->attenuation[0] = v.v[0];
@@ -173,6 +182,7 @@ void glopLightModel(GLParam* p) {
 	GLint* v = &p[2].i;
 	GLint i;
 
+	c->shade_dirty |= SHADE_LIGHTS;
 	switch (pname) {
 	case GL_LIGHT_MODEL_AMBIENT:
 		for (i = 0; i < 4; i++)
@@ -200,6 +210,7 @@ void glopLightModel(GLParam* p) {
 void gl_enable_disable_light(GLint light, GLint v) {
 	GLContext* c = gl_get_context();
 	GLLight* l = &c->lights[light];
+	c->shade_dirty |= SHADE_LIGHTS;
 	if (v && !l->enabled) {
 		l->enabled = 1;
 		l->next = c->first_light;
@@ -228,44 +239,132 @@ void glopSetEnableSpecular(GLParam* p) {
 	
 	gl_get_context()->zEnableSpecular = p[1].i;
 }
-/* non optimized lightening model */
+/* The spot factor of l for dot_spot, the cosine of the angle to its direction, not below its cutoff. */
+static GLfloat gl_spot_falloff(GLLight* l, GLfloat dot_spot) {
+#if TGL_FEATURE_SPOT_BUFFERS == 1
+	GLfloat x;
+	GLint idx;
+	if (l->spot_buf != NULL) {
+		/* interpolated between the entries around dot_spot */
+		x = (dot_spot - l->cos_spot_cutoff) * l->spot_buf_scale;
+		if (x >= SPOT_BUFFER_SIZE)
+			return l->spot_buf[SPOT_BUFFER_SIZE];
+		if (x <= 0)
+			return l->spot_buf[0];
+		idx = (GLint)x;
+		x -= idx;
+		return l->spot_buf[idx] + x * (l->spot_buf[idx + 1] - l->spot_buf[idx]);
+	}
+#endif
+	return powf(dot_spot, l->spot_exponent);
+}
+
+/*
+Rebuilds the precomputed values of the enabled lights which depend on the state that changed, see GLShadeLight.
+The lights are kept in the order of the first_light list, so they add up the same as when it was walked.
+*/
+static void gl_shade_setup(GLContext* c) {
+	GLMaterial* m = &c->materials[0];
+	GLShadeLight* s;
+	GLLight* l;
+	GLfloat dot_spot;
+	GLint i, n;
+
+	if (c->shade_dirty & SHADE_LIGHTS) {
+		c->shade_infinite = !c->local_light_model;
+		for (l = c->first_light, n = 0; l != NULL; l = l->next, n++) {
+			s = &c->shade_lights[n];
+			s->light = l;
+			s->infinite = (l->position.v[3] == 0);
+			if (!s->infinite) {
+				c->shade_infinite = 0;
+				continue;
+			}
+			/* light at infinity */
+			s->dir = l->norm_position;
+			/* a spot light at infinity lights every vertex facing it the same way, or none */
+			s->spot_out = 0;
+			s->spot_att = 1;
+			if (l->spot_cutoff != 180) {
+				dot_spot = -(s->dir.X * l->norm_spot_direction.v[0] + s->dir.Y * l->norm_spot_direction.v[1] +
+							 s->dir.Z * l->norm_spot_direction.v[2]);
+				if (c->light_model_two_side && dot_spot < 0)
+					dot_spot = -dot_spot;
+				if (dot_spot < l->cos_spot_cutoff)
+					s->spot_out = 1;
+				else if (l->spot_exponent > 0)
+					s->spot_att = powf(dot_spot, l->spot_exponent);
+			}
+			/* the specular direction for a viewer at infinity */
+			s->half.X = s->dir.X;
+			s->half.Y = s->dir.Y;
+			s->half.Z = s->dir.Z - 1.0f;
+#if TGL_FEATURE_FISR == 1
+			s->half_norm = fastInvSqrt(s->half.X * s->half.X + s->half.Y * s->half.Y + s->half.Z * s->half.Z);
+#else
+			s->half_norm = sqrtf(s->half.X * s->half.X + s->half.Y * s->half.Y + s->half.Z * s->half.Z);
+#endif
+		}
+		c->shade_light_n = n;
+	}
+
+	c->shade_base.X = m->emission.v[0] + m->ambient.v[0] * c->ambient_light_model.v[0];
+	c->shade_base.Y = m->emission.v[1] + m->ambient.v[1] * c->ambient_light_model.v[1];
+	c->shade_base.Z = m->emission.v[2] + m->ambient.v[2] * c->ambient_light_model.v[2];
+	for (i = 0; i < c->shade_light_n; i++) {
+		s = &c->shade_lights[i];
+		l = s->light;
+		s->ambient.X = l->ambient.v[0] * m->ambient.v[0];
+		s->ambient.Y = l->ambient.v[1] * m->ambient.v[1];
+		s->ambient.Z = l->ambient.v[2] * m->ambient.v[2];
+		s->diffuse.X = l->diffuse.v[0] * m->diffuse.v[0];
+		s->diffuse.Y = l->diffuse.v[1] * m->diffuse.v[1];
+		s->diffuse.Z = l->diffuse.v[2] * m->diffuse.v[2];
+		s->specular.X = l->specular.v[0] * m->specular.v[0];
+		s->specular.Y = l->specular.v[1] * m->specular.v[1];
+		s->specular.Z = l->specular.v[2] * m->specular.v[2];
+	}
+	c->shade_dirty = 0;
+}
+
 void gl_shade_vertex(GLVertex* v) {
 	GLContext* c = gl_get_context();
 	GLfloat R, G, B, A;
 	GLMaterial* m;
+	GLShadeLight* sl;
 	GLLight* l;
 	V3 n, s, d;
 	GLfloat dist=0, tmp, att, dot, dot_spot, dot_spec;
 	GLint twoside = c->light_model_two_side;
+	GLint i;
 
+	if (c->shade_dirty)
+		gl_shade_setup(c);
 	m = &c->materials[0];
 
 	n.X = v->normal.X;
 	n.Y = v->normal.Y;
 	n.Z = v->normal.Z;
 
-	R = m->emission.v[0] + m->ambient.v[0] * c->ambient_light_model.v[0];
-	G = m->emission.v[1] + m->ambient.v[1] * c->ambient_light_model.v[1];
-	B = m->emission.v[2] + m->ambient.v[2] * c->ambient_light_model.v[2];
+	R = c->shade_base.X;
+	G = c->shade_base.Y;
+	B = c->shade_base.Z;
 	A = m->diffuse.v[3];
 	
-	for (l = c->first_light; l != NULL; l = l->next) {
-	
-	
-	
+	for (i = 0; i < c->shade_light_n; i++) {
 		GLfloat lR, lB, lG;
 
+		sl = &c->shade_lights[i];
+		l = sl->light;
+
 		/* ambient */
-		lR = l->ambient.v[0] * m->ambient.v[0];
-		lG = l->ambient.v[1] * m->ambient.v[1];
-		lB = l->ambient.v[2] * m->ambient.v[2];
+		lR = sl->ambient.X;
+		lG = sl->ambient.Y;
+		lB = sl->ambient.Z;
 
-		if (l->position.v[3] == 0) {
+		if (sl->infinite) {
 			/* light at infinity */
-			/* Fixed by Gek, it used to use the unnormalized position?*/
-			d.X = l->norm_position.v[0];
-			d.Y = l->norm_position.v[1];
-			d.Z = l->norm_position.v[2];
+			d = sl->dir;
 			att = 1;
 		} else {
 			/* distance attenuation */
@@ -280,8 +379,8 @@ void gl_shade_vertex(GLVertex* v) {
 				d.Z *= tmp;
 			}
 #else
-			dist = sqrt(d.X * d.X + d.Y * d.Y + d.Z * d.Z);
-			if (dist > 1E-3) {
+			dist = sqrtf(d.X * d.X + d.Y * d.Y + d.Z * d.Z);
+			if (dist > 1E-3f) {
 				tmp = 1 / dist;
 				d.X *= tmp;
 				d.Y *= tmp;
@@ -295,12 +394,16 @@ void gl_shade_vertex(GLVertex* v) {
 			dot = -dot;
 		if (dot > 0) {
 			/* diffuse light */
-			lR += dot * l->diffuse.v[0] * m->diffuse.v[0];
-			lG += dot * l->diffuse.v[1] * m->diffuse.v[1];
-			lB += dot * l->diffuse.v[2] * m->diffuse.v[2];
+			lR += dot * sl->diffuse.X;
+			lG += dot * sl->diffuse.Y;
+			lB += dot * sl->diffuse.Z;
 
 			/* spot light */
-			if (l->spot_cutoff != 180) {
+			if (sl->infinite) {
+				if (sl->spot_out)
+					continue;
+				att = sl->spot_att;
+			} else if (l->spot_cutoff != 180) {
 				dot_spot = -(d.X * l->norm_spot_direction.v[0] + d.Y * l->norm_spot_direction.v[1] + d.Z * l->norm_spot_direction.v[2]);
 				if (twoside && dot_spot < 0)
 					dot_spot = -dot_spot;
@@ -308,9 +411,8 @@ void gl_shade_vertex(GLVertex* v) {
 					/* no contribution */
 					continue;
 				} else {
-					/* TODO: pow table for spot_exponent?*/
 					if (l->spot_exponent > 0) {
-						att = att * pow(dot_spot, l->spot_exponent);
+						att = att * gl_spot_falloff(l, dot_spot);
 					}
 				}
 				
@@ -329,11 +431,13 @@ void gl_shade_vertex(GLVertex* v) {
 					s.X = d.X - vcoord.X;
 					s.Y = d.Y - vcoord.X;
 					s.Z = d.Z - vcoord.X;
+				} else if (sl->infinite) {
+					s = sl->half;
 				} else {
 					
 					s.X = d.X; 
 					s.Y = d.Y; 
-					s.Z = d.Z - 1.0;
+					s.Z = d.Z - 1.0f;
 				}
 				
 				dot_spec = n.X * s.X + n.Y * s.Y + n.Z * s.Z;
@@ -345,15 +449,19 @@ void gl_shade_vertex(GLVertex* v) {
 					GLint idx;
 #endif
 					dot_spec = clampf(dot_spec, 0, 1);
+					if (sl->infinite && !c->local_light_model) {
+						tmp = sl->half_norm;
+					} else {
 #if TGL_FEATURE_FISR == 1
-					tmp = fastInvSqrt(s.X * s.X + s.Y * s.Y + s.Z * s.Z); 
-					
-					{ dot_spec = dot_spec * tmp; }
-					
+						tmp = fastInvSqrt(s.X * s.X + s.Y * s.Y + s.Z * s.Z); 
 #else
-					
-					tmp = sqrt(s.X * s.X + s.Y * s.Y + s.Z * s.Z);
-					if (tmp > 1E-3) {
+						tmp = sqrtf(s.X * s.X + s.Y * s.Y + s.Z * s.Z);
+#endif
+					}
+#if TGL_FEATURE_FISR == 1
+					dot_spec = dot_spec * tmp;
+#else
+					if (tmp > 1E-3f) {
 						dot_spec = dot_spec / tmp;
 					} else
 						dot_spec = 0;
@@ -366,18 +474,22 @@ void gl_shade_vertex(GLVertex* v) {
 #include "error_check.h"
 #endif
 #else
-					dot_spec = pow(dot_spec, m->shininess);
+					dot_spec = powf(dot_spec, m->shininess);
 #endif
 
 #if TGL_FEATURE_SPECULAR_BUFFERS == 1
-					idx = (GLint)(dot_spec * SPECULAR_BUFFER_SIZE);
-					if (idx > SPECULAR_BUFFER_SIZE)
-						idx = SPECULAR_BUFFER_SIZE; /* NOTE by GEK: this is poorly written, it's actually 1 larger.*/
-					dot_spec = specbuf->buf[idx];
+					if (specbuf != NULL) {
+						idx = (GLint)(dot_spec * SPECULAR_BUFFER_SIZE);
+						if (idx > SPECULAR_BUFFER_SIZE)
+							idx = SPECULAR_BUFFER_SIZE; /* NOTE by GEK: this is poorly written, it's actually 1 larger.*/
+						dot_spec = specbuf->buf[idx];
+					} else {
+						dot_spec = powf(dot_spec, m->shininess);
+					}
 #endif
-					lR += dot_spec * l->specular.v[0] * m->specular.v[0];
-					lG += dot_spec * l->specular.v[1] * m->specular.v[1];
-					lB += dot_spec * l->specular.v[2] * m->specular.v[2];
+					lR += dot_spec * sl->specular.X;
+					lG += dot_spec * sl->specular.Y;
+					lB += dot_spec * sl->specular.Z;
 				} 
 			}	 
 		}		  
@@ -392,3 +504,119 @@ void gl_shade_vertex(GLVertex* v) {
 	v->color.v[2] = clampf(B, 0, 1);
 	v->color.v[3] = A;
 }
+
+/*
+Lights the first n vertices of b, transformed by gl_vertex_transform_block(), TGL_LANES at a time with the material
+and the current light state, if every light and the viewer are at infinity: then the direction to a light and the
+specular direction are the same for every vertex. Sets b->lit if it did.
+*/
+void gl_shade_block(GLVertexBlock* b, GLint n) {
+	GLContext* c = gl_get_context();
+	GLMaterial* m = &c->materials[0];
+	GLShadeLight* s;
+	GLLane nx, ny, nz, R, G, B, lR, lG, lB, dot, dot_spec, att, zero, one;
+	GLLaneMask lit, spec;
+	GLfloat f[TGL_LANES];
+	GLint mask[TGL_LANES];
+	GLint i, j, k, lanes, twoside = c->light_model_two_side;
+#if TGL_FEATURE_SPECULAR_BUFFERS == 1
+	GLSpecBuf* specbuf = NULL;
+	GLint idx;
+#endif
+
+	if (c->shade_dirty)
+		gl_shade_setup(c);
+	b->lit = 0;
+	if (!c->shade_infinite)
+		return;
+#if TGL_FEATURE_SPECULAR_BUFFERS == 1
+	if (c->zEnableSpecular) {
+		specbuf = specbuf_get_buffer(c, m->shininess_i, m->shininess);
+/* Check for GL_OUT_OF_MEMORY*/
+#if TGL_FEATURE_ERROR_CHECK == 1
+#include "error_check.h"
+#endif
+	}
+#endif
+	zero = LANE_SET(0.0f);
+	one = LANE_SET(1.0f);
+	lanes = (n + TGL_LANES - 1) & ~(TGL_LANES - 1);
+	for (k = 0; k < lanes; k += TGL_LANES) {
+		nx = LANE_LOAD(b->nx + k);
+		ny = LANE_LOAD(b->ny + k);
+		nz = LANE_LOAD(b->nz + k);
+		R = LANE_SET(c->shade_base.X);
+		G = LANE_SET(c->shade_base.Y);
+		B = LANE_SET(c->shade_base.Z);
+		for (i = 0; i < c->shade_light_n; i++) {
+			s = &c->shade_lights[i];
+			dot = LANE_ADD(LANE_ADD(LANE_MUL(LANE_SET(s->dir.X), nx), LANE_MUL(LANE_SET(s->dir.Y), ny)), LANE_MUL(LANE_SET(s->dir.Z), nz));
+			if (twoside)
+				dot = LANE_ABS(dot);
+			lit = LANE_GT(dot, zero);
+			if (s->spot_out) {
+				/* the vertices facing the light get nothing from it, not even its ambient */
+				R = LANE_ADD(R, LANE_IF_NOT(lit, LANE_SET(s->ambient.X)));
+				G = LANE_ADD(G, LANE_IF_NOT(lit, LANE_SET(s->ambient.Y)));
+				B = LANE_ADD(B, LANE_IF_NOT(lit, LANE_SET(s->ambient.Z)));
+				continue;
+			}
+			/* ambient and diffuse light */
+			lR = LANE_ADD(LANE_SET(s->ambient.X), LANE_IF(lit, LANE_MUL(dot, LANE_SET(s->diffuse.X))));
+			lG = LANE_ADD(LANE_SET(s->ambient.Y), LANE_IF(lit, LANE_MUL(dot, LANE_SET(s->diffuse.Y))));
+			lB = LANE_ADD(LANE_SET(s->ambient.Z), LANE_IF(lit, LANE_MUL(dot, LANE_SET(s->diffuse.Z))));
+
+			/* specular light */
+			if (c->zEnableSpecular) {
+				dot_spec = LANE_ADD(LANE_ADD(LANE_MUL(nx, LANE_SET(s->half.X)), LANE_MUL(ny, LANE_SET(s->half.Y))),
+									LANE_MUL(nz, LANE_SET(s->half.Z)));
+				if (twoside)
+					dot_spec = LANE_ABS(dot_spec);
+				spec = LANE_MASK_AND(lit, LANE_GT(dot_spec, zero));
+				if (LANE_MASK_ANY(spec)) {
+					dot_spec = LANE_MIN(dot_spec, one);
+#if TGL_FEATURE_FISR == 1
+					dot_spec = LANE_MUL(dot_spec, LANE_SET(s->half_norm));
+#else
+					if (s->half_norm > 1E-3f)
+						dot_spec = LANE_DIV(dot_spec, LANE_SET(s->half_norm));
+					else
+						dot_spec = zero;
+#endif
+					/* the power of each lane lit */
+					LANE_STORE(f, dot_spec);
+					LANE_STORE_MASK(mask, spec);
+					for (j = 0; j < TGL_LANES; j++) {
+						if (!mask[j])
+							continue;
+#if TGL_FEATURE_SPECULAR_BUFFERS == 1
+						if (specbuf != NULL) {
+							idx = (GLint)(f[j] * SPECULAR_BUFFER_SIZE);
+							if (idx > SPECULAR_BUFFER_SIZE)
+								idx = SPECULAR_BUFFER_SIZE;
+							f[j] = specbuf->buf[idx];
+							continue;
+						}
+#endif
+						f[j] = powf(f[j], m->shininess);
+					}
+					dot_spec = LANE_LOAD(f);
+					lR = LANE_ADD(lR, LANE_IF(spec, LANE_MUL(dot_spec, LANE_SET(s->specular.X))));
+					lG = LANE_ADD(lG, LANE_IF(spec, LANE_MUL(dot_spec, LANE_SET(s->specular.Y))));
+					lB = LANE_ADD(lB, LANE_IF(spec, LANE_MUL(dot_spec, LANE_SET(s->specular.Z))));
+				}
+			}
+
+			/* the spot factor only applies to the vertices facing the light */
+			att = LANE_ADD(LANE_IF(lit, LANE_SET(s->spot_att)), LANE_IF_NOT(lit, one));
+			R = LANE_ADD(R, LANE_MUL(att, lR));
+			G = LANE_ADD(G, LANE_MUL(att, lG));
+			B = LANE_ADD(B, LANE_MUL(att, lB));
+		}
+		LANE_STORE(b->r + k, LANE_MAX(LANE_MIN(R, one), zero));
+		LANE_STORE(b->g + k, LANE_MAX(LANE_MIN(G, one), zero));
+		LANE_STORE(b->b + k, LANE_MAX(LANE_MIN(B, one), zero));
+	}
+	b->a = m->diffuse.v[3];
+	b->lit = 1;
+}
@@ -23,17 +23,12 @@ GLint op_table_size[] = {
 
 static GLList* find_list(GLuint list) { return gl_get_context()->shared_state.lists[list]; }
 
-static void delete_list(GLint list) {
-	GLContext* c = gl_get_context();
+void gl_free_list(GLList* l) {
 	GLParamBuffer *pb, *pb1;
-	GLList* l;
-
-	l = find_list(list);
-	if (l == NULL) { 
-		return;
-	}
-	
 
+#if TGL_FEATURE_LIST_OPTIMIZER == 1
+	gl_free_list_batches(l->first_op_buffer);
+#endif
 	/* free param buffer */
 	pb = l->first_op_buffer;
 	while (pb != NULL) {
@@ -41,8 +36,25 @@ static void delete_list(GLint list) {
 		gl_free(pb);
 		pb = pb1;
 	}
-
+	pb = l->compiled_op_buffer;
+	while (pb != NULL) {
+		pb1 = pb->next;
+		gl_free(pb);
+		pb = pb1;
+	}
 	gl_free(l);
+}
+
+static void delete_list(GLint list) {
+	GLContext* c = gl_get_context();
+	GLList* l;
+
+	l = find_list(list);
+	if (l == NULL) { 
+		return;
+	}
+	
+	gl_free_list(l);
 	c->shared_state.lists[list] = NULL;
 }
 void glDeleteLists(GLuint list, GLuint range) {
@@ -53,6 +65,7 @@ void glDeleteLists(GLuint list, GLuint range) {
 }
 void glDeleteList(GLuint list) {
 #include "error_check_no_context.h"
+	gl_render_sync();
 	delete_list(list);
 }
 
@@ -116,6 +129,7 @@ void gl_print_op(FILE* f, GLParam* p) {
 void glListBase(GLint n) {
 	GLContext* c = gl_get_context();
 #include "error_check.h"
+	gl_render_sync();
 	c->listbase = n;
 }
 void glCallLists(GLsizei n, GLenum type, const GLuint* lists) {
@@ -194,6 +208,9 @@ void glopCallList(GLParam* p) {
 	
 #endif
 	p = l->first_op_buffer->ops;
+	/* the optimized ops transform the vertices ahead by the list's own modelview matrix ops */
+	if (l->compiled_op_buffer != NULL && gl_get_context()->matrix_mode != 0)
+		p = l->compiled_op_buffer->ops;
 
 	while (1) {
 		GLint op;
@@ -210,10 +227,25 @@ void glopCallList(GLParam* p) {
 	}
 }
 
+static GLint count_ops(GLParamBuffer* pb) {
+	GLParam* p = pb->ops;
+	GLint n = 0;
+	while (p[0].op != OP_EndList) {
+		if (p[0].op == OP_NextBuffer) {
+			p = (GLParam*)p[1].p;
+		} else {
+			p += op_table_size[p[0].op];
+			n++;
+		}
+	}
+	return n;
+}
+
 void glNewList(GLuint list, GLint mode) {
 	GLList* l;
 	GLContext* c = gl_get_context();
 #include "error_check.h"
+	gl_render_sync();
 
 #if TGL_FEATURE_ERROR_CHECK == 1
 
@@ -245,6 +277,7 @@ void glNewList(GLuint list, GLint mode) {
 #endif
 		c->current_op_buffer = l->first_op_buffer;
 	c->current_op_buffer_index = 0;
+	c->current_list = list;
 
 	c->compile_flag = 1;
 	c->exec_flag = (mode == GL_COMPILE_AND_EXECUTE);
@@ -253,7 +286,9 @@ void glNewList(GLuint list, GLint mode) {
 void glEndList(void) {
 	GLContext* c = gl_get_context();
 	GLParam p[1];
+	GLList* l;
 #include "error_check.h"
+	gl_render_sync();
 #if TGL_FEATURE_ERROR_CHECK == 1
 	if (c->compile_flag != 1)
 #define ERROR_FLAG GL_INVALID_OPERATION
@@ -268,11 +303,28 @@ void glEndList(void) {
 
 	c->compile_flag = 0;
 	c->exec_flag = 1;
+
+	l = find_list(c->current_list);
+	l->compiled_ops = l->optimized_ops = count_ops(l->first_op_buffer);
+#if TGL_FEATURE_LIST_OPTIMIZER == 1
+	gl_optimize_list(l);
+	if (c->print_flag)
+		tgl_trace("list %d: %d ops compiled, %d after optimization\n", c->current_list, l->compiled_ops, l->optimized_ops);
+#endif
+}
+
+void glGetListOpCounts(GLuint list, GLint* compiled, GLint* optimized) {
+	GLList* l;
+	gl_render_sync();
+	l = find_list(list);
+	*compiled = (l != NULL) ? l->compiled_ops : 0;
+	*optimized = (l != NULL) ? l->optimized_ops : 0;
 }
 
 GLint glIsList(GLuint list) {
 	
 	GLList* l;
+	gl_render_sync();
 	l = find_list(list);
 	return (l != NULL);
 }
@@ -283,6 +335,7 @@ GLuint glGenLists(GLint range) {
 	GLContext* c = gl_get_context();
 #define RETVAL 0
 #include "error_check.h"
+	gl_render_sync();
 	lists = c->shared_state.lists;
 	count = 0;
 	for (i = 0; i < MAX_DISPLAY_LISTS; i++) {
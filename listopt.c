@@ -0,0 +1,613 @@
+/*
+ * Display list optimizer.
+ * glEndList() runs the ops of the new list through gl_optimize_list(), which writes them again to new buffers:
+ * - matrix ops are not written right away but multiplied together, and written as one op when something needs the
+ *   current matrix. A PushMatrix directly followed by a PopMatrix is dropped, with any matrix ops in between.
+ * - a primitive drawn while such matrix ops are pending is transformed by them instead, its normals by the inverse
+ *   transpose, so that the matrix doesn't change between primitives. That needs the modelview matrix to be current:
+ *   unless the list itself selects it with glMatrixMode(), the ops as compiled are kept too, and glCallList() runs
+ *   them when another matrix is current.
+ * - Normal ops are written only before the ops reading the normal, and state ops which set what the previous op of
+ *   the same kind already did are dropped.
+ * - a Begin/End block of nothing but vertices and their attributes becomes a single DrawBatch op, which holds the
+ *   vertices packed together and which glopDrawBatch() sends to glopVertex() in one loop.
+ */
+#include "msghandling.h"
+#include "zgl.h"
+#include <string.h>
+
+#if TGL_FEATURE_LIST_OPTIMIZER == 1
+
+/* how many state ops are remembered */
+#define LISTOPT_STATES 32
+/* the normal wasn't written since the list set it */
+#define NORMAL_PENDING -1
+/* the normal was written as set, not transformed */
+#define NORMAL_WRITTEN 0
+
+/* the matrix ops pending multiply the current matrix */
+#define MATRIX_MULT 1
+/* the matrix ops pending replace the current matrix */
+#define MATRIX_LOAD 2
+
+typedef struct GLListWriter {
+	GLParamBuffer *first, *ob;
+	GLint index;
+	GLint last; /* index of the last op written in ob, -1 if unknown */
+	GLint ops;
+	GLint failed;
+} GLListWriter;
+
+typedef struct GLListOptimizer {
+	GLListWriter w;
+	M4 m; /* the matrix ops pending, multiplied together */
+	GLint matrix_pending;
+	GLint serial; /* changes with m */
+	GLint mode; /* matrix mode, -1 if unknown */
+	GLint mode_assumed; /* the modelview matrix is assumed to be current, the list didn't select it */
+	GLint needs_modelview;
+	GLint pretransform; /* the current primitive is transformed by m */
+	GLfloat normal[3]; /* the last normal the list set */
+	GLint normal_known;
+	GLint normal_written; /* NORMAL_PENDING, NORMAL_WRITTEN or the serial of the m it was transformed by */
+	M4 normal_m;
+	GLint normal_m_serial;
+	GLParam states[LISTOPT_STATES][8];
+	GLint nstates;
+} GLListOptimizer;
+
+static GLParam* next_op(GLParam* p) {
+	p += op_table_size[p[0].op];
+	if (p[0].op == OP_NextBuffer)
+		p = (GLParam*)p[1].p;
+	return p;
+}
+
+static void writer_put(GLListWriter* w, GLParam* p) {
+	GLint size = op_table_size[p[0].op], i;
+	if (w->failed)
+		return;
+	/* room for a NextBuffer op is kept */
+	if (w->index + size > OP_BUFFER_MAX_SIZE - 2) {
+		GLParamBuffer* ob1 = gl_zalloc(sizeof(GLParamBuffer));
+		if (ob1 == NULL) {
+			/* ends the ops written so far, so that they can be freed */
+			w->ob->ops[w->index].op = OP_EndList;
+			w->failed = 1;
+			return;
+		}
+		w->ob->next = ob1;
+		w->ob->ops[w->index].op = OP_NextBuffer;
+		w->ob->ops[w->index + 1].p = (void*)ob1;
+		w->ob = ob1;
+		w->index = 0;
+	}
+	w->last = w->index;
+	for (i = 0; i < size; i++)
+		w->ob->ops[w->index++] = p[i];
+	if (p[0].op != OP_EndList)
+		w->ops++;
+}
+
+static GLint writer_last_op(GLListWriter* w) { return (w->last < 0 || w->failed) ? -1 : w->ob->ops[w->last].op; }
+
+static void writer_drop_last(GLListWriter* w) {
+	w->index = w->last;
+	w->last = -1;
+	w->ops--;
+}
+
+void gl_free_list_batches(GLParamBuffer* pb) {
+	GLParam* p = pb->ops;
+	GLBatch* b;
+	while (p[0].op != OP_EndList) {
+		if (p[0].op == OP_DrawBatch) {
+			b = (GLBatch*)p[1].p;
+			gl_free(b->vertices);
+			gl_free(b);
+		}
+		p = next_op(p);
+	}
+}
+
+static void free_op_buffers(GLParamBuffer* pb) {
+	GLParamBuffer* pb1;
+	while (pb != NULL) {
+		pb1 = pb->next;
+		gl_free(pb);
+		pb = pb1;
+	}
+}
+
+/* Forgets the state ops of kind op, all of them if op is -1. */
+static void forget_state(GLListOptimizer* o, GLint op) {
+	GLint i = 0;
+	while (i < o->nstates) {
+		if (op == -1 || o->states[i][0].op == op)
+			memcpy(o->states[i], o->states[--o->nstates], sizeof(o->states[0]));
+		else
+			i++;
+	}
+}
+
+/* Returns 1 if p sets state to what it already is. Remembers p otherwise. */
+static GLint redundant_state(GLListOptimizer* o, GLParam* p) {
+	GLint op = p[0].op, size, i, j;
+	switch (op) {
+	case OP_Color:
+	case OP_TexCoord:
+	case OP_EdgeFlag:
+	case OP_Normal:
+	case OP_ShadeModel:
+	case OP_CullFace:
+	case OP_FrontFace:
+	case OP_PointSize:
+	case OP_BindTexture:
+	case OP_EnableDisable:
+		break;
+	default:
+		return 0;
+	}
+	size = op_table_size[op];
+	for (i = 0; i < o->nstates; i++) {
+		if (o->states[i][0].op != op || (op == OP_EnableDisable && o->states[i][1].i != p[1].i))
+			continue;
+		for (j = 1; j < size; j++)
+			if (o->states[i][j].ui != p[j].ui)
+				break;
+		if (j == size)
+			return 1;
+		break;
+	}
+	if (i == o->nstates) {
+		if (o->nstates == LISTOPT_STATES)
+			return 0;
+		o->nstates++;
+	}
+	for (j = 0; j < size; j++)
+		o->states[i][j] = p[j];
+	return 0;
+}
+
+static void emit(GLListOptimizer* o, GLParam* p) {
+	if (!redundant_state(o, p))
+		writer_put(&o->w, p);
+}
+
+/* Writes the matrix ops pending, as one op. */
+static void flush_matrix(GLListOptimizer* o) {
+	GLParam p[17];
+	GLfloat* m = &o->m.m[0][0];
+	GLint i, j, linear, diagonal;
+	if (!o->matrix_pending)
+		return;
+	linear = (m[12] == 0 && m[13] == 0 && m[14] == 0 && m[15] == 1);
+	diagonal = (m[1] == 0 && m[2] == 0 && m[4] == 0 && m[6] == 0 && m[8] == 0 && m[9] == 0);
+	if (o->matrix_pending == MATRIX_LOAD && gl_M4_IsId(&o->m)) {
+		p[0].op = OP_LoadIdentity;
+	} else if (o->matrix_pending == MATRIX_MULT && gl_M4_IsId(&o->m)) {
+		o->matrix_pending = 0;
+		return;
+	} else if (o->matrix_pending == MATRIX_MULT && linear && diagonal && m[0] == 1 && m[5] == 1 && m[10] == 1) {
+		p[0].op = OP_Translate;
+		p[1].f = m[3];
+		p[2].f = m[7];
+		p[3].f = m[11];
+	} else if (o->matrix_pending == MATRIX_MULT && linear && diagonal && m[3] == 0 && m[7] == 0 && m[11] == 0) {
+		p[0].op = OP_Scale;
+		p[1].f = m[0];
+		p[2].f = m[5];
+		p[3].f = m[10];
+	} else {
+		p[0].op = (o->matrix_pending == MATRIX_LOAD) ? OP_LoadMatrix : OP_MultMatrix;
+		/* column major, like glMultMatrixf() takes it */
+		for (i = 0; i < 4; i++)
+			for (j = 0; j < 4; j++)
+				p[1 + i * 4 + j].f = o->m.m[j][i];
+	}
+	emit(o, p);
+	o->matrix_pending = 0;
+}
+
+/* Writes the normal the list set, if the current one is something else. */
+static void write_normal(GLListOptimizer* o) {
+	GLParam p[4];
+	if (!o->normal_known || o->normal_written == NORMAL_WRITTEN)
+		return;
+	p[0].op = OP_Normal;
+	p[1].f = o->normal[0];
+	p[2].f = o->normal[1];
+	p[3].f = o->normal[2];
+	emit(o, p);
+	o->normal_written = NORMAL_WRITTEN;
+}
+
+/* Transforms the normal n by m, into q[0] to q[2]. */
+static void transform_normal(GLListOptimizer* o, GLfloat* n, GLParam* q) {
+	M4* m = &o->normal_m;
+	if (o->normal_m_serial != o->serial) {
+		gl_M4_Inv(m, &o->m);
+		o->normal_m_serial = o->serial;
+	}
+	/* times the transposed inverse */
+	q[0].f = m->m[0][0] * n[0] + m->m[1][0] * n[1] + m->m[2][0] * n[2];
+	q[1].f = m->m[0][1] * n[0] + m->m[1][1] * n[1] + m->m[2][1] * n[2];
+	q[2].f = m->m[0][2] * n[0] + m->m[1][2] * n[1] + m->m[2][2] * n[2];
+}
+
+/* Transforms the vertex coordinates p[0] to p[3] by m, into q[0] to q[3]. */
+static void transform_vertex(GLListOptimizer* o, GLParam* p, GLParam* q) {
+	GLfloat* m = &o->m.m[0][0];
+	q[0].f = m[0] * p[0].f + m[1] * p[1].f + m[2] * p[2].f + m[3];
+	q[1].f = m[4] * p[0].f + m[5] * p[1].f + m[6] * p[2].f + m[7];
+	q[2].f = m[8] * p[0].f + m[9] * p[1].f + m[10] * p[2].f + m[11];
+	q[3].f = p[3].f;
+}
+
+/* Writes the normal the list set transformed by m, if the current one is something else. */
+static void write_normal_transformed(GLListOptimizer* o) {
+	GLParam p[4];
+	if (o->normal_written == o->serial)
+		return;
+	p[0].op = OP_Normal;
+	transform_normal(o, o->normal, p + 1);
+	emit(o, p);
+	o->normal_written = o->serial;
+}
+
+/* Returns 1 if the primitive starting at the Begin op p can be transformed by the matrix ops pending. */
+static GLint can_pretransform(GLListOptimizer* o, GLParam* p) {
+	GLfloat* m = &o->m.m[0][0];
+	GLint normal = o->normal_known;
+	GLfloat det;
+	if (!o->matrix_pending || o->mode != 0)
+		return 0;
+	/* vertices are transformed as if w was 1, which an affine matrix keeps */
+	if (m[12] != 0 || m[13] != 0 || m[14] != 0 || m[15] != 1)
+		return 0;
+	det = m[0] * (m[5] * m[10] - m[6] * m[9]) - m[1] * (m[4] * m[10] - m[6] * m[8]) + m[2] * (m[4] * m[9] - m[5] * m[8]);
+	if (det == 0)
+		return 0;
+	for (p = next_op(p); p[0].op != OP_End; p = next_op(p)) {
+		switch (p[0].op) {
+		case OP_Normal:
+			normal = 1;
+			break;
+		case OP_Vertex:
+			/* the normal the vertex gets must be known to be transformed */
+			if (!normal)
+				return 0;
+			break;
+		case OP_Color:
+		case OP_TexCoord:
+		case OP_EdgeFlag:
+		case OP_Material:
+			break;
+		default:
+			return 0;
+		}
+	}
+	return 1;
+}
+
+static GLParam* optimize_op(GLListOptimizer* o, GLParam* p);
+
+/*
+ * Writes the Begin/End block starting at p as a DrawBatch op, the vertices transformed by m if o->pretransform is set.
+ * Returns the op after the End op, or NULL if the block has other ops than Normal, Color, TexCoord, EdgeFlag and
+ * Vertex ones, or no vertex.
+ */
+static GLParam* write_batch(GLListOptimizer* o, GLParam* p) {
+	GLBatch* b;
+	GLParam *q, *v, *last = NULL, *prev = NULL;
+	GLParam normal[3], color[4], tex_coord[4], edge_flag[1], op[2];
+	GLint attribs = 0, changed = 0, n = 0;
+
+	for (q = next_op(p); q[0].op != OP_End; q = next_op(q)) {
+		switch (q[0].op) {
+		case OP_Vertex:
+			last = q;
+			n++;
+			break;
+		case OP_Normal:
+			attribs |= BATCH_NORMAL;
+			break;
+		case OP_Color:
+			attribs |= BATCH_COLOR;
+			break;
+		case OP_TexCoord:
+			attribs |= BATCH_TEX_COORD;
+			break;
+		case OP_EdgeFlag:
+			attribs |= BATCH_EDGE_FLAG;
+			break;
+		default:
+			return NULL;
+		}
+	}
+	if (n == 0)
+		return NULL;
+
+	b = gl_malloc(sizeof(GLBatch));
+	if (b == NULL)
+		return NULL;
+	b->type = p[1].i;
+	b->n = n;
+	b->stride = 5;
+	b->normal = (attribs & BATCH_NORMAL) ? b->stride : 0;
+	b->stride += (attribs & BATCH_NORMAL) ? 3 : 0;
+	b->color = (attribs & BATCH_COLOR) ? b->stride : 0;
+	b->stride += (attribs & BATCH_COLOR) ? 4 : 0;
+	b->tex_coord = (attribs & BATCH_TEX_COORD) ? b->stride : 0;
+	b->stride += (attribs & BATCH_TEX_COORD) ? 4 : 0;
+	b->edge_flag = (attribs & BATCH_EDGE_FLAG) ? b->stride : 0;
+	b->stride += (attribs & BATCH_EDGE_FLAG) ? 1 : 0;
+	b->vertices = gl_malloc(n * b->stride * sizeof(GLParam));
+	if (b->vertices == NULL) {
+		gl_free(b);
+		return NULL;
+	}
+
+	v = b->vertices;
+	for (q = next_op(p); q != next_op(last); q = next_op(q)) {
+		switch (q[0].op) {
+		case OP_Normal:
+			o->normal[0] = q[1].f;
+			o->normal[1] = q[2].f;
+			o->normal[2] = q[3].f;
+			if (o->pretransform)
+				transform_normal(o, o->normal, normal);
+			else
+				memcpy(normal, q + 1, sizeof(normal));
+			changed |= BATCH_NORMAL;
+			break;
+		case OP_Color:
+			memcpy(color, q + 1, sizeof(color));
+			changed |= BATCH_COLOR;
+			break;
+		case OP_TexCoord:
+			memcpy(tex_coord, q + 1, sizeof(tex_coord));
+			changed |= BATCH_TEX_COORD;
+			break;
+		case OP_EdgeFlag:
+			edge_flag[0] = q[1];
+			changed |= BATCH_EDGE_FLAG;
+			break;
+		case OP_Vertex:
+			/* the first vertex may use the normal set before the block */
+			if (prev == NULL && !(changed & BATCH_NORMAL)) {
+				if (o->pretransform)
+					write_normal_transformed(o);
+				else
+					write_normal(o);
+			}
+			v[0].i = changed;
+			if (o->pretransform)
+				transform_vertex(o, q + 1, v + 1);
+			else
+				memcpy(v + 1, q + 1, 4 * sizeof(GLParam));
+			if (changed & BATCH_NORMAL)
+				memcpy(v + b->normal, normal, sizeof(normal));
+			if (changed & BATCH_COLOR)
+				memcpy(v + b->color, color, sizeof(color));
+			if (changed & BATCH_TEX_COORD)
+				memcpy(v + b->tex_coord, tex_coord, sizeof(tex_coord));
+			if (changed & BATCH_EDGE_FLAG)
+				v[b->edge_flag] = edge_flag[0];
+			changed = 0;
+			prev = v;
+			v += b->stride;
+			break;
+		}
+	}
+
+	op[0].op = OP_DrawBatch;
+	op[1].p = b;
+	writer_put(&o->w, op);
+	if (o->w.failed) {
+		gl_free(b->vertices);
+		gl_free(b);
+	}
+	/* the batch leaves the attributes as its last vertex got them */
+	forget_state(o, OP_Normal);
+	forget_state(o, OP_Color);
+	forget_state(o, OP_TexCoord);
+	forget_state(o, OP_EdgeFlag);
+	if (attribs & BATCH_NORMAL) {
+		o->normal_known = 1;
+		o->normal_written = o->pretransform ? o->serial : NORMAL_WRITTEN;
+	}
+
+	/* the ops after the last vertex only set attributes */
+	for (q = next_op(last); q[0].op != OP_End; q = next_op(q))
+		optimize_op(o, q);
+	return next_op(q);
+}
+
+static GLParam* optimize_op(GLListOptimizer* o, GLParam* p) {
+	GLParam q[5];
+	GLParam* next;
+	GLint i, j;
+
+	switch (p[0].op) {
+	case OP_Translate:
+	case OP_Scale:
+	case OP_Rotate:
+	case OP_MultMatrix:
+		if (!o->matrix_pending) {
+			gl_M4_Id(&o->m);
+			o->matrix_pending = MATRIX_MULT;
+		}
+		gl_matrix_op(&o->m, p);
+		o->serial++;
+		break;
+	case OP_LoadIdentity:
+		gl_M4_Id(&o->m);
+		o->matrix_pending = MATRIX_LOAD;
+		o->serial++;
+		break;
+	case OP_LoadMatrix:
+		for (i = 0; i < 4; i++)
+			for (j = 0; j < 4; j++)
+				o->m.m[j][i] = p[1 + i * 4 + j].f;
+		o->matrix_pending = MATRIX_LOAD;
+		o->serial++;
+		break;
+	case OP_PushMatrix:
+		flush_matrix(o);
+		emit(o, p);
+		break;
+	case OP_PopMatrix:
+		/* the matrix is replaced anyway */
+		o->matrix_pending = 0;
+		if (writer_last_op(&o->w) == OP_PushMatrix)
+			writer_drop_last(&o->w);
+		else
+			emit(o, p);
+		break;
+	case OP_MatrixMode:
+		flush_matrix(o);
+		emit(o, p);
+		o->mode = (p[1].i == GL_MODELVIEW) ? 0 : (p[1].i == GL_PROJECTION) ? 1 : (p[1].i == GL_TEXTURE) ? 2 : -1;
+		o->mode_assumed = 0;
+		break;
+	case OP_Normal:
+		/* written once a vertex needs it */
+		o->normal[0] = p[1].f;
+		o->normal[1] = p[2].f;
+		o->normal[2] = p[3].f;
+		o->normal_known = 1;
+		o->normal_written = NORMAL_PENDING;
+		break;
+	case OP_Begin:
+		o->pretransform = can_pretransform(o, p);
+		if (o->pretransform) {
+			if (o->mode_assumed)
+				o->needs_modelview = 1;
+			/* the matrix is loaded without the ops, which the vertices get instead */
+			if (o->matrix_pending == MATRIX_LOAD) {
+				q[0].op = OP_LoadIdentity;
+				emit(o, q);
+				o->matrix_pending = MATRIX_MULT;
+			}
+		} else {
+			flush_matrix(o);
+		}
+		next = write_batch(o, p);
+		if (next != NULL) {
+			o->pretransform = 0;
+			return next;
+		}
+		emit(o, p);
+		break;
+	case OP_Vertex:
+		if (o->pretransform) {
+			write_normal_transformed(o);
+			q[0].op = OP_Vertex;
+			transform_vertex(o, p + 1, q + 1);
+			emit(o, q);
+		} else {
+			flush_matrix(o);
+			write_normal(o);
+			emit(o, p);
+		}
+		break;
+	case OP_End:
+		o->pretransform = 0;
+		emit(o, p);
+		break;
+	case OP_Material:
+	case OP_ColorMaterial:
+	case OP_EnableDisable:
+		/* a Color op sets the material if GL_COLOR_MATERIAL is enabled */
+		forget_state(o, OP_Color);
+		emit(o, p);
+		break;
+	case OP_Color:
+	case OP_TexCoord:
+	case OP_EdgeFlag:
+	case OP_ShadeModel:
+	case OP_CullFace:
+	case OP_FrontFace:
+	case OP_PolygonMode:
+	case OP_BindTexture:
+	case OP_PointSize:
+	case OP_LightModel:
+	case OP_PolygonOffset:
+	case OP_BlendFunc:
+	case OP_BlendEquation:
+		/* neither reads the matrix nor the normal */
+		emit(o, p);
+		break;
+	case OP_CallList:
+		flush_matrix(o);
+		write_normal(o);
+		emit(o, p);
+		/* the list called can change anything */
+		o->mode = -1;
+		o->mode_assumed = 0;
+		o->normal_known = 0;
+		o->normal_written = NORMAL_WRITTEN;
+		forget_state(o, -1);
+		break;
+	case OP_ArrayElement:
+	case OP_DrawArrays:
+		flush_matrix(o);
+		write_normal(o);
+		emit(o, p);
+		o->normal_known = 0;
+		o->normal_written = NORMAL_WRITTEN;
+		forget_state(o, OP_Color);
+		forget_state(o, OP_Normal);
+		forget_state(o, OP_TexCoord);
+		break;
+	default:
+		flush_matrix(o);
+		write_normal(o);
+		emit(o, p);
+		break;
+	}
+	return next_op(p);
+}
+
+void gl_optimize_list(GLList* l) {
+	GLListOptimizer* o;
+	GLParam* p;
+	GLParam end[1];
+
+	o = gl_zalloc(sizeof(GLListOptimizer));
+	if (o == NULL)
+		return;
+	o->w.first = o->w.ob = gl_zalloc(sizeof(GLParamBuffer));
+	if (o->w.first == NULL) {
+		gl_free(o);
+		return;
+	}
+	o->w.last = -1;
+	o->mode_assumed = 1;
+	o->normal_written = NORMAL_WRITTEN;
+
+	p = l->first_op_buffer->ops;
+	while (p[0].op != OP_EndList)
+		p = optimize_op(o, p);
+	flush_matrix(o);
+	write_normal(o);
+	end[0].op = OP_EndList;
+	writer_put(&o->w, end);
+
+	if (o->w.failed) {
+		gl_free_list_batches(o->w.first);
+		free_op_buffers(o->w.first);
+	} else {
+		/* the ops as compiled run when the vertices can't be transformed ahead */
+		if (o->needs_modelview)
+			l->compiled_op_buffer = l->first_op_buffer;
+		else
+			free_op_buffers(l->first_op_buffer);
+		l->first_op_buffer = o->w.first;
+		l->optimized_ops = o->w.ops;
+	}
+	gl_free(o);
+}
+
+#endif
@@ -63,22 +63,7 @@ void glopLoadIdentity(GLParam* p) {
 
 void glopMultMatrix(GLParam* p) {
 	GLContext* c = gl_get_context();
-	M4 m;
-	GLint i;
-
-	GLParam* q;
-	q = p + 1;
-
-	for (i = 0; i < 4; i++) {
-		m.m[0][i] = q[0].f;
-		m.m[1][i] = q[1].f;
-		m.m[2][i] = q[2].f;
-		m.m[3][i] = q[3].f;
-		q += 4;
-	}
-
-	gl_M4_MulLeft(c->matrix_stack_ptr[c->matrix_mode], &m);
-
+	gl_matrix_op(c->matrix_stack_ptr[c->matrix_mode], p);
 	gl_matrix_update();
 }
 
@@ -115,8 +100,7 @@ void glopPopMatrix(GLParam* p) {
 	gl_matrix_update();
 }
 
-void glopRotate(GLParam* p) {
-	GLContext* c = gl_get_context();
+static void gl_matrix_rotate(M4* r, GLParam* p) {
 	M4 m;
 	GLfloat u[3];
 	GLfloat angle;
@@ -189,17 +173,14 @@ void glopRotate(GLParam* p) {
 	}
 	}
 
-	gl_M4_MulLeft(c->matrix_stack_ptr[c->matrix_mode], &m);
-
-	gl_matrix_update();
+	gl_M4_MulLeft(r, &m);
 }
 
-void glopScale(GLParam* p) {
-	GLContext* c = gl_get_context();
+static void gl_matrix_scale(M4* r, GLParam* p) {
 	GLfloat* m;
 	GLfloat x = p[1].f, y = p[2].f, z = p[3].f;
 
-	m = &c->matrix_stack_ptr[c->matrix_mode]->m[0][0];
+	m = &r->m[0][0];
 
 	m[0] *= x;
 	m[1] *= y;
@@ -213,21 +194,67 @@ void glopScale(GLParam* p) {
 	m[12] *= x;
 	m[13] *= y;
 	m[14] *= z;
-	gl_matrix_update();
 }
 
-void glopTranslate(GLParam* p) {
-	GLContext* c = gl_get_context();
+static void gl_matrix_translate(M4* r, GLParam* p) {
 	GLfloat* m;
 	GLfloat x = p[1].f, y = p[2].f, z = p[3].f;
 
-	m = &c->matrix_stack_ptr[c->matrix_mode]->m[0][0];
+	m = &r->m[0][0];
 
 	m[3] = m[0] * x + m[1] * y + m[2] * z + m[3];
 	m[7] = m[4] * x + m[5] * y + m[6] * z + m[7];
 	m[11] = m[8] * x + m[9] * y + m[10] * z + m[11];
 	m[15] = m[12] * x + m[13] * y + m[14] * z + m[15];
+}
 
+/* Multiplies m by the matrix of a Translate, Scale, Rotate or MultMatrix op, as the op does to the current matrix. */
+void gl_matrix_op(M4* m, GLParam* p) {
+	M4 t;
+	GLint i;
+	GLParam* q;
+
+	switch (p[0].op) {
+	case OP_Translate:
+		gl_matrix_translate(m, p);
+		break;
+	case OP_Scale:
+		gl_matrix_scale(m, p);
+		break;
+	case OP_Rotate:
+		gl_matrix_rotate(m, p);
+		break;
+	case OP_MultMatrix:
+		q = p + 1;
+		for (i = 0; i < 4; i++) {
+			t.m[0][i] = q[0].f;
+			t.m[1][i] = q[1].f;
+			t.m[2][i] = q[2].f;
+			t.m[3][i] = q[3].f;
+			q += 4;
+		}
+		gl_M4_MulLeft(m, &t);
+		break;
+	default:
+		break;
+	}
+}
+
+void glopRotate(GLParam* p) {
+	GLContext* c = gl_get_context();
+	gl_matrix_op(c->matrix_stack_ptr[c->matrix_mode], p);
+	gl_matrix_update();
+}
+
+void glopScale(GLParam* p) {
+	GLContext* c = gl_get_context();
+	gl_matrix_op(c->matrix_stack_ptr[c->matrix_mode], p);
+	gl_matrix_update();
+}
+
+void glopTranslate(GLParam* p) {
+	GLContext* c = gl_get_context();
+	gl_matrix_op(c->matrix_stack_ptr[c->matrix_mode], p);
 	gl_matrix_update();
 }
 
@@ -5,8 +5,10 @@ void glPolygonStipple(void* a) {
 #if TGL_FEATURE_POLYGON_STIPPLE == 1
 	GLContext* c = gl_get_context();
 #include "error_check.h"
+	gl_render_sync();
 	ZBuffer* zb = c->zb;
 
+	ZB_flushTiles(zb);
 	memcpy(zb->stipplepattern, a, TGL_POLYGON_STIPPLE_BYTES);
 	for (GLint i = 0; i < TGL_POLYGON_STIPPLE_BYTES; i++) {
 		zb->stipplepattern[i] = ((GLubyte*)a)[i];
@@ -61,6 +63,7 @@ void glopBlendFunc(GLParam* p) {
 	GLContext* c = gl_get_context();
 	c->zb->sfactor = p[1].i;
 	c->zb->dfactor = p[2].i;
+	c->fill_funcs_dirty = 1;
 }
 
 void glBlendEquation(GLenum mode) {
@@ -73,6 +76,7 @@ void glBlendEquation(GLenum mode) {
 void glopBlendEquation(GLParam* p) {
 	GLContext* c = gl_get_context();
 	c->zb->blendeq = p[1].i;
+	c->fill_funcs_dirty = 1;
 }
 
 void glopPointSize(GLParam* p) {
@@ -107,12 +111,14 @@ void glopEnableDisable(GLParam* p) {
 		break;
 	case GL_BLEND:
 		c->zb->enable_blend = v;
+		c->fill_funcs_dirty = 1;
 		break;
 	case GL_NORMALIZE:
 		c->normalize_enabled = v;
 		break;
 	case GL_DEPTH_TEST:
 		c->zb->depth_test = v;
+		c->fill_funcs_dirty = 1;
 		break;
 	case GL_POLYGON_OFFSET_FILL:
 		if (v)
@@ -123,6 +129,7 @@ void glopEnableDisable(GLParam* p) {
 	case GL_POLYGON_STIPPLE:
 #if TGL_FEATURE_POLYGON_STIPPLE == 1
 		c->zb->dostipple = v;
+		c->fill_funcs_dirty = 1;
 #endif
 		break;
 	case GL_POLYGON_OFFSET_POINT:
@@ -195,7 +202,9 @@ void glopPolygonOffset(GLParam* p) {
 GLenum glGetError() {
 #if TGL_FEATURE_ERROR_CHECK == 1
 	GLContext* c = gl_get_context();
-	GLenum eflag = c->error_flag;
+	GLenum eflag;
+	gl_render_sync();
+	eflag = c->error_flag;
 	if (eflag != GL_OUT_OF_MEMORY) 
 		c->error_flag = GL_NO_ERROR;
 	return eflag;
@@ -207,6 +216,7 @@ GLenum glGetError() {
 void glDrawBuffer(GLenum mode) {
 	GLContext* c = gl_get_context();
 #include "error_check.h"
+	gl_render_sync();
 	if ((mode != GL_FRONT && mode != GL_NONE) || c->in_begin) {
 #if TGL_FEATURE_ERROR_CHECK == 1
 #define ERROR_FLAG GL_INVALID_OPERATION
@@ -221,6 +231,7 @@ void glDrawBuffer(GLenum mode) {
 void glReadBuffer(GLenum mode) {
 	GLContext* c = gl_get_context();
 #include "error_check.h"
+	gl_render_sync();
 	if ((mode != GL_FRONT && mode != GL_NONE) || c->in_begin) {
 #if TGL_FEATURE_ERROR_CHECK == 1
 #define ERROR_FLAG GL_INVALID_OPERATION
@@ -236,6 +247,7 @@ void glReadBuffer(GLenum mode) {
 void glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format, GLenum type, void* data) {
 	GLContext* c = gl_get_context();
 #include "error_check.h"
+	gl_render_sync();
 	if (c->readbuffer != GL_FRONT || (format != GL_RGBA && format != GL_RGB && format != GL_DEPTH_COMPONENT) ||
 #if TGL_FEATURE_RENDER_BITS == 32
 		(type != GL_UNSIGNED_INT && type != GL_UNSIGNED_INT_8_8_8_8)
@@ -258,4 +270,9 @@ void glReadPixels(GLint x, GLint y, GLsizei width, GLsizei height, GLenum format
 	/* TODO: implement read pixels.*/
 }
 
-void glFinish() { return; }
+void glFinish() {
+	ZBuffer* zb = gl_get_context()->zb;
+	gl_render_sync();
+	ZB_flushTiles(zb);
+	ZB_renderBands(zb);
+}
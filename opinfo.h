@@ -41,6 +41,7 @@ ADD_OP(LoadName, 1, "%d")
 ADD_OP(TexImage2D, 9, "%d %d %d  %d %d %d  %d %d %d")
 ADD_OP(TexImage1D, 8, "%d %d  %d %d %d  %d %d %d")
 ADD_OP(CopyTexImage2D, 8, "%d %d %d %d  %d %d %d %d")
+ADD_OP(ColorTable, 6, "%d %d %d %d %d %p")
 ADD_OP(BindTexture, 2, "%C %d")
 
 
@@ -52,6 +53,8 @@ ADD_OP(FrontFace, 1, "%C")
 ADD_OP(PolygonMode, 2, "%C %C")
 
 ADD_OP(CallList, 1, "%d")
+/* a Begin/End block of a display list, see listopt.c */
+ADD_OP(DrawBatch, 1, "%p")
 
 
 /* special opcodes */
@@ -60,6 +63,8 @@ ADD_OP(NextBuffer, 1, "%p")
 
 /* opengl 1.1 arrays */
 ADD_OP(ArrayElement, 1, "%d")
+ADD_OP(DrawArrays, 3, "%C %d %d")
+ADD_OP(DrawElements, 4, "%C %d %C %p")
 ADD_OP(EnableClientState, 1, "%C")
 ADD_OP(DisableClientState, 1, "%C")
 ADD_OP(VertexPointer, 4, "%d %C %d %p")
@@ -85,8 +90,10 @@ ADD_OP(PixelZoom, 2, "%f %f")
 ADD_OP(DrawPixels, 3, "%d %d %p")
 
 /* Gek's Added Functions */
-ADD_OP(PlotPixel, 2, "%d %d")
+ADD_OP(PlotPixel, 3, "%d %d %d")
 ADD_OP(TextSize, 1, "%d")
 ADD_OP(SetEnableSpecular, 1, "%d")
+ADD_OP(SetGuardBand, 1, "%d")
+ADD_OP(SetTextureTiles, 1, "%d")
 
 #undef ADD_OP
@@ -0,0 +1,203 @@
+/*
+ * Render thread.
+ * After glSetRenderThread(1), gl_add_op() doesn't execute ops, it copies them to a single producer / single consumer
+ * ring of TGL_RENDER_QUEUE_SIZE GLParams, and a render thread made current to the same context executes them.
+ * The ring itself is lock free: the producer only writes head and the consumer only writes tail. A side that finds
+ * the ring empty (or full) spins for a while, then sleeps on a condition variable until the other side moves.
+ *
+ * The context belongs to the render thread while it runs. API calls which read or change the context directly, or
+ * pass the render thread memory the application may reuse once they return, call gl_render_sync() to wait until
+ * everything queued has been executed.
+ */
+#include "msghandling.h"
+#include "zgl.h"
+
+#if TGL_FEATURE_RENDER_THREAD == 1
+#include <pthread.h>
+
+/* marks the end of the ops before the ring wraps around */
+#define QUEUE_WRAP -1
+/* stops the render thread */
+#define QUEUE_STOP -2
+/* how many times a side polls the ring before going to sleep */
+#define QUEUE_SPIN 4096
+
+#define QUEUE_LOAD(v) __atomic_load_n(&(v), __ATOMIC_SEQ_CST)
+#define QUEUE_STORE(v, x) __atomic_store_n(&(v), (x), __ATOMIC_SEQ_CST)
+
+typedef struct GLRenderQueue {
+	GLParam* ring;
+	GLint head; /* where the next op goes, written by the producer */
+	GLint tail; /* the next op to execute, written by the render thread once it is done with it */
+	GLint consumer_sleeping, producer_sleeping;
+	GLint arrays_read; /* ops reading the client arrays were queued since the last sync */
+	pthread_mutex_t lock;
+	pthread_cond_t consumer_wake, producer_wake;
+	pthread_t thread;
+	GLContext* context;
+} GLRenderQueue;
+
+/* Wakes the side sleeping on cond, if it is. */
+static void gl_queue_wake(GLRenderQueue* q, GLint* sleeping, pthread_cond_t* cond) {
+	if (QUEUE_LOAD(*sleeping)) {
+		pthread_mutex_lock(&q->lock);
+		pthread_cond_signal(cond);
+		pthread_mutex_unlock(&q->lock);
+	}
+}
+
+/* Waits until *v isn't old anymore. Returns the new value. */
+static GLint gl_queue_wait(GLRenderQueue* q, GLint* v, GLint old, GLint* sleeping, pthread_cond_t* cond) {
+	GLint i, n;
+	for (i = 0; i < QUEUE_SPIN; i++)
+		if ((n = QUEUE_LOAD(*v)) != old)
+			return n;
+	pthread_mutex_lock(&q->lock);
+	QUEUE_STORE(*sleeping, 1);
+	while ((n = QUEUE_LOAD(*v)) == old)
+		pthread_cond_wait(cond, &q->lock);
+	QUEUE_STORE(*sleeping, 0);
+	pthread_mutex_unlock(&q->lock);
+	return n;
+}
+
+/* Copies an op of size GLParams to the ring, waiting for room. */
+static void gl_queue_put(GLRenderQueue* q, GLParam* p, GLint size) {
+	GLint head = q->head, tail = QUEUE_LOAD(q->tail), dst, i;
+	/* head never catches up with tail, head == tail means the ring is empty */
+	for (;;) {
+		if (head >= tail) {
+			if (TGL_RENDER_QUEUE_SIZE - head > size) {
+				dst = head;
+				break;
+			}
+			if (tail > size) {
+				q->ring[head].op = QUEUE_WRAP;
+				dst = 0;
+				break;
+			}
+		} else if (tail - head > size) {
+			dst = head;
+			break;
+		}
+		tail = gl_queue_wait(q, &q->tail, tail, &q->producer_sleeping, &q->producer_wake);
+	}
+	for (i = 0; i < size; i++)
+		q->ring[dst + i] = p[i];
+	QUEUE_STORE(q->head, dst + size);
+	gl_queue_wake(q, &q->consumer_sleeping, &q->consumer_wake);
+}
+
+static void* gl_render_thread(void* arg) {
+	GLRenderQueue* q = arg;
+	GLint tail = 0, head = 0;
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+	glMakeCurrent(q->context);
+#endif
+	for (;;) {
+		GLParam* p;
+		if (tail == head)
+			head = gl_queue_wait(q, &q->head, head, &q->consumer_sleeping, &q->consumer_wake);
+		p = q->ring + tail;
+		if (p[0].op == QUEUE_WRAP) {
+			tail = 0;
+			continue;
+		}
+		if (p[0].op == QUEUE_STOP)
+			break;
+		gl_add_op(p);
+		tail += op_table_size[p[0].op];
+		QUEUE_STORE(q->tail, tail);
+		gl_queue_wake(q, &q->producer_sleeping, &q->producer_wake);
+	}
+	return NULL;
+}
+
+GLint gl_render_queue_op(GLContext* c, GLParam* p) {
+	GLRenderQueue* q = c->render_queue;
+	/* ops the render thread adds while executing others are executed right away */
+	if (pthread_equal(pthread_self(), q->thread))
+		return 0;
+	if (p[0].op == OP_ArrayElement || p[0].op == OP_DrawArrays)
+		q->arrays_read = 1;
+	gl_queue_put(q, p, op_table_size[p[0].op]);
+	return 1;
+}
+
+void gl_render_sync(void) {
+	GLContext* c = gl_get_context();
+	GLRenderQueue* q = c->render_queue;
+	GLint tail;
+	if (q == NULL || pthread_equal(pthread_self(), q->thread))
+		return;
+	tail = QUEUE_LOAD(q->tail);
+	while (tail != q->head)
+		tail = gl_queue_wait(q, &q->tail, tail, &q->producer_sleeping, &q->producer_wake);
+	q->arrays_read = 0;
+}
+
+void gl_render_sync_arrays(void) {
+	GLRenderQueue* q = gl_get_context()->render_queue;
+	if (q != NULL && q->arrays_read)
+		gl_render_sync();
+}
+
+static void gl_render_stop(GLContext* c) {
+	GLRenderQueue* q = c->render_queue;
+	GLParam p[1];
+	p[0].op = QUEUE_STOP;
+	gl_queue_put(q, p, 1);
+	pthread_join(q->thread, NULL);
+	c->render_queue = NULL;
+	pthread_cond_destroy(&q->consumer_wake);
+	pthread_cond_destroy(&q->producer_wake);
+	pthread_mutex_destroy(&q->lock);
+	gl_free(q->ring);
+	gl_free(q);
+}
+
+void glSetRenderThread(GLint enable) {
+	GLContext* c = gl_get_context();
+	GLRenderQueue* q;
+	if (!enable) {
+		if (c->render_queue != NULL)
+			gl_render_stop(c);
+		return;
+	}
+	if (c->render_queue != NULL)
+		return;
+	q = gl_zalloc(sizeof(GLRenderQueue));
+	if (q == NULL)
+		goto error;
+	q->ring = gl_malloc(TGL_RENDER_QUEUE_SIZE * sizeof(GLParam));
+	if (q->ring == NULL) {
+		gl_free(q);
+		goto error;
+	}
+	q->context = c;
+	pthread_mutex_init(&q->lock, NULL);
+	pthread_cond_init(&q->consumer_wake, NULL);
+	pthread_cond_init(&q->producer_wake, NULL);
+	c->render_queue = q;
+	if (pthread_create(&q->thread, NULL, gl_render_thread, q) != 0) {
+		c->render_queue = NULL;
+		pthread_cond_destroy(&q->consumer_wake);
+		pthread_cond_destroy(&q->producer_wake);
+		pthread_mutex_destroy(&q->lock);
+		gl_free(q->ring);
+		gl_free(q);
+		goto error;
+	}
+	return;
+error:
+	tgl_warning("\nTinyGL: Could not start the render thread, ops are executed by the caller.");
+}
+
+#else
+
+void glSetRenderThread(GLint enable) {
+	if (enable)
+		tgl_warning("\nTinyGL: glSetRenderThread() needs TGL_FEATURE_RENDER_THREAD.");
+}
+
+#endif
@@ -3,6 +3,7 @@
 GLint glRenderMode(GLint mode) {
 	GLContext* c = gl_get_context();
 	GLint result = 0;
+	gl_render_sync();
 #if TGL_FEATURE_ALT_RENDERMODES == 1
 	switch (c->render_mode) {
 	case GL_RENDER:
@@ -86,6 +87,7 @@ void glSelectBuffer(GLint size, GLuint* buf) {
 
 #if TGL_FEATURE_ALT_RENDERMODES == 1
 	GLContext* c = gl_get_context();
+	gl_render_sync();
 #if TGL_FEATURE_ERROR_CHECK == 1
 	if (c->render_mode == GL_SELECT)
 #define ERROR_FLAG GL_INVALID_OPERATION
@@ -105,6 +107,7 @@ void glSelectBuffer(GLint size, GLuint* buf) {
 void glFeedbackBuffer(GLint size, GLenum type, GLfloat* buf) {
 #if TGL_FEATURE_ALT_RENDERMODES == 1
 	GLContext* c = gl_get_context();
+	gl_render_sync();
 #if TGL_FEATURE_ERROR_CHECK == 1
 	if (c->render_mode == GL_FEEDBACK || !(type == GL_2D || type == GL_3D || type == GL_3D_COLOR || type == GL_3D_COLOR_TEXTURE || type == GL_4D_COLOR_TEXTURE))
 #define ERROR_FLAG GL_INVALID_OPERATION
@@ -11,50 +11,67 @@ static void calc_buf(GLSpecBuf* buf, const GLfloat shininess) {
 	val = 0.0f;
 	inc = 1.0f / SPECULAR_BUFFER_SIZE;
 	for (i = 0; i <= SPECULAR_BUFFER_SIZE; i++) {
-		buf->buf[i] = pow(val, shininess);
+		buf->buf[i] = powf(val, shininess);
 		val += inc;
 	}
 }
 
+/*
+Returns the specular buffer for shininess_i, made with the first lookup of it. Once MAX_SPECULAR_BUFFERS are made,
+buffers aren't replaced, which would thrash with materials used in turn: NULL is returned for any other shininess,
+and pow is used for it instead.
+*/
 GLSpecBuf* specbuf_get_buffer(GLContext* c, const GLint shininess_i, const GLfloat shininess) {
-	GLSpecBuf *found, *oldest;
-	found = oldest = c->specbuf_first;
-	while (found && found->shininess_i != shininess_i) {
-		if (found->last_used < oldest->last_used) {
-			oldest = found;
-		}
-		found = found->next;
-	}
-	if (found) { /* hey, found one! */
-		found->last_used = c->specbuf_used_counter++;
-		return found;
+	GLSpecBufCache* cache = &c->specbufs;
+	GLSpecBuf* buf;
+	GLint h = shininess_i & (SPECULAR_HASH_SIZE - 1);
+
+	/* the table is never full, so the probing ends on an empty slot at worst */
+	while ((buf = cache->hash[h]) != NULL) {
+		if (buf->shininess_i == shininess_i)
+			return buf;
+		h = (h + 1) & (SPECULAR_HASH_SIZE - 1);
 	}
-	if (oldest == NULL || c->specbuf_num_buffers < MAX_SPECULAR_BUFFERS) {
-		/* create new buffer */
-		GLSpecBuf* buf = gl_malloc(sizeof(GLSpecBuf));
+	if (cache->n == MAX_SPECULAR_BUFFERS)
+		return NULL;
+	buf = gl_malloc(sizeof(GLSpecBuf));
 #if TGL_FEATURE_ERROR_CHECK == 1
-		if (!buf)
+	if (!buf)
 #define ERROR_FLAG GL_OUT_OF_MEMORY
 #define RETVAL NULL
 #include "error_check.h"
 #else
-		
-		
+	if (!buf)
+		return NULL;
 #endif
-			c->specbuf_num_buffers++;
-		buf->next = c->specbuf_first;
-		c->specbuf_first = buf;
-		buf->last_used = c->specbuf_used_counter++;
-		buf->shininess_i = shininess_i;
-		calc_buf(buf, shininess);
-		return buf;
-	}
-	/* overwrite the lru buffer */
-	/*tgl_trace("overwriting spec buffer :(\n");*/
-	oldest->shininess_i = shininess_i;
-	oldest->last_used = c->specbuf_used_counter++;
-	calc_buf(oldest, shininess);
-	return oldest;
+	cache->n++;
+	buf->shininess_i = shininess_i;
+	calc_buf(buf, shininess);
+	cache->hash[h] = buf;
+	return buf;
 }
 
 #endif
+
+#if TGL_FEATURE_SPOT_BUFFERS == 1
+/*
+Rebuilds the falloff buffer of a spot light with a spot exponent, after its exponent or cutoff changed. The buffer
+spans the cosines from cos_spot_cutoff, the only ones lit, to 1. If it can't be allocated, pow is used instead.
+*/
+void spotbuf_calc(GLLight* l) {
+	GLint i;
+	GLfloat range;
+
+	if (l->spot_cutoff == 180 || l->spot_exponent <= 0)
+		return;
+	if (l->spot_buf == NULL) {
+		l->spot_buf = gl_malloc(sizeof(GLfloat) * (SPOT_BUFFER_SIZE + 1));
+		if (l->spot_buf == NULL)
+			return;
+	}
+	range = 1.0f - l->cos_spot_cutoff;
+	l->spot_buf_scale = (range > 0) ? SPOT_BUFFER_SIZE / range : 0;
+	for (i = 0; i <= SPOT_BUFFER_SIZE; i++)
+		l->spot_buf[i] = powf(l->cos_spot_cutoff + range * i / SPOT_BUFFER_SIZE, l->spot_exponent);
+}
+#endif
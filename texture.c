@@ -21,6 +21,7 @@ GLboolean glAreTexturesResident(GLsizei n, const GLuint* textures, GLboolean* re
 	GLboolean retval = GL_TRUE;
 	GLint i;
 #include "error_check_no_context.h"
+	gl_render_sync();
 
 	for (i = 0; i < n; i++)
 		if (find_texture(textures[i])) {
@@ -35,6 +36,7 @@ GLboolean glIsTexture(GLuint texture) {
 	GLContext* c = gl_get_context();
 #define RETVAL GL_FALSE
 #include "error_check.h"
+	gl_render_sync();
 	if (find_texture(texture))
 		return GL_TRUE;
 	return GL_FALSE;
@@ -43,6 +45,7 @@ GLboolean glIsTexture(GLuint texture) {
 void* glGetTexturePixmap(GLint text, GLint level, GLint* xsize, GLint* ysize) {
 	GLTexture* tex;
 	GLContext* c = gl_get_context();
+	gl_render_sync();
 #if TGL_FEATURE_ERROR_CHECK == 1
 	if (!(text >= 0 && level < MAX_TEXTURE_LEVELS))
 #define ERROR_FLAG GL_INVALID_ENUM
@@ -65,6 +68,11 @@ void* glGetTexturePixmap(GLint text, GLint level, GLint* xsize, GLint* ysize) {
 	return tex->images[level].pixmap;
 }
 
+void gl_flush_texture_users(GLContext* c) {
+	ZB_flushTiles(c->zb);
+	ZB_renderBands(c->zb);
+}
+
 static void free_texture(GLContext* c, GLint h) {
 	GLTexture *t, **ht;
 
@@ -78,6 +86,7 @@ static void free_texture(GLContext* c, GLint h) {
 	if (t->next != NULL)
 		t->next->prev = t->prev;
 
+	gl_free_texture_images(t);
 	gl_free(t);
 }
 
@@ -121,6 +130,7 @@ void glGenTextures(GLint n, GLuint* textures) {
 	GLint max, i;
 	GLTexture* t;
 #include "error_check.h"
+	gl_render_sync();
 	max = 0;
 	for (i = 0; i < TEXTURE_HASH_TABLE_SIZE; i++) {
 		t = c->shared_state.texture_hash_table[i];
@@ -140,11 +150,16 @@ void glDeleteTextures(GLint n, const GLuint* textures) {
 	GLTexture* t;
 	GLContext* c = gl_get_context();
 #include "error_check.h"
+	gl_render_sync();
+	/* binned and banded triangles may still sample these textures */
+	gl_flush_texture_users(c);
 	for (i = 0; i < n; i++) {
 		t = find_texture(textures[i]);
 		if (t != NULL && t != 0) {
 			if (t == c->current_texture) {
 				glBindTexture(GL_TEXTURE_2D, 0);
+				/* free_texture() must not run before the queued bind */
+				gl_render_sync();
 #include "error_check.h"
 			}
 			free_texture(c, textures[i]);
@@ -181,6 +196,145 @@ void glopBindTexture(GLParam* p) {
 }
 
 
+/* The power of 2 a texture width or height is stored at: size rounded up, at most TGL_FEATURE_TEXTURE_DIM. */
+static GLint gl_texture_size_log2(GLint size) {
+	GLint l = 0;
+	while (l < TGL_FEATURE_TEXTURE_POW2 && (1 << l) < size)
+		l++;
+	return l;
+}
+
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+#define TEXTURE_INDEX_BITS(t) ((t)->index_bits)
+#else
+#define TEXTURE_INDEX_BITS(t) 0
+#endif
+
+/* The bytes of a 2^xsize_log2 x 2^ysize_log2 image of PIXELs, or of index_bits bit palette indices. */
+static GLint gl_image_size(GLint index_bits, GLint xsize_log2, GLint ysize_log2) {
+	if (index_bits)
+		return ((index_bits << (xsize_log2 + ysize_log2)) + 7) >> 3;
+	return sizeof(PIXEL) << (xsize_log2 + ysize_log2);
+}
+
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+/* Makes the images of t hold index_bits bit palette indices, or PIXELs for 0, freeing them if they held the other. */
+static void gl_texture_format(GLTexture* t, GLint index_bits) {
+	GLint i;
+	if (t->index_bits == index_bits)
+		return;
+	for (i = 0; i < MAX_TEXTURE_LEVELS; i++) {
+		gl_free(t->images[i].pixmap);
+		t->images[i].pixmap = NULL;
+	}
+	t->level_count = 0;
+	t->index_bits = index_bits;
+}
+#else
+#define gl_texture_format(t, index_bits) /* a comment */
+#endif
+
+/* Makes image level of t 2^xsize_log2 x 2^ysize_log2 texels, keeping its pixmap if it is that size already. */
+static GLint gl_image_alloc(GLTexture* t, GLint level, GLint xsize_log2, GLint ysize_log2) {
+	GLImage* im = &t->images[level];
+	if (im->pixmap != NULL && im->xsize_log2 == xsize_log2 && im->ysize_log2 == ysize_log2)
+		return 1;
+	gl_free(im->pixmap);
+	im->pixmap = gl_zalloc(gl_image_size(TEXTURE_INDEX_BITS(t), xsize_log2, ysize_log2));
+	if (im->pixmap == NULL)
+		return 0;
+	im->xsize_log2 = xsize_log2;
+	im->ysize_log2 = ysize_log2;
+	im->xsize = 1 << xsize_log2;
+	im->ysize = 1 << ysize_log2;
+	return 1;
+}
+
+/* Frees the images of t, and its palette. */
+void gl_free_texture_images(GLTexture* t) {
+	GLint i;
+	for (i = 0; i < MAX_TEXTURE_LEVELS; i++) {
+		gl_free(t->images[i].pixmap);
+		t->images[i].pixmap = NULL;
+	}
+	t->level_count = 0;
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+	gl_free(t->palette);
+	t->palette = NULL;
+	t->palette_size = 0;
+#endif
+}
+
+/*
+Finishes t after images[0] was specified, in rows: makes its mip chain, then stores the levels in tiles if
+glSetTextureTiles() is in effect. If a level can't be allocated, the chain stops short of 1x1 and triangles that
+should sample the smaller levels sample the smallest there is. If tiling can't, the levels stay in rows.
+*/
+static void gl_texture_levels(GLContext* c, GLTexture* t) {
+	GLint level = 1;
+	GLint index_bits = TEXTURE_INDEX_BITS(t);
+	GLImage* im;
+#if TGL_FEATURE_TEXTURE_TILES == 1
+	PIXEL* rows;
+#endif
+#if TGL_FEATURE_MIPMAPS == 1
+	for (; level < MAX_TEXTURE_LEVELS; level++) {
+		GLImage* prev = &t->images[level - 1];
+		im = &t->images[level];
+		if (prev->xsize_log2 == 0 && prev->ysize_log2 == 0)
+			break;
+		if (!gl_image_alloc(t, level, (prev->xsize_log2 > 0) ? prev->xsize_log2 - 1 : 0, (prev->ysize_log2 > 0) ? prev->ysize_log2 - 1 : 0))
+			break;
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+		if (index_bits) {
+			gl_halveIndexImage((GLubyte*)im->pixmap, (GLubyte*)prev->pixmap, prev->xsize_log2, prev->ysize_log2, index_bits == 4);
+			continue;
+		}
+#endif
+		gl_halveImage(im->pixmap, prev->pixmap, prev->xsize_log2, prev->ysize_log2);
+	}
+#endif
+	t->level_count = level;
+	/* the levels of a larger image that came before */
+	for (; level < MAX_TEXTURE_LEVELS; level++) {
+		gl_free(t->images[level].pixmap);
+		t->images[level].pixmap = NULL;
+	}
+	t->tiled = 0;
+#if TGL_FEATURE_TEXTURE_TILES == 1
+	if (!c->texture_tiles)
+		return;
+	/* the levels are tiled from a copy in rows, images[0] being the largest */
+	rows = gl_malloc(gl_image_size(index_bits, t->images[0].xsize_log2, t->images[0].ysize_log2));
+	if (rows == NULL)
+		return;
+	for (level = 0; level < t->level_count; level++) {
+		im = &t->images[level];
+		memcpy(rows, im->pixmap, gl_image_size(index_bits, im->xsize_log2, im->ysize_log2));
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+		if (index_bits) {
+			gl_tileIndexImage((GLubyte*)im->pixmap, (GLubyte*)rows, im->xsize_log2, im->ysize_log2, index_bits == 4);
+			continue;
+		}
+#endif
+		gl_tileImage(im->pixmap, rows, im->xsize_log2, im->ysize_log2);
+	}
+	gl_free(rows);
+	t->tiled = 1;
+#endif
+}
+
+void glSetTextureTiles(GLint s) {
+	GLParam p[2];
+#include "error_check_no_context.h"
+	p[0].op = OP_SetTextureTiles;
+	p[1].i = s;
+	gl_add_op(p);
+}
+void glopSetTextureTiles(GLParam* p) {
+	gl_get_context()->texture_tiles = (p[1].i != 0);
+}
+
 void glCopyTexImage2D(GLenum target,		 
 					  GLint level,			 
 					  GLenum internalformat, 
@@ -216,9 +370,9 @@ void glopCopyTexImage2D(GLParam* p) {
 	GLContext* c = gl_get_context();
 	y -= h;
 
-	if (c->readbuffer != GL_FRONT || c->current_texture == NULL || target != GL_TEXTURE_2D || border != 0 ||
-		w != TGL_FEATURE_TEXTURE_DIM || /*TODO Implement image interp*/
-		h != TGL_FEATURE_TEXTURE_DIM) {
+	if (c->readbuffer != GL_FRONT || c->current_texture == NULL || target != GL_TEXTURE_2D || level != 0 || border != 0 ||
+		w != (1 << gl_texture_size_log2(w)) || /*TODO Implement image interp*/
+		h != (1 << gl_texture_size_log2(h))) {
 #if TGL_FEATURE_ERROR_CHECK == 1
 #define ERROR_FLAG GL_INVALID_OPERATION
 #include "error_check.h"
@@ -226,10 +380,28 @@ void glopCopyTexImage2D(GLParam* p) {
 		return;
 #endif
 	}
+	if (ZB_bandUnsupported(c->zb, "glCopyTexImage2D()"))
+		return;
+	/* read back what is still binned, and don't change a texture binned triangles sample */
+	ZB_flushTiles(c->zb);
+	ZB_resolveClear(c->zb, 0, 1);
+	gl_texture_format(c->current_texture, 0);
 	im = &c->current_texture->images[level];
-	data = c->current_texture->images[level].pixmap;
-	im->xsize = TGL_FEATURE_TEXTURE_DIM;
-	im->ysize = TGL_FEATURE_TEXTURE_DIM;
+	if (!gl_image_alloc(c->current_texture, level, gl_texture_size_log2(w), gl_texture_size_log2(h))) {
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_OUT_OF_MEMORY
+#include "error_check.h"
+#else
+		gl_fatal_error("GL_OUT_OF_MEMORY");
+#endif
+	}
+	data = im->pixmap;
+#if TGL_FEATURE_RENDER_BITS == 1
+	/* the framebuffer holds a bit per pixel, set bits read as white */
+#define COPY_TEX_PIXEL(k) ((c->zb->pbuf[(k) >> 3] & (1 << ((k) & 7))) ? 255 : 0)
+#else
+#define COPY_TEX_PIXEL(k) (c->zb->pbuf[k])
+#endif
 	/* TODO implement the scaling and stuff that the GL spec says it should have.*/
 #if TGL_FEATURE_MULTITHREADED_COPY_TEXIMAGE_2D == 1
 #ifdef _OPENMP
@@ -237,46 +409,61 @@ void glopCopyTexImage2D(GLParam* p) {
 #endif
 	for (j = 0; j < h; j++)
 		for (i = 0; i < w; i++) {
-			data[i + j * w] = c->zb->pbuf[((i + x) % (c->zb->xsize)) + ((j + y) % (c->zb->ysize)) * (c->zb->xsize)];
+			data[i + j * w] = COPY_TEX_PIXEL(((i + x) % (c->zb->xsize)) + ((j + y) % (c->zb->ysize)) * (c->zb->xsize));
 		}
 #else
 	for (j = 0; j < h; j++)
 		for (i = 0; i < w; i++) {
-			data[i + j * w] = c->zb->pbuf[((i + x) % (c->zb->xsize)) + ((j + y) % (c->zb->ysize)) * (c->zb->xsize)];
+			data[i + j * w] = COPY_TEX_PIXEL(((i + x) % (c->zb->xsize)) + ((j + y) % (c->zb->ysize)) * (c->zb->xsize));
 		}
 #endif
+#undef COPY_TEX_PIXEL
+	gl_texture_levels(c, c->current_texture);
 }
 
-void glopTexImage1D(GLParam* p) {
-	GLint target = p[1].i;
-	GLint level = p[2].i;
-	GLint components = p[3].i;
-	GLint width = p[4].i;
-	/* GLint height = p[5].i;*/
-	GLint height = 1;
-	GLint border = p[5].i;
-	GLint format = p[6].i;
-	GLint type = p[7].i;
-	void* pixels = p[8].p;
+/* Converts the xsize x ysize RGB pixels rgb to PIXELs. */
+static void gl_convert_image(PIXEL* pixmap, GLubyte* rgb, GLint xsize, GLint ysize) {
+#if TGL_FEATURE_RENDER_BITS == 32
+	gl_convertRGB_to_8A8R8G8B(pixmap, rgb, xsize, ysize);
+#elif TGL_FEATURE_RENDER_BITS == 16
+	gl_convertRGB_to_5R6G5B(pixmap, rgb, xsize, ysize);
+#elif TGL_FEATURE_RENDER_BITS == 1
+	gl_convertRGB_to_L8(pixmap, rgb, xsize, ysize);
+#else
+#error bad TGL_FEATURE_RENDER_BITS
+#endif
+}
+
+/*
+Sets image level of the current texture to the RGB pixels, or to the palette indices pixels, one to a byte, stored
+in index_bits (8 or 4) bits. Either is resized if width or height isn't a power of 2.
+*/
+static void gl_tex_image(GLContext* c, GLint level, GLint width, GLint height, GLint index_bits, GLubyte* pixels) {
 	GLImage* im;
 	GLubyte* pixels1;
-	GLint do_free=0;
-	GLContext* c = gl_get_context();
-	{
+	GLint xsize_log2 = gl_texture_size_log2(width), ysize_log2 = gl_texture_size_log2(height);
+	GLint do_free = 0;
+
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+	if (index_bits) {
+		/* binned and banded triangles may still sample the old image */
+		gl_flush_texture_users(c);
+		gl_texture_format(c->current_texture, index_bits);
+		if (!gl_image_alloc(c->current_texture, level, xsize_log2, ysize_log2)) {
 #if TGL_FEATURE_ERROR_CHECK == 1
-		if (!(c->current_texture != NULL && target == GL_TEXTURE_1D && level == 0 && components == 3 && border == 0 && format == GL_RGB &&
-			  type == GL_UNSIGNED_BYTE))
-#define ERROR_FLAG GL_INVALID_ENUM
+#define ERROR_FLAG GL_OUT_OF_MEMORY
 #include "error_check.h"
-
 #else
-		if (!(c->current_texture != NULL && target == GL_TEXTURE_1D && level == 0 && components == 3 && border == 0 && format == GL_RGB &&
-			  type == GL_UNSIGNED_BYTE))
-			gl_fatal_error("glTexImage2D: combination of parameters not handled!!");
+			gl_fatal_error("GL_OUT_OF_MEMORY");
 #endif
+		}
+		gl_packIndexImage((GLubyte*)c->current_texture->images[level].pixmap, xsize_log2, ysize_log2, pixels, width, height, index_bits == 4);
+		gl_texture_levels(c, c->current_texture);
+		return;
 	}
-	if (width != TGL_FEATURE_TEXTURE_DIM || height != TGL_FEATURE_TEXTURE_DIM) {
-		pixels1 = gl_malloc(TGL_FEATURE_TEXTURE_DIM * TGL_FEATURE_TEXTURE_DIM * 3); /* GUARDED*/
+#endif
+	if (width != (1 << xsize_log2) || height != (1 << ysize_log2)) {
+		pixels1 = gl_malloc((3 << (xsize_log2 + ysize_log2))); /* GUARDED*/
 		if (pixels1 == NULL) {
 #if TGL_FEATURE_ERROR_CHECK == 1
 #define ERROR_FLAG GL_OUT_OF_MEMORY
@@ -287,28 +474,74 @@ void glopTexImage1D(GLParam* p) {
 		}
 		/* no GLinterpolation is done here to respect the original image aliasing ! */
 		
-		gl_resizeImageNoInterpolate(pixels1, TGL_FEATURE_TEXTURE_DIM, TGL_FEATURE_TEXTURE_DIM, pixels, width, height);
+		gl_resizeImageNoInterpolate(pixels1, 1 << xsize_log2, 1 << ysize_log2, pixels, width, height);
 		do_free = 1;
-		width = TGL_FEATURE_TEXTURE_DIM;
-		height = TGL_FEATURE_TEXTURE_DIM; 
+		width = 1 << xsize_log2;
+		height = 1 << ysize_log2;
 	} else {
 		pixels1 = pixels;
 	}
 
+	/* binned and banded triangles may still sample the old image */
+	gl_flush_texture_users(c);
+	gl_texture_format(c->current_texture, 0);
 	im = &c->current_texture->images[level];
-	im->xsize = width;
-	im->ysize = height;
-#if TGL_FEATURE_RENDER_BITS == 32
-	gl_convertRGB_to_8A8R8G8B(im->pixmap, pixels1, width, height);
-#elif TGL_FEATURE_RENDER_BITS == 16
-	gl_convertRGB_to_5R6G5B(im->pixmap, pixels1, width, height);
-#elif TGL_FEATURE_RENDER_BITS == 1
-
+	if (!gl_image_alloc(c->current_texture, level, xsize_log2, ysize_log2)) {
+		if (do_free)
+			gl_free(pixels1);
+#if TGL_FEATURE_ERROR_CHECK == 1
+#define ERROR_FLAG GL_OUT_OF_MEMORY
+#include "error_check.h"
 #else
-#error bad TGL_FEATURE_RENDER_BITS
+		gl_fatal_error("GL_OUT_OF_MEMORY");
 #endif
+	}
+	gl_convert_image(im->pixmap, pixels1, width, height);
 	if (do_free)
 		gl_free(pixels1);
+	gl_texture_levels(c, c->current_texture);
+}
+
+/* The index bits of images given as components and format: 0 for RGB pixels, -1 for combinations that aren't handled. */
+static GLint gl_tex_image_format(GLint components, GLint format) {
+	if (components == 3 && format == GL_RGB)
+		return 0;
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+	if (components == GL_COLOR_INDEX8_EXT && format == GL_COLOR_INDEX)
+		return 8;
+	if (components == GL_COLOR_INDEX4_EXT && format == GL_COLOR_INDEX)
+		return 4;
+#endif
+	return -1;
+}
+
+void glopTexImage1D(GLParam* p) {
+	GLint target = p[1].i;
+	GLint level = p[2].i;
+	GLint components = p[3].i;
+	GLint width = p[4].i;
+	/* GLint height = p[5].i;*/
+	GLint height = 1;
+	GLint border = p[5].i;
+	GLint format = p[6].i;
+	GLint type = p[7].i;
+	void* pixels = p[8].p;
+	GLint index_bits = gl_tex_image_format(components, format);
+	GLContext* c = gl_get_context();
+	{
+#if TGL_FEATURE_ERROR_CHECK == 1
+		if (!(c->current_texture != NULL && target == GL_TEXTURE_1D && level == 0 && index_bits >= 0 && border == 0 &&
+			  type == GL_UNSIGNED_BYTE))
+#define ERROR_FLAG GL_INVALID_ENUM
+#include "error_check.h"
+
+#else
+		if (!(c->current_texture != NULL && target == GL_TEXTURE_1D && level == 0 && index_bits >= 0 && border == 0 &&
+			  type == GL_UNSIGNED_BYTE))
+			gl_fatal_error("glTexImage2D: combination of parameters not handled!!");
+#endif
+	}
+	gl_tex_image(c, level, width, height, index_bits, pixels);
 }
 void glopTexImage2D(GLParam* p) {
 	GLint target = p[1].i;
@@ -320,26 +553,57 @@ void glopTexImage2D(GLParam* p) {
 	GLint format = p[7].i;
 	GLint type = p[8].i;
 	void* pixels = p[9].p;
-	GLImage* im;
-	GLubyte* pixels1;
-	GLint do_free=0;
+	GLint index_bits = gl_tex_image_format(components, format);
 	GLContext* c = gl_get_context();
 	{
 #if TGL_FEATURE_ERROR_CHECK == 1
-		if (!(c->current_texture != NULL && target == GL_TEXTURE_2D && level == 0 && components == 3 && border == 0 && format == GL_RGB &&
+		if (!(c->current_texture != NULL && target == GL_TEXTURE_2D && level == 0 && index_bits >= 0 && border == 0 &&
 			  type == GL_UNSIGNED_BYTE))
 #define ERROR_FLAG GL_INVALID_ENUM
 #include "error_check.h"
 
 #else
-		if (!(c->current_texture != NULL && target == GL_TEXTURE_2D && level == 0 && components == 3 && border == 0 && format == GL_RGB &&
+		if (!(c->current_texture != NULL && target == GL_TEXTURE_2D && level == 0 && index_bits >= 0 && border == 0 &&
 			  type == GL_UNSIGNED_BYTE))
 			gl_fatal_error("glTexImage2D: combination of parameters not handled!!");
 #endif
 	}
-	if (width != TGL_FEATURE_TEXTURE_DIM || height != TGL_FEATURE_TEXTURE_DIM) {
-		pixels1 = gl_malloc(TGL_FEATURE_TEXTURE_DIM * TGL_FEATURE_TEXTURE_DIM * 3); /* GUARDED*/
-		if (pixels1 == NULL) {
+	gl_tex_image(c, level, width, height, index_bits, pixels);
+}
+
+/* The palette of the current texture, which its GL_COLOR_INDEX8_EXT and GL_COLOR_INDEX4_EXT images are drawn with. */
+void glopColorTable(GLParam* p) {
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+	GLint target = p[1].i;
+	GLint internalformat = p[2].i;
+	GLint width = p[3].i;
+	GLint format = p[4].i;
+	GLint type = p[5].i;
+	GLubyte* table = p[6].p;
+	GLTexture* t;
+	GLContext* c = gl_get_context();
+#if TGL_FEATURE_ERROR_CHECK == 1
+	if (!(c->current_texture != NULL && target == GL_TEXTURE_2D && (internalformat == 3 || internalformat == GL_RGB) && format == GL_RGB &&
+		  type == GL_UNSIGNED_BYTE))
+#define ERROR_FLAG GL_INVALID_ENUM
+#include "error_check.h"
+	/* a power of 2 entries, which the indices are masked to */
+	if (width < 1 || width > MAX_PALETTE_SIZE || (width & (width - 1)) != 0)
+#define ERROR_FLAG GL_INVALID_VALUE
+#include "error_check.h"
+#else
+	if (!(c->current_texture != NULL && target == GL_TEXTURE_2D && (internalformat == 3 || internalformat == GL_RGB) && format == GL_RGB &&
+		  type == GL_UNSIGNED_BYTE && width >= 1 && width <= MAX_PALETTE_SIZE && (width & (width - 1)) == 0))
+		gl_fatal_error("glColorTableEXT: combination of parameters not handled!!");
+#endif
+	t = c->current_texture;
+	/* binned and banded triangles may still sample the old palette */
+	gl_flush_texture_users(c);
+	if (t->palette_size != width) {
+		gl_free(t->palette);
+		t->palette_size = 0;
+		t->palette = gl_malloc(sizeof(PIXEL) * width);
+		if (t->palette == NULL) {
 #if TGL_FEATURE_ERROR_CHECK == 1
 #define ERROR_FLAG GL_OUT_OF_MEMORY
 #include "error_check.h"
@@ -347,30 +611,10 @@ void glopTexImage2D(GLParam* p) {
 			gl_fatal_error("GL_OUT_OF_MEMORY");
 #endif
 		}
-		/* no GLinterpolation is done here to respect the original image aliasing ! */
-		
-		gl_resizeImageNoInterpolate(pixels1, TGL_FEATURE_TEXTURE_DIM, TGL_FEATURE_TEXTURE_DIM, pixels, width, height);
-		do_free = 1;
-		width = TGL_FEATURE_TEXTURE_DIM;
-		height = TGL_FEATURE_TEXTURE_DIM;
-	} else {
-		pixels1 = pixels;
+		t->palette_size = width;
 	}
-
-	im = &c->current_texture->images[level];
-	im->xsize = width;
-	im->ysize = height;
-#if TGL_FEATURE_RENDER_BITS == 32
-	gl_convertRGB_to_8A8R8G8B(im->pixmap, pixels1, width, height);
-#elif TGL_FEATURE_RENDER_BITS == 16
-	gl_convertRGB_to_5R6G5B(im->pixmap, pixels1, width, height);
-#elif TGL_FEATURE_RENDER_BITS == 1
-
-#else
-#error Bad TGL_FEATURE_RENDER_BITS
+	gl_convert_image(t->palette, table, width, 1);
 #endif
-	if (do_free)
-		gl_free(pixels1);
 }
 
 /* TODO: not all tests are done */
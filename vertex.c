@@ -1,4 +1,5 @@
 #include "zgl.h"
+#include "zsimd.h"
 #include <string.h>
 void glopNormal(GLParam* p) {
 	V3 v;
@@ -132,14 +133,18 @@ void glopBegin(GLParam* p) {
 	}
 }
 
+/* Maps v, inside the view volume, to the viewport. */
 static void gl_transform_to_viewport_vertex_c(GLVertex* v) {
 	GLContext* c = gl_get_context();
-	{
-		GLfloat winv = 1.0 / v->pc.W;
-		v->zp.x = (GLint)(v->pc.X * winv * c->viewport.scale.X + c->viewport.trans.X);
-		v->zp.y = (GLint)(v->pc.Y * winv * c->viewport.scale.Y + c->viewport.trans.Y);
-		v->zp.z = (GLint)(v->pc.Z * winv * c->viewport.scale.Z + c->viewport.trans.Z);
-	}
+	GLfloat winv = 1.0 / v->pc.W;
+	v->zp.x = (GLint)(v->pc.X * winv * c->viewport.scale.X + c->viewport.trans.X);
+	v->zp.y = (GLint)(v->pc.Y * winv * c->viewport.scale.Y + c->viewport.trans.Y);
+	v->zp.z = (GLint)(v->pc.Z * winv * c->viewport.scale.Z + c->viewport.trans.Z);
+}
+
+/* Sets the parts of v's rasterization point that depend on its color and texture coordinates. */
+static void gl_transform_to_viewport_attribs_c(GLVertex* v) {
+	GLContext* c = gl_get_context();
 
 	v->zp.r = (GLint)(v->color.v[0] * COLOR_CORRECTED_MULT_MASK + COLOR_MIN_MULT) & COLOR_MASK;
 	v->zp.g = (GLint)(v->color.v[1] * COLOR_CORRECTED_MULT_MASK + COLOR_MIN_MULT) & COLOR_MASK;
@@ -201,42 +206,142 @@ static void gl_vertex_transform(GLVertex* v) {
 	}
 
 	v->clip_code = gl_clipcode(v->pc.X, v->pc.Y, v->pc.Z, v->pc.W);
+	/* precompute the mapping to the viewport */
+#if TGL_OPTIMIZATION_HINT_BRANCH_COST < 2
+	if (v->clip_code == 0)
+#endif
+	{
+		gl_transform_to_viewport_vertex_c(v);
+	}
 }
 
-void glopVertex(GLParam* p) {
-	GLVertex* v;
-	GLint n, i, cnt;
+/*
+Block vertex transform, with the lanes of zsimd.h.
+Row r of the matrix m times (x, y, z, 1), (x, y, z, w) and (x, y, z, 0), in the order the scalar code used.
+*/
+#define LANE_ROW3(m, r, x, y, z) LANE_ADD(LANE_ADD(LANE_MUL(x, m[4 * (r)]), LANE_MUL(y, m[4 * (r) + 1])), LANE_MUL(z, m[4 * (r) + 2]))
+#define LANE_ROW(m, r, x, y, z) LANE_ADD(LANE_ROW3(m, r, x, y, z), m[4 * (r) + 3])
+#define LANE_ROW4(m, r, x, y, z, w) LANE_ADD(LANE_ROW3(m, r, x, y, z), LANE_MUL(w, m[4 * (r) + 3]))
+
+/*
+Transforms the first n vertices of b, at most TGL_VERTEX_BLOCK, whose coordinates and (object space) normals are set.
+Computes their eye coordinates and normals if lighting is enabled, their clip coordinates and codes, and maps the ones
+inside the view volume to the viewport. W = 1 is assumed for the coordinates.
+*/
+void gl_vertex_transform_block(GLVertexBlock* b, GLint n) {
 	GLContext* c = gl_get_context();
-#if TGL_FEATURE_ERROR_CHECK == 1
-	if (c->in_begin == 0)
-#define ERROR_FLAG GL_INVALID_OPERATION
-#include "error_check.h"
-#else
-	
-#endif
+	GLLane a[16], p[16], x, y, z, w, ex, ey, ez, ew, px, py, pz, pw, winv;
+	GLLane sx, sy, sz, tx, ty, tz, clip_scale, one;
+	GLLaneInt code;
+	GLfloat* m;
+	GLint i, k, lanes, lighting = c->lighting_enabled;
 
-		n = c->vertex_n;
-	cnt = c->vertex_cnt;
-	cnt++;
-	c->vertex_cnt = cnt;
+	/* the last vector is padded with vertices at the origin */
+	lanes = (n + TGL_LANES - 1) & ~(TGL_LANES - 1);
+	for (k = n; k < lanes; k++)
+		b->x[k] = b->y[k] = b->z[k] = b->nx[k] = b->ny[k] = b->nz[k] = 0;
 
-	/* new vertex entry */
-	v = &c->vertex[n];
-	n++;
+	if (lighting) {
+		/* eye coordinates are needed for lighting */
+		m = &c->matrix_stack_ptr[0]->m[0][0];
+		for (i = 0; i < 16; i++)
+			a[i] = LANE_SET(m[i]);
+		m = &c->matrix_stack_ptr[1]->m[0][0];
+		for (i = 0; i < 16; i++)
+			p[i] = LANE_SET(m[i]);
+	} else {
+		m = &c->matrix_model_projection.m[0][0];
+		for (i = 0; i < 16; i++)
+			a[i] = LANE_SET(m[i]);
+	}
+	sx = LANE_SET(c->viewport.scale.X);
+	sy = LANE_SET(c->viewport.scale.Y);
+	sz = LANE_SET(c->viewport.scale.Z);
+	tx = LANE_SET(c->viewport.trans.X);
+	ty = LANE_SET(c->viewport.trans.Y);
+	tz = LANE_SET(c->viewport.trans.Z);
+	clip_scale = LANE_SET((GLfloat)(1.0 + CLIP_EPSILON));
+	one = LANE_SET(1.0f);
+
+	for (k = 0; k < lanes; k += TGL_LANES) {
+		x = LANE_LOAD(b->x + k);
+		y = LANE_LOAD(b->y + k);
+		z = LANE_LOAD(b->z + k);
+		if (lighting) {
+			ex = LANE_ROW(a, 0, x, y, z);
+			ey = LANE_ROW(a, 1, x, y, z);
+			ez = LANE_ROW(a, 2, x, y, z);
+			ew = LANE_ROW(a, 3, x, y, z);
+			LANE_STORE(b->ex + k, ex);
+			LANE_STORE(b->ey + k, ey);
+			LANE_STORE(b->ez + k, ez);
+			LANE_STORE(b->ew + k, ew);
+			px = LANE_ROW4(p, 0, ex, ey, ez, ew);
+			py = LANE_ROW4(p, 1, ex, ey, ez, ew);
+			pz = LANE_ROW4(p, 2, ex, ey, ez, ew);
+			pw = LANE_ROW4(p, 3, ex, ey, ez, ew);
+		} else {
+			px = LANE_ROW(a, 0, x, y, z);
+			py = LANE_ROW(a, 1, x, y, z);
+			pz = LANE_ROW(a, 2, x, y, z);
+			pw = c->matrix_model_projection_no_w_transform ? a[15] : LANE_ROW(a, 3, x, y, z);
+		}
+		LANE_STORE(b->px + k, px);
+		LANE_STORE(b->py + k, py);
+		LANE_STORE(b->pz + k, pz);
+		LANE_STORE(b->pw + k, pw);
+
+		w = LANE_MUL(pw, clip_scale);
+		code = LANE_OR(LANE_OR(LANE_CLIP(px, w, CLIP_XMIN, CLIP_XMAX), LANE_CLIP(py, w, CLIP_YMIN, CLIP_YMAX)),
+					   LANE_CLIP(pz, w, CLIP_ZMIN, CLIP_ZMAX));
+		LANE_STORE_INT(b->clip_code + k, code);
+
+		/* precompute the mapping to the viewport, the vertices outside get the viewport's origin */
+		winv = LANE_IF_IN(code, LANE_DIV(one, pw));
+		LANE_STORE_TRUNC(b->zx + k, LANE_ADD(LANE_MUL(LANE_MUL(px, winv), sx), tx));
+		LANE_STORE_TRUNC(b->zy + k, LANE_ADD(LANE_MUL(LANE_MUL(py, winv), sy), ty));
+		LANE_STORE_TRUNC(b->zz + k, LANE_ADD(LANE_MUL(LANE_MUL(pz, winv), sz), tz));
+	}
 
-	v->coord.X = p[1].f;
-	v->coord.Y = p[2].f;
-	v->coord.Z = p[3].f;
-	v->coord.W = p[4].f;
+	if (lighting) {
+		m = &c->matrix_model_view_inv.m[0][0];
+		for (i = 0; i < 12; i++)
+			a[i] = LANE_SET(m[i]);
+		for (k = 0; k < lanes; k += TGL_LANES) {
+			x = LANE_LOAD(b->nx + k);
+			y = LANE_LOAD(b->ny + k);
+			z = LANE_LOAD(b->nz + k);
+			LANE_STORE(b->nx + k, LANE_ROW3(a, 0, x, y, z));
+			LANE_STORE(b->ny + k, LANE_ROW3(a, 1, x, y, z));
+			LANE_STORE(b->nz + k, LANE_ROW3(a, 2, x, y, z));
+		}
+		if (c->normalize_enabled) {
+			for (k = 0; k < n; k++) {
+				V3 nv;
+				nv.X = b->nx[k];
+				nv.Y = b->ny[k];
+				nv.Z = b->nz[k];
+				gl_V3_Norm_Fast(&nv);
+				b->nx[k] = nv.X;
+				b->ny[k] = nv.Y;
+				b->nz[k] = nv.Z;
+			}
+		}
+	}
+	b->lit = 0;
+}
 
-	gl_vertex_transform(v);
+/* Lights v, which is transformed, unless it is lit already, and sets the rest of it from the current attributes. */
+static void gl_vertex_finish(GLVertex* v, GLint lit) {
+	GLContext* c = gl_get_context();
 
 	/* color */
 
 	if (c->lighting_enabled) {
-		gl_shade_vertex(v);
+		if (!lit) {
+			gl_shade_vertex(v);
 #include "error_check.h"
-		
+		}
 	} else {
 		v->color = c->current_color;
 	}
@@ -251,16 +356,63 @@ void glopVertex(GLParam* p) {
 			v->tex_coord = c->current_tex_coord;
 		}
 	}
-	/* precompute the mapping to the viewport */
 #if TGL_OPTIMIZATION_HINT_BRANCH_COST < 2
 	if (v->clip_code == 0)
 #endif
 	{
-		gl_transform_to_viewport_vertex_c(v);
+		gl_transform_to_viewport_attribs_c(v);
 	}
 
 	/* edge flag */
 	v->edge_flag = c->current_edge_flag;
+}
+
+/* Transforms and lights v, whose coordinates are set, with the current attributes. */
+void gl_vertex_process(GLVertex* v) {
+	gl_vertex_transform(v);
+	gl_vertex_finish(v, 0);
+}
+
+/*
+Sets v to vertex k of b, transformed by gl_vertex_transform_block(), and lights it with the current attributes, or
+takes its color from b if gl_shade_block() lit it.
+*/
+void gl_vertex_from_block(GLVertex* v, GLVertexBlock* b, GLint k) {
+	GLContext* c = gl_get_context();
+
+	if (c->lighting_enabled) {
+		v->ec.X = b->ex[k];
+		v->ec.Y = b->ey[k];
+		v->ec.Z = b->ez[k];
+		v->ec.W = b->ew[k];
+		v->normal.X = b->nx[k];
+		v->normal.Y = b->ny[k];
+		v->normal.Z = b->nz[k];
+		if (b->lit) {
+			v->color.v[0] = b->r[k];
+			v->color.v[1] = b->g[k];
+			v->color.v[2] = b->b[k];
+			v->color.v[3] = b->a;
+		}
+	}
+	v->pc.X = b->px[k];
+	v->pc.Y = b->py[k];
+	v->pc.Z = b->pz[k];
+	v->pc.W = b->pw[k];
+	v->clip_code = b->clip_code[k];
+	v->zp.x = b->zx[k];
+	v->zp.y = b->zy[k];
+	v->zp.z = b->zz[k];
+	gl_vertex_finish(v, b->lit);
+}
+
+/* Adds c->vertex[c->vertex_n], processed, to the primitive being drawn. */
+void gl_vertex_assemble(void) {
+	GLint n, i, cnt;
+	GLContext* c = gl_get_context();
+
+	n = c->vertex_n + 1;
+	cnt = ++c->vertex_cnt;
 
 	switch (c->begin_type) {
 	case GL_POINTS:
@@ -358,6 +510,30 @@ void glopVertex(GLParam* p) {
 	c->vertex_n = n;
 }
 
+void glopVertex(GLParam* p) {
+	GLVertex* v;
+	GLContext* c = gl_get_context();
+#if TGL_FEATURE_ERROR_CHECK == 1
+	if (c->in_begin == 0)
+#define ERROR_FLAG GL_INVALID_OPERATION
+#include "error_check.h"
+#else
+	
+#endif
+
+	/* new vertex entry */
+	v = &c->vertex[c->vertex_n];
+
+	v->coord.X = p[1].f;
+	v->coord.Y = p[2].f;
+	v->coord.Z = p[3].f;
+	v->coord.W = p[4].f;
+
+	gl_vertex_process(v);
+#include "error_check.h"
+	gl_vertex_assemble();
+}
+
 void glopEnd(GLParam* param) {
 	GLContext* c = gl_get_context();
 #if TGL_FEATURE_ERROR_CHECK == 1
@@ -386,3 +562,64 @@ void glopEnd(GLParam* param) {
 #endif
 	c->in_begin = 0;
 }
+
+void glopDrawBatch(GLParam* p) {
+	GLContext* c = gl_get_context();
+	GLBatch* batch = (GLBatch*)p[1].p;
+	GLVertexBlock* b = &c->vertex_block;
+	GLParam* v = batch->vertices;
+	GLParam* w;
+	GLParam q[2];
+	GLfloat nx, ny, nz;
+	GLint i, k, n, changed, colors;
+
+	nx = c->current_normal.X;
+	ny = c->current_normal.Y;
+	nz = c->current_normal.Z;
+
+	q[1].i = batch->type;
+	glopBegin(q);
+	for (i = 0; i < batch->n; i += n) {
+		n = (batch->n - i < TGL_VERTEX_BLOCK) ? batch->n - i : TGL_VERTEX_BLOCK;
+		/*
+		the block's coordinates and normals are transformed together, and lit together too if the material doesn't
+		change in the block, else its vertices are lit one by one
+		*/
+		colors = 0;
+		for (k = 0, w = v; k < n; k++, w += batch->stride) {
+			colors |= w[0].i & BATCH_COLOR;
+			if (w[0].i & BATCH_NORMAL) {
+				nx = w[batch->normal].f;
+				ny = w[batch->normal + 1].f;
+				nz = w[batch->normal + 2].f;
+			}
+			b->x[k] = w[1].f;
+			b->y[k] = w[2].f;
+			b->z[k] = w[3].f;
+			b->nx[k] = nx;
+			b->ny[k] = ny;
+			b->nz[k] = nz;
+		}
+		gl_vertex_transform_block(b, n);
+		if (c->lighting_enabled && !(colors && c->color_material_enabled))
+			gl_shade_block(b, n);
+		/* the glop functions read their params from p[1] on, they are handed the param before the attribute */
+		for (k = 0; k < n; k++, v += batch->stride) {
+			changed = v[0].i;
+			if (changed) {
+				if (changed & BATCH_NORMAL)
+					glopNormal(v + batch->normal - 1);
+				if (changed & BATCH_COLOR)
+					glopColor(v + batch->color - 1);
+				if (changed & BATCH_TEX_COORD)
+					glopTexCoord(v + batch->tex_coord - 1);
+				if (changed & BATCH_EDGE_FLAG)
+					glopEdgeFlag(v + batch->edge_flag - 1);
+			}
+			gl_vertex_from_block(&c->vertex[c->vertex_n], b, k);
+#include "error_check.h"
+			gl_vertex_assemble();
+		}
+	}
+	glopEnd(q);
+}
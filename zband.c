@@ -0,0 +1,387 @@
+/*
+ * Band rendering.
+ * A zbuffer opened with ZB_openBanded() only has a zbuffer and a framebuffer for band_height rows of the screen.
+ * Triangles, lines, points, plotted pixels and clears aren't drawn, they are recorded (along with the zbuffer
+ * state they need) in the bins of every band they touch. ZB_renderBands() then draws the bands one after the
+ * other: zbuf and pbuf are pointed band_ymin rows before the band buffers, so the rasterizers keep using
+ * screen coordinates, and the clip rectangle is limited to the rows of the band. Every finished band is handed
+ * to the present callback.
+ * Geometry is transformed, lit and clipped only once, when it is recorded, and a band only draws what touches it.
+ */
+#include <stdlib.h>
+#include <string.h>
+#include "zbuffer.h"
+#include "msghandling.h"
+
+#if TGL_FEATURE_BAND_RASTER == 1
+
+#define BAND_TRIANGLE 0
+#define BAND_LINE     1
+#define BAND_LINE_Z   2
+#define BAND_POINT    3
+#define BAND_PIXEL    4
+#define BAND_CLEAR    5
+
+/* the zbuffer state a primitive is drawn with */
+typedef struct {
+	ZBTexture texture;
+	GLint depth_test;
+	GLint depth_write;
+	GLint enable_blend;
+	GLenum blendeq, sfactor, dfactor;
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+	GLuint dostipple;
+#endif
+	GLfloat pointsize;
+	GLint clip_xmin, clip_ymin, clip_xmax, clip_ymax;
+	const GLubyte* dither_map;
+	GLuint dither_map_size, dither_map_mask, dither_map_shift;
+} ZBBandState;
+
+/*
+ * A recorded primitive. Lines use p[0] and p[1], points and pixels p[0] (the pixel value is in p[0].r).
+ * Clears keep clear_z, z, clear_color and color in p[0].x, p[0].z, p[0].y and p[0].r.
+ */
+typedef struct {
+	GLint kind;
+	GLint state;
+	ZB_fillTriangleFunc fill;
+	ZBufferPoint p[3];
+} ZBBandPrim;
+
+typedef struct {
+	GLint* prims;
+	GLint count, allocated;
+} ZBBand;
+
+struct ZBBands {
+	GLint band_height, band_count;
+	ZBBand* bands;
+	ZBBandPrim* prims;
+	GLint prim_count, prim_allocated;
+	ZBBandState* states;
+	GLint state_count, state_allocated;
+	GLint drawn; /* something other than clears was recorded */
+	ZB_presentBandFunc present;
+	void* user;
+};
+
+/* Grows a bin array to hold at least one more element. Returns 0 when out of memory. */
+static GLint gl_band_grow(void** array, GLint* allocated, GLint count, GLint elem_size) {
+	void* n;
+	GLint i;
+	if (count < *allocated)
+		return 1;
+	i = (*allocated) ? (*allocated * 2) : 64;
+	n = gl_malloc(i * elem_size);
+	if (n == NULL)
+		return 0;
+	if (*array) {
+		memcpy(n, *array, count * elem_size);
+		gl_free(*array);
+	}
+	*array = n;
+	*allocated = i;
+	return 1;
+}
+
+static void gl_band_free_bins(struct ZBBands* b) {
+	GLint i;
+	if (b->bands) {
+		for (i = 0; i < b->band_count; i++)
+			if (b->bands[i].prims)
+				gl_free(b->bands[i].prims);
+		gl_free(b->bands);
+	}
+	b->bands = NULL;
+	b->band_count = 0;
+}
+
+static GLint gl_band_alloc_bins(struct ZBBands* b, GLint ysize) {
+	b->band_count = (ysize + b->band_height - 1) / b->band_height;
+	b->bands = gl_zalloc(sizeof(ZBBand) * b->band_count);
+	if (b->bands == NULL) {
+		b->band_count = 0;
+		return 0;
+	}
+	return 1;
+}
+
+GLint ZB_bandHeight(GLint band_height, GLint ysize) {
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+	/* bands are whole rows of hierarchical z blocks, which are recomputed from the zbuffer */
+	band_height = (band_height + (1 << TGL_HIZ_TILE_POW2) - 1) & ~((1 << TGL_HIZ_TILE_POW2) - 1);
+#endif
+	if (band_height > ysize)
+		band_height = ysize;
+	if (band_height < 1)
+		band_height = 1;
+	return band_height;
+}
+
+GLint ZB_bandOpen(ZBuffer* zb, GLint band_height, ZB_presentBandFunc present, void* user) {
+	struct ZBBands* b = gl_zalloc(sizeof(struct ZBBands));
+	if (b == NULL)
+		return 0;
+	b->band_height = band_height;
+	b->present = present;
+	b->user = user;
+	if (!gl_band_alloc_bins(b, zb->ysize)) {
+		gl_free(b);
+		return 0;
+	}
+	zb->bands = b;
+	zb->band_recording = 1;
+	return 1;
+}
+
+void ZB_bandClose(ZBuffer* zb) {
+	struct ZBBands* b = zb->bands;
+	if (b == NULL)
+		return;
+	gl_band_free_bins(b);
+	if (b->prims)
+		gl_free(b->prims);
+	if (b->states)
+		gl_free(b->states);
+	gl_free(b);
+	zb->bands = NULL;
+	zb->band_recording = 0;
+}
+
+GLint ZB_bandResize(ZBuffer* zb, GLint ysize) {
+	struct ZBBands* b = zb->bands;
+	/* the recorded frame is drawn at the old size */
+	ZB_renderBands(zb);
+	gl_band_free_bins(b);
+	b->band_height = ZB_bandHeight(b->band_height, ysize);
+	if (!gl_band_alloc_bins(b, ysize))
+		exit(1);
+	return b->band_height;
+}
+
+static GLint gl_band_state(ZBuffer* zb, struct ZBBands* b) {
+	ZBBandState* st;
+	if (b->state_count) {
+		st = b->states + b->state_count - 1;
+		if (st->texture.pixmap == zb->current_texture.pixmap && st->texture.s_shift == zb->current_texture.s_shift &&
+			st->texture.t_shift == zb->current_texture.t_shift &&
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+			st->texture.palette == zb->current_texture.palette && st->texture.index_shift == zb->current_texture.index_shift &&
+#endif
+			st->depth_test == zb->depth_test && st->depth_write == zb->depth_write &&
+			st->enable_blend == zb->enable_blend && st->blendeq == zb->blendeq && st->sfactor == zb->sfactor && st->dfactor == zb->dfactor &&
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+			st->dostipple == zb->dostipple &&
+#endif
+			st->pointsize == zb->pointsize && st->clip_xmin == zb->clip_xmin && st->clip_ymin == zb->clip_ymin &&
+			st->clip_xmax == zb->clip_xmax && st->clip_ymax == zb->clip_ymax && st->dither_map == zb->dither_map)
+			return b->state_count - 1;
+	}
+	if (!gl_band_grow((void**)&b->states, &b->state_allocated, b->state_count, sizeof(ZBBandState)))
+		return -1;
+	st = b->states + b->state_count;
+	st->texture = zb->current_texture;
+	st->depth_test = zb->depth_test;
+	st->depth_write = zb->depth_write;
+	st->enable_blend = zb->enable_blend;
+	st->blendeq = zb->blendeq;
+	st->sfactor = zb->sfactor;
+	st->dfactor = zb->dfactor;
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+	st->dostipple = zb->dostipple;
+#endif
+	st->pointsize = zb->pointsize;
+	st->clip_xmin = zb->clip_xmin;
+	st->clip_ymin = zb->clip_ymin;
+	st->clip_xmax = zb->clip_xmax;
+	st->clip_ymax = zb->clip_ymax;
+	st->dither_map = zb->dither_map;
+	st->dither_map_size = zb->dither_map_size;
+	st->dither_map_mask = zb->dither_map_mask;
+	st->dither_map_shift = zb->dither_map_shift;
+	return b->state_count++;
+}
+
+/* Records a primitive in the bands touching rows ymin..ymax (inclusive). Returns it, or NULL when out of memory. */
+static ZBBandPrim* gl_band_add(ZBuffer* zb, GLint kind, GLint ymin, GLint ymax) {
+	struct ZBBands* b = zb->bands;
+	ZBBandPrim* prim;
+	GLint i, state, ok;
+	if (ymin < 0)
+		ymin = 0;
+	if (ymax >= zb->ysize)
+		ymax = zb->ysize - 1;
+	if (ymin > ymax)
+		return NULL;
+	ymin /= b->band_height;
+	ymax /= b->band_height;
+
+	/* make room everywhere first, so that a primitive is never binned only partially */
+	state = gl_band_state(zb, b);
+	ok = (state >= 0) && gl_band_grow((void**)&b->prims, &b->prim_allocated, b->prim_count, sizeof(ZBBandPrim));
+	for (i = ymin; ok && i <= ymax; i++)
+		ok = gl_band_grow((void**)&b->bands[i].prims, &b->bands[i].allocated, b->bands[i].count, sizeof(GLint));
+	if (!ok) {
+		tgl_warning("\nTinyGL: Not enough memory to record a primitive for band rendering, it is not drawn.");
+		return NULL;
+	}
+
+	prim = b->prims + b->prim_count;
+	prim->kind = kind;
+	prim->state = state;
+	for (i = ymin; i <= ymax; i++)
+		b->bands[i].prims[b->bands[i].count++] = b->prim_count;
+	b->prim_count++;
+	if (kind != BAND_CLEAR)
+		b->drawn = 1;
+	return prim;
+}
+
+GLint ZB_bandUnsupported(ZBuffer* zb, const char* what) {
+	if (zb->bands == NULL)
+		return 0;
+	tgl_warning("\nTinyGL: %s needs the whole frame, which a banded zbuffer doesn't hold.", what);
+	return 1;
+}
+
+void ZB_bandTriangle(ZBuffer* zb, ZB_fillTriangleFunc fill, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+	ZBBandPrim* prim;
+	GLint ymin, ymax;
+	ymin = ymax = p0->y;
+	if (p1->y < ymin) ymin = p1->y;
+	if (p1->y > ymax) ymax = p1->y;
+	if (p2->y < ymin) ymin = p2->y;
+	if (p2->y > ymax) ymax = p2->y;
+	if (ymin < zb->clip_ymin) ymin = zb->clip_ymin;
+	if (ymax >= zb->clip_ymax) ymax = zb->clip_ymax - 1;
+	prim = gl_band_add(zb, BAND_TRIANGLE, ymin, ymax);
+	if (prim == NULL)
+		return;
+	prim->fill = fill;
+	prim->p[0] = *p0;
+	prim->p[1] = *p1;
+	prim->p[2] = *p2;
+}
+
+void ZB_bandLine(ZBuffer* zb, GLint depth, ZBufferPoint* p1, ZBufferPoint* p2) {
+	ZBBandPrim* prim = gl_band_add(zb, depth ? BAND_LINE_Z : BAND_LINE, (p1->y < p2->y) ? p1->y : p2->y, (p1->y > p2->y) ? p1->y : p2->y);
+	if (prim == NULL)
+		return;
+	prim->p[0] = *p1;
+	prim->p[1] = *p2;
+}
+
+void ZB_bandPoint(ZBuffer* zb, ZBufferPoint* p) {
+	ZBBandPrim* prim = gl_band_add(zb, BAND_POINT, p->y - (GLint)zb->pointsize, p->y + (GLint)zb->pointsize);
+	if (prim == NULL)
+		return;
+	prim->p[0] = *p;
+}
+
+void ZB_bandPixel(ZBuffer* zb, GLint x, GLint y, PIXEL pix) {
+	ZBBandPrim* prim = gl_band_add(zb, BAND_PIXEL, y, y);
+	if (prim == NULL)
+		return;
+	prim->p[0].x = x;
+	prim->p[0].y = y;
+	prim->p[0].r = pix;
+}
+
+void ZB_bandClear(ZBuffer* zb, GLint clear_z, GLint z, GLint clear_color, GLuint color) {
+	ZBBandPrim* prim;
+	/* a clear after drawing starts a new frame */
+	if (zb->bands->drawn)
+		ZB_renderBands(zb);
+	prim = gl_band_add(zb, BAND_CLEAR, 0, zb->ysize - 1);
+	if (prim == NULL)
+		return;
+	prim->p[0].x = clear_z;
+	prim->p[0].z = z;
+	prim->p[0].y = clear_color;
+	prim->p[0].r = color;
+}
+
+static void gl_band_draw(ZBuffer* zb, struct ZBBands* b, ZBBandPrim* prim) {
+	ZBBandState* st = b->states + prim->state;
+	/* the primitives sort and modify their points, so every band needs its own copies */
+	ZBufferPoint p0 = prim->p[0], p1 = prim->p[1], p2 = prim->p[2];
+	zb->current_texture = st->texture;
+	zb->depth_test = st->depth_test;
+	zb->depth_write = st->depth_write;
+	zb->enable_blend = st->enable_blend;
+	zb->blendeq = st->blendeq;
+	zb->sfactor = st->sfactor;
+	zb->dfactor = st->dfactor;
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+	zb->dostipple = st->dostipple;
+#endif
+	zb->pointsize = st->pointsize;
+	zb->dither_map = st->dither_map;
+	zb->dither_map_size = st->dither_map_size;
+	zb->dither_map_mask = st->dither_map_mask;
+	zb->dither_map_shift = st->dither_map_shift;
+	zb->clip_xmin = st->clip_xmin;
+	zb->clip_xmax = st->clip_xmax;
+	zb->clip_ymin = (st->clip_ymin > zb->band_ymin) ? st->clip_ymin : zb->band_ymin;
+	zb->clip_ymax = (st->clip_ymax < zb->band_ymax) ? st->clip_ymax : zb->band_ymax;
+
+	switch (prim->kind) {
+	case BAND_TRIANGLE:
+		if (zb->clip_ymin < zb->clip_ymax)
+			prim->fill(zb, &p0, &p1, &p2);
+		break;
+	case BAND_LINE:
+		ZB_line(zb, &p0, &p1);
+		break;
+	case BAND_LINE_Z:
+		ZB_line_z(zb, &p0, &p1);
+		break;
+	case BAND_POINT:
+		ZB_plot(zb, &p0);
+		break;
+	case BAND_PIXEL:
+		ZB_plotPixel(zb, p0.x, p0.y, p0.r);
+		break;
+	case BAND_CLEAR:
+		ZB_clearRows(zb, p0.x, p0.z, p0.y, p0.r, zb->band_ymin, zb->band_ymax);
+		break;
+	}
+}
+
+void ZB_renderBands(ZBuffer* zb) {
+	struct ZBBands* b = zb->bands;
+	ZBuffer saved;
+	PIXEL* pbuf;
+	GLushort* zbuf;
+	GLint i, j;
+
+	if (b == NULL || b->prim_count == 0)
+		return;
+	saved = *zb;
+	pbuf = zb->pbuf;
+	zbuf = zb->zbuf;
+	zb->band_recording = 0;
+	for (i = 0; i < b->band_count; i++) {
+		ZBBand* band = b->bands + i;
+		zb->band_ymin = i * b->band_height;
+		zb->band_ymax = zb->band_ymin + b->band_height;
+		if (zb->band_ymax > zb->ysize)
+			zb->band_ymax = zb->ysize;
+		/* the rasterizers address the band buffers with screen coordinates */
+		zb->pbuf = (PIXEL*)((GLbyte*)pbuf - zb->band_ymin * zb->linesize);
+		zb->zbuf = zbuf - zb->band_ymin * zb->xsize;
+		for (j = 0; j < band->count; j++)
+			gl_band_draw(zb, b, b->prims + band->prims[j]);
+		band->count = 0;
+		if (b->present)
+			b->present(zb, pbuf, zb->band_ymin, zb->band_ymax - zb->band_ymin, b->user);
+	}
+	/* back to recording with the current state */
+	*zb = saved;
+	b->prim_count = 0;
+	b->state_count = 0;
+	b->drawn = 0;
+}
+
+#endif
@@ -12,7 +12,8 @@
 #include "dither_maps.h"
 
 
-ZBuffer* ZB_open(GLint xsize, GLint ysize, GLint mode, void* frame_buffer) {
+/* Opens a zbuffer whose zbuf and pbuf (unless frame_buffer is given) only hold the first rows rows. */
+static ZBuffer* gl_zb_open(GLint xsize, GLint ysize, GLint rows, GLint mode, void* frame_buffer) {
 	ZBuffer* zb;
 	GLint size;
 
@@ -47,14 +48,14 @@ ZBuffer* ZB_open(GLint xsize, GLint ysize, GLint mode, void* frame_buffer) {
 #endif
 
 
-	size = zb->xsize * zb->ysize * sizeof(GLushort);
+	size = zb->xsize * rows * sizeof(GLushort);
 
 	zb->zbuf = gl_malloc(size);
 	if (zb->zbuf == NULL)
 		goto error;
 
 	if (frame_buffer == NULL) {
-		zb->pbuf = gl_malloc(zb->ysize * zb->linesize);
+		zb->pbuf = gl_malloc(rows * zb->linesize);
 		if (zb->pbuf == NULL) {
 			gl_free(zb->zbuf);
 			goto error;
@@ -65,10 +66,41 @@ ZBuffer* ZB_open(GLint xsize, GLint ysize, GLint mode, void* frame_buffer) {
 		zb->pbuf = frame_buffer;
 	}
 
-	zb->current_texture = NULL;
+	ZB_setTexture(zb, NULL, 0, 0, 0, 0);
+
+	zb->clip_xmin = 0;
+	zb->clip_ymin = 0;
+	zb->clip_xmax = zb->xsize;
+	zb->clip_ymax = zb->ysize;
+
+#if TGL_FEATURE_HALFSPACE_RASTER == 1
+	zb->raster_backend = ZB_BACKEND_SCANLINE;
+#endif
+
+#if TGL_FEATURE_TILED_RASTER == 1
+	zb->raster_mode = ZB_RASTER_IMMEDIATE;
+	zb->raster_threads = 1;
+	zb->tile_bins = NULL;
+#endif
 
-	zb->dither_map = dither_maps[0].map;
-	zb->dither_map_size = dither_maps[0].size;
+	ZB_setDitheringMap(zb, 0);
+
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+	ZB_hizOpen(zb);
+#endif
+#if TGL_FEATURE_DIRTY_RECTS == 1
+	ZB_dirtyOpen(zb);
+#endif
+#if TGL_FEATURE_FAST_CLEAR == 1
+	zb->fast_clear = 0;
+	ZB_fastClearOpen(zb);
+#endif
+#if TGL_FEATURE_BAND_RASTER == 1
+	zb->bands = NULL;
+	zb->band_recording = 0;
+	zb->band_ymin = 0;
+	zb->band_ymax = zb->ysize;
+#endif
 
 	return zb;
 error:
@@ -76,7 +108,42 @@ error:
 	return NULL;
 }
 
+ZBuffer* ZB_open(GLint xsize, GLint ysize, GLint mode, void* frame_buffer) {
+	return gl_zb_open(xsize, ysize, ysize, mode, frame_buffer);
+}
+
+#if TGL_FEATURE_BAND_RASTER == 1
+ZBuffer* ZB_openBanded(GLint xsize, GLint ysize, GLint mode, GLint band_height, ZB_presentBandFunc present, void* user) {
+	ZBuffer* zb;
+	band_height = ZB_bandHeight(band_height, ysize);
+	zb = gl_zb_open(xsize, ysize, band_height, mode, NULL);
+	if (zb == NULL)
+		return NULL;
+	if (!ZB_bandOpen(zb, band_height, present, user)) {
+		ZB_close(zb);
+		return NULL;
+	}
+	return zb;
+}
+#endif
+
 void ZB_close(ZBuffer* zb) {
+#if TGL_FEATURE_TILED_RASTER == 1
+	ZB_closeTiles(zb);
+#endif
+
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+	ZB_hizClose(zb);
+#endif
+#if TGL_FEATURE_DIRTY_RECTS == 1
+	ZB_dirtyClose(zb);
+#endif
+#if TGL_FEATURE_FAST_CLEAR == 1
+	ZB_fastClearClose(zb);
+#endif
+#if TGL_FEATURE_BAND_RASTER == 1
+	ZB_bandClose(zb);
+#endif
 
 	if (zb->frame_buffer_allocated)
 		gl_free(zb->pbuf);
@@ -86,7 +153,19 @@ void ZB_close(ZBuffer* zb) {
 }
 
 void ZB_resize(ZBuffer* zb, void* frame_buffer, GLint xsize, GLint ysize) {
-	GLint size;
+	GLint size, rows = ysize;
+#if TGL_FEATURE_TILED_RASTER == 1
+	GLint raster_mode = zb->raster_mode;
+	/* the tile grid depends on the size */
+	ZB_closeTiles(zb);
+#endif
+#if TGL_FEATURE_BAND_RASTER == 1
+	if (zb->bands) {
+		/* the buffers keep holding a band */
+		rows = ZB_bandResize(zb, ysize);
+		frame_buffer = NULL;
+	}
+#endif
 
 	/* xsize must be a multiple of 4 */
 	xsize = xsize & ~3;
@@ -100,7 +179,7 @@ void ZB_resize(ZBuffer* zb, void* frame_buffer, GLint xsize, GLint ysize) {
 	zb->linesize = (xsize * PSZB);
 #endif
 
-	size = zb->xsize * zb->ysize * sizeof(GLushort);
+	size = zb->xsize * rows * sizeof(GLushort);
 
 	gl_free(zb->zbuf);
 	zb->zbuf = gl_malloc(size);
@@ -110,7 +189,7 @@ void ZB_resize(ZBuffer* zb, void* frame_buffer, GLint xsize, GLint ysize) {
 		gl_free(zb->pbuf);
 
 	if (frame_buffer == NULL) {
-		zb->pbuf = gl_malloc(zb->ysize * zb->linesize);
+		zb->pbuf = gl_malloc(rows * zb->linesize);
 		if (!zb->pbuf)
 			exit(1);
 		zb->frame_buffer_allocated = 1;
@@ -118,6 +197,31 @@ void ZB_resize(ZBuffer* zb, void* frame_buffer, GLint xsize, GLint ysize) {
 		zb->pbuf = frame_buffer;
 		zb->frame_buffer_allocated = 0;
 	}
+
+	zb->clip_xmin = 0;
+	zb->clip_ymin = 0;
+	zb->clip_xmax = zb->xsize;
+	zb->clip_ymax = zb->ysize;
+#if TGL_FEATURE_BAND_RASTER == 1
+	zb->band_ymax = zb->ysize;
+#endif
+
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+	ZB_hizClose(zb);
+	ZB_hizOpen(zb);
+#endif
+#if TGL_FEATURE_DIRTY_RECTS == 1
+	ZB_dirtyClose(zb);
+	ZB_dirtyOpen(zb);
+#endif
+#if TGL_FEATURE_FAST_CLEAR == 1
+	ZB_fastClearClose(zb);
+	ZB_fastClearOpen(zb);
+#endif
+
+#if TGL_FEATURE_TILED_RASTER == 1
+	ZB_setRasterMode(zb, raster_mode);
+#endif
 }
 
 #if TGL_FEATURE_32_BITS == 1
@@ -306,7 +410,10 @@ static void ZB_copyFrameBufferRGB24(ZBuffer * zb,
 #if TGL_FEATURE_RENDER_BITS == 16
 
 void ZB_copyFrameBuffer(ZBuffer* zb, void* buf, GLint linesize) {
-
+	if (ZB_bandUnsupported(zb, "ZB_copyFrameBuffer()"))
+		return;
+	ZB_flushTiles(zb);
+	ZB_resolveClear(zb, 0, 1);
 	ZB_copyBuffer(zb, buf, linesize);
 }
 
@@ -320,6 +427,10 @@ void ZB_copyFrameBuffer(ZBuffer* zb, void* buf, GLint linesize) {
 
 
 void ZB_copyFrameBuffer(ZBuffer* zb, void* buf, GLint linesize) {
+	if (ZB_bandUnsupported(zb, "ZB_copyFrameBuffer()"))
+		return;
+	ZB_flushTiles(zb);
+	ZB_resolveClear(zb, 0, 1);
 	ZB_copyBuffer(zb, buf, linesize);
 }
 
@@ -330,8 +441,14 @@ void ZB_copyFrameBuffer(ZBuffer* zb, void* buf, GLint linesize) {
 #if TGL_FEATURE_RENDER_BITS == 1
 
 void ZB_copyFrameBuffer(ZBuffer* zb, void* buf, GLint linesize) {
-
+	if (ZB_bandUnsupported(zb, "ZB_copyFrameBuffer()"))
+		return;
+	ZB_flushTiles(zb);
+#if TGL_FEATURE_FAST_CLEAR == 1
+	ZB_copy1BRows(zb, buf, zb->linesize, 0, 0, zb->xsize, zb->ysize);
+#else
 	memcpy(buf, zb->pbuf, zb->ysize * zb->linesize);
+#endif
 }
 
 #endif
@@ -340,11 +457,14 @@ GLint ZB_copyFrameBufferARGB32(ZBuffer* zb, void* buf, GLuint bufSize)
 {
 	GLuint req_size = zb->xsize * zb->ysize * 4;
 
-	if (bufSize < req_size)
+	if (bufSize < req_size || ZB_bandUnsupported(zb, "ZB_copyFrameBufferARGB32()"))
 	{
 		return 0;
 	}
 
+	ZB_flushTiles(zb);
+	ZB_resolveClear(zb, 0, 1);
+
 #if TGL_FEATURE_RENDER_BITS == 1
 
     GLint ls = zb->linesize;
@@ -417,40 +537,68 @@ static void memset_l(void* adr, GLint val, GLint count) {
 		*p++ = val;
 }
 
-void ZB_clear(ZBuffer* zb, GLint clear_z, GLint z, GLint clear_color, GLint r, GLint g, GLint b) {
-	GLuint color;
+void ZB_clearRows(ZBuffer* zb, GLint clear_z, GLint z, GLint clear_color, GLuint color, GLint ymin, GLint ymax) {
+#if TGL_FEATURE_RENDER_BITS != 1
 	GLint y;
 	PIXEL* pp;
-	if (clear_z) {
-		memset_s(zb->zbuf, z, zb->xsize * zb->ysize);
-	}
+#endif
+	if (clear_z)
+		memset_s(zb->zbuf + ymin * zb->xsize, z, zb->xsize * (ymax - ymin));
 	if (clear_color) {
-		pp = zb->pbuf;
-		for (y = 0; y < zb->ysize; y++) {
-#if TGL_FEATURE_RENDER_BITS == 15 || TGL_FEATURE_RENDER_BITS == 16
-			// color = RGB_TO_PIXEL(r, g, b);
-#if TGL_FEATURE_FORCE_CLEAR_NO_COPY_COLOR
-			color = TGL_NO_COPY_COLOR;
+#if TGL_FEATURE_RENDER_BITS == 1
+		memset((GLbyte*)zb->pbuf + ymin * zb->linesize, color, zb->linesize * (ymax - ymin));
 #else
-			color = RGB_TO_PIXEL(r, g, b);
-#endif
+		pp = (PIXEL*)((GLbyte*)zb->pbuf + ymin * zb->linesize);
+		for (y = ymin; y < ymax; y++) {
+#if TGL_FEATURE_RENDER_BITS == 15 || TGL_FEATURE_RENDER_BITS == 16
 			memset_s(pp, color, zb->xsize);
 #elif TGL_FEATURE_RENDER_BITS == 32
-#if TGL_FEATURE_FORCE_CLEAR_NO_COPY_COLOR
-			color = TGL_NO_COPY_COLOR;
-#else
-			color = RGB_TO_PIXEL(r, g, b);
-#endif
 			memset_l(pp, color, zb->xsize);
-#elif TGL_FEATURE_RENDER_BITS == 1
-
-			memset(zb->pbuf, RGB_TO_PIXEL(r, g, b) ? 0xff : 0, zb->linesize * zb->ysize);
 #else
 #error BADJUJU
 #endif
 			pp = (PIXEL*)((GLbyte*)pp + zb->linesize);
 		}
+#endif
+	}
+}
+
+void ZB_clear(ZBuffer* zb, GLint clear_z, GLint z, GLint clear_color, GLint r, GLint g, GLint b) {
+	GLuint color;
+	ZB_flushTiles(zb);
+#if TGL_FEATURE_FORCE_CLEAR_NO_COPY_COLOR && TGL_FEATURE_RENDER_BITS != 1
+	color = TGL_NO_COPY_COLOR;
+#elif TGL_FEATURE_RENDER_BITS == 1
+	/* a byte of 8 pixels */
+	color = RGB_TO_PIXEL(r, g, b) ? 0xff : 0;
+#else
+	color = RGB_TO_PIXEL(r, g, b);
+#endif
+#if TGL_FEATURE_BAND_RASTER == 1
+	/* draws the previous frame if something was drawn since the last clear */
+	if (zb->band_recording)
+		ZB_bandClear(zb, clear_z, z, clear_color, color);
+#endif
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+	if (clear_z)
+		ZB_hizClear(zb, z);
+#endif
+#if TGL_FEATURE_DIRTY_RECTS == 1
+	if (clear_color)
+		ZB_dirtyClear(zb, color);
+#endif
+#if TGL_FEATURE_BAND_RASTER == 1
+	/* the buffers are cleared band by band */
+	if (zb->band_recording)
+		return;
+#endif
+#if TGL_FEATURE_FAST_CLEAR == 1
+	if (zb->fast_clear) {
+		ZB_fastClear(zb, clear_z, z, clear_color, color);
+		return;
 	}
+#endif
+	ZB_clearRows(zb, clear_z, z, clear_color, color, 0, zb->ysize);
 }
 
 void ZB_setDitheringMap(ZBuffer *zb, GLuint mapId)
@@ -459,8 +607,35 @@ void ZB_setDitheringMap(ZBuffer *zb, GLuint mapId)
 	{
 		mapId = 0;
 	}
-	
+
+	ZB_flushTiles(zb);
 	zb->dither_map = dither_maps[mapId].map;
 	zb->dither_map_size = dither_maps[mapId].size;
+	/* all the dither maps are square with a power of 2 side, rows are fetched with a shift and columns with a mask */
+	zb->dither_map_mask = zb->dither_map_size - 1;
+	for (zb->dither_map_shift = 0; (1u << zb->dither_map_shift) < zb->dither_map_size; zb->dither_map_shift++)
+		;
+}
+
+#if TGL_FEATURE_RENDER_BITS == 1
+/*
+ * Writes up to 32 packed pixels of the 1 bit framebuffer, starting at pixel index pix, which must be a multiple of 8.
+ * Bit i of cov says whether pixel pix + i is written, bit i of val is its new value.
+ * Fully covered bytes are stored without being read and bytes with nothing to write are skipped.
+ * Passing val as cov only sets bits, for the OR semantics of lines and points.
+ */
+void ZB_put1BSpan(ZBuffer* zb, GLuint pix, GLuint cov, GLuint val) {
+	GLubyte* p = zb->pbuf + (pix >> 3);
+	while (cov) {
+		GLubyte c = cov & 0xff;
+		if (c == 0xff)
+			*p = val;
+		else if (c)
+			*p = (*p & ~c) | (val & c);
+		p++;
+		cov >>= 8;
+		val >>= 8;
+	}
 }
+#endif
 
@@ -22,16 +22,6 @@
 #define ZB_POINT_S_MAX ( (1<<(1+TGL_FEATURE_TEXTURE_POW2+ZB_POINT_S_FRAC_BITS))-ZB_POINT_S_MIN )
 #define ZB_POINT_T_MIN ( (1<<ZB_POINT_T_FRAC_BITS) )
 #define ZB_POINT_T_MAX ( (1<<(1+TGL_FEATURE_TEXTURE_POW2+ZB_POINT_T_FRAC_BITS))-ZB_POINT_T_MIN )
-#define ZB_POINT_S_VALUE (ZB_POINT_S_FRAC_BITS + 4)
-#define ZB_POINT_T_VALUE (ZB_POINT_T_FRAC_BITS - 4)
-#define ZB_S_MASK ((TGL_FEATURE_TEXTURE_DIM-1)<<(ZB_POINT_S_FRAC_BITS+1))
-#define ZB_T_MASK ((TGL_FEATURE_TEXTURE_DIM-1)<<(ZB_POINT_T_FRAC_BITS+1))
-
-#if ZB_POINT_T_FRAC_BITS == (ZB_POINT_S_FRAC_BITS + TGL_FEATURE_TEXTURE_POW2)
-#define ST_TO_TEXTURE_BYTE_OFFSET(s,t) ( ((s & ZB_S_MASK) | (t & ZB_T_MASK)) >> (ZB_POINT_S_VALUE-PSZSH))
-#else
-#define ST_TO_TEXTURE_BYTE_OFFSET(s,t) ( ((s & ZB_S_MASK)>>(ZB_POINT_S_VALUE-PSZSH)) | ((t & ZB_T_MASK)>>(ZB_POINT_T_VALUE-PSZSH))  )
-#endif
 
 /*The corrected mult mask prevents a bug relating to color interp. it's also why the color bit depth is so damn high.*/
 #define COLOR_MULT_MASK (0xff0000)
@@ -61,10 +51,22 @@
 #endif
 /*This is how textures are sampled. if you want to do some sort of fancy texture filtering,*/
 /*you do it here.*/
-#define TEXTURE_SAMPLE(texture, s, t)														\
- (*(PIXEL*)( (GLbyte*)texture + 															\
- ST_TO_TEXTURE_BYTE_OFFSET(s,t) 								\
- ))
+#if TGL_FEATURE_TEXTURE_TILES == 1
+#define TEXTURE_OFFSET(texture, s, t)														\
+ ((((s) >> (texture).s_shift) & (texture).s_mask) | (((t) >> (texture).t_shift) & (texture).t_mask) |			\
+  (((s) >> (texture).s_tile_shift) & (texture).s_tile_mask) | (((t) >> (texture).t_tile_shift) & (texture).t_tile_mask))
+#else
+#define TEXTURE_OFFSET(texture, s, t)														\
+ ((((s) >> (texture).s_shift) & (texture).s_mask) | (((t) >> (texture).t_shift) & (texture).t_mask))
+#endif
+#define TEXTURE_SAMPLE(texture, s, t) ((texture).pixmap[TEXTURE_OFFSET(texture, s, t)])
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+/* the palette entry of the index at texel offset o, the first of a byte's 2 4 bit indices being in its low bits */
+#define TEXTURE_INDEXED_TEXEL(texture, o)													\
+ ((texture).palette[(((const GLubyte*)(texture).pixmap)[(o) >> (texture).index_shift] >> (((o) & (texture).index_shift) << 2)) & \
+		    (texture).index_mask])
+#define TEXTURE_SAMPLE_INDEXED(texture, s, t) TEXTURE_INDEXED_TEXEL(texture, TEXTURE_OFFSET(texture, s, t))
+#endif
 /* display modes */
 #define ZB_MODE_5R6G5B  1  /* true color 16 bits */
 #define ZB_MODE_INDEX   2  /* color index 8 bits */
@@ -141,7 +143,11 @@ typedef GLubyte PIXEL;
 #define DITHER_MAP_BLUE_NOISE1      9
 
 
-#if TGL_FEATURE_LIT_TEXTURES == 1
+#if TGL_FEATURE_LIT_TEXTURES == 1 && TGL_FEATURE_RENDER_BITS == 1
+/* 1 bit textures hold luminance, scaled by the intensity RGB_TO_PIXEL gives the color */
+#define RGB_MIX_FUNC(rr, gg, bb, tpix) \
+	((RGB_TO_PIXEL(rr, gg, bb) * (tpix) + 255) >> 8)
+#elif TGL_FEATURE_LIT_TEXTURES == 1
 #define RGB_MIX_FUNC(rr, gg, bb, tpix) \
 	RGB_TO_PIXEL( \
 		((rr * GET_RED(tpix))>>8),\
@@ -274,13 +280,53 @@ typedef GLubyte PIXEL;
 #endif
 
 
+/* a rectangle of the framebuffer, xmax and ymax are exclusive */
+typedef struct {
+    GLint xmin, ymin, xmax, ymax;
+} ZBRect;
+
+#if TGL_FEATURE_MIPMAPS == 1
+#define ZB_TEXTURE_LEVELS (TGL_FEATURE_TEXTURE_POW2 + 1)
+#else
+#define ZB_TEXTURE_LEVELS 1
+#endif
+
+/*
+A texture, whose width and height are powers of 2. S and T are texel coordinates in a TGL_FEATURE_TEXTURE_DIM wide
+and tall texture, with ZB_POINT_S_FRAC_BITS + 1 and ZB_POINT_T_FRAC_BITS + 1 fraction bits. The shifts scale them
+down to the size of pixmap, and the masks wrap them and put T's texel row above S's texel.
+In a tiled texture, those give the texel in its tile and the tile shifts and masks give the tile.
+*/
+typedef struct ZBTexture {
+	PIXEL* pixmap;
+	GLint s_shift, t_shift;
+	GLuint s_mask, t_mask;
+#if TGL_FEATURE_TEXTURE_TILES == 1
+	GLint s_tile_shift, t_tile_shift;
+	GLuint s_tile_mask, t_tile_mask;
+	GLint tiled; /* stored in 4x4 texel tiles, see gl_tileImage() */
+#endif
+#if TGL_FEATURE_MIPMAPS == 1
+	/* the mip chain, levels[0] being 2^xsize_log2 x 2^ysize_log2, which the fills pick pixmap from */
+	PIXEL* levels[ZB_TEXTURE_LEVELS];
+	GLint level_count;
+	GLint xsize_log2, ysize_log2;
+#endif
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+	/* for the ZB_FILL_MAPPING_INDEXED fills: pixmap holds palette indices, 2^index_shift to a byte */
+	PIXEL* palette;
+	GLint index_shift;
+	GLuint index_mask;
+#endif
+} ZBTexture;
+
 typedef struct {
 
     
     
     GLushort *zbuf;
     PIXEL *pbuf;
-    PIXEL *current_texture;
+    ZBTexture current_texture;
     
 
 	/* point size*/
@@ -307,6 +353,56 @@ typedef struct {
 
     const GLubyte *dither_map;
     GLuint dither_map_size;
+    GLuint dither_map_mask; /* dither_map_size - 1 */
+    GLuint dither_map_shift; /* log2(dither_map_size) */
+
+    /* clip rectangle of the rasterizer, xmax and ymax are exclusive */
+    GLint clip_xmin, clip_ymin, clip_xmax, clip_ymax;
+
+#if TGL_FEATURE_HALFSPACE_RASTER == 1
+    /* triangle rasterizer backend, ZB_BACKEND_SCANLINE or ZB_BACKEND_HALFSPACE */
+    GLint raster_backend;
+#endif
+
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+    /* hierarchical z (zhiz.c) */
+    GLushort *hiz_min; /* lower bound of the depth of every block */
+    GLubyte *hiz_dirty; /* block written since its bound was computed */
+    GLint hiz_xsize, hiz_ysize; /* size in blocks */
+#endif
+
+#if TGL_FEATURE_DIRTY_RECTS == 1
+    /* dirty rectangles (zdirty.c) */
+    GLubyte *dirty_tiles; /* changed since the last copy / drawn since the last color clear flags of every tile */
+    GLint dirty_xsize, dirty_ysize; /* size in tiles */
+    GLint clear_valid; /* the last color clear was to clear_pixel */
+    GLuint clear_pixel;
+#endif
+
+#if TGL_FEATURE_FAST_CLEAR == 1
+    /* fast clears (zclear.c) */
+    GLint fast_clear; /* ZB_clear() only starts a new epoch */
+    GLint fast_pending; /* some tiles may not be cleared yet */
+    GLubyte *fast_z_epochs, *fast_color_epochs; /* the epoch every tile was last cleared in */
+    GLubyte fast_z_epoch, fast_color_epoch; /* the epoch of the last clear */
+    GLint fast_xsize, fast_ysize; /* size in tiles */
+    GLushort fast_z;
+    GLuint fast_color;
+#endif
+
+#if TGL_FEATURE_TILED_RASTER == 1
+    /* tiled rasterizer (ztile.c) */
+    GLint raster_mode;
+    GLint raster_threads;
+    struct ZBTileBins *tile_bins;
+#endif
+
+#if TGL_FEATURE_BAND_RASTER == 1
+    /* band rendering (zband.c) */
+    struct ZBBands *bands; /* NULL unless opened with ZB_openBanded() */
+    GLint band_recording; /* primitives are recorded instead of drawn */
+    GLint band_ymin, band_ymax; /* the rows held by zbuf and pbuf, ymax exclusive */
+#endif
 
 } ZBuffer;
 
@@ -327,6 +423,8 @@ void ZB_close(ZBuffer *zb);
 void ZB_resize(ZBuffer *zb,void *frame_buffer,GLint xsize,GLint ysize);
 void ZB_clear(ZBuffer *zb,GLint clear_z,GLint z,
 	      GLint clear_color,GLint r,GLint g,GLint b);
+/* Writes the clear values to rows ymin..ymax-1 of the zbuffer and/or the framebuffer. color is the pixel, or byte in 1 bit mode. */
+void ZB_clearRows(ZBuffer *zb, GLint clear_z, GLint z, GLint clear_color, GLuint color, GLint ymin, GLint ymax);
 /* linesize is in BYTES */
 void ZB_copyFrameBuffer(ZBuffer *zb,void *buf,GLint linesize);
 
@@ -346,10 +444,31 @@ void ZB_ditherFrameBuffer(ZBuffer *zb,unsigned char *dest,
 void ZB_plot(ZBuffer *zb,ZBufferPoint *p);
 void ZB_line(ZBuffer *zb,ZBufferPoint *p1,ZBufferPoint *p2);
 void ZB_line_z(ZBuffer * zb, ZBufferPoint * p1, ZBufferPoint * p2);
+/* Sets pixel x, y to pix, which is dithered in 1 bit mode. */
+void ZB_plotPixel(ZBuffer *zb, GLint x, GLint y, PIXEL pix);
 
 /* ztriangle.c */
 
-void ZB_setTexture(ZBuffer *zb, PIXEL *texture);
+/*
+Sets the texture of the triangles drawn with ZB_FILL_MAPPING: levels[0] is 2^xsize_log2 x 2^ysize_log2 pixels, each
+of the level_count levels half the size of the one before, stored in 4x4 texel tiles if tiled is set.
+A texture without levels is black.
+*/
+void ZB_setTexture(ZBuffer *zb, PIXEL **levels, GLint level_count, GLint xsize_log2, GLint ysize_log2, GLint tiled);
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+/*
+Sets the palette of the triangles drawn with ZB_FILL_MAPPING_INDEXED, whose texture levels hold index_bits (8 or 4)
+bit indices. palette has size entries, a power of 2, the indices are masked to it. A texture without a palette is black.
+*/
+void ZB_setTexturePalette(ZBuffer *zb, PIXEL *palette, GLint size, GLint index_bits);
+#endif
+
+#define ZB_BACKEND_SCANLINE  0
+#define ZB_BACKEND_HALFSPACE 1
+
+void ZB_setRasterBackend(ZBuffer *zb, GLint backend);
+/* Triangles are only drawn in xmin..xmax-1, ymin..ymax-1 (clamped to the zbuffer). */
+void ZB_setClipRect(ZBuffer *zb, GLint xmin, GLint ymin, GLint xmax, GLint ymax);
 
 void ZB_fillTriangleFlat(ZBuffer *zb,
 		 ZBufferPoint *p1,ZBufferPoint *p2,ZBufferPoint *p3);
@@ -375,10 +494,156 @@ void ZB_fillTriangleMappingPerspective(ZBuffer *zb,
 void ZB_fillTriangleMappingPerspectiveNOBLEND(ZBuffer *zb,
                     ZBufferPoint *p0,ZBufferPoint *p1,ZBufferPoint *p2);
 
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+void ZB_fillTriangleMappingIndexed(ZBuffer *zb,
+                    ZBufferPoint *p0,ZBufferPoint *p1,ZBufferPoint *p2);
+
+void ZB_fillTriangleMappingIndexedNOBLEND(ZBuffer *zb,
+                    ZBufferPoint *p0,ZBufferPoint *p1,ZBufferPoint *p2);
+#endif
+
 typedef void (*ZB_fillTriangleFunc)(ZBuffer  *,
 	    ZBufferPoint *,ZBufferPoint *,ZBufferPoint *);
 
+#define ZB_FILL_FLAT    0
+#define ZB_FILL_SMOOTH  1
+#define ZB_FILL_MAPPING 2
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+#define ZB_FILL_MAPPING_INDEXED 3
+#define ZB_FILL_KINDS   4
+#else
+#define ZB_FILL_KINDS   3
+#endif
+/* The fill function of the given kind for the current depth, stipple and blend state. */
+ZB_fillTriangleFunc ZB_getFillFunc(ZBuffer *zb, GLint kind);
+
 void ZB_setDitheringMap(ZBuffer *zb, GLuint mapId);
+#if TGL_FEATURE_RENDER_BITS == 1
+void ZB_put1BSpan(ZBuffer *zb, GLuint pix, GLuint cov, GLuint val);
+#endif
+/* The dither thresholds of screen row y. Index the row with ZB_DITHER_COLUMN(zb, x). */
+#define ZB_DITHER_ROW(zb, y) ((zb)->dither_map + (((GLuint)(y) & (zb)->dither_map_mask) << (zb)->dither_map_shift))
+#define ZB_DITHER_COLUMN(zb, x) ((GLuint)(x) & (zb)->dither_map_mask)
+
+/* ztile.c */
+
+#define ZB_RASTER_IMMEDIATE 0
+#define ZB_RASTER_TILED     1
+
+#if TGL_FEATURE_TILED_RASTER == 1
+void ZB_setRasterMode(ZBuffer *zb, GLint mode);
+void ZB_setRasterThreads(ZBuffer *zb, GLint num_threads);
+void ZB_binTriangle(ZBuffer *zb, ZB_fillTriangleFunc fill,
+		 ZBufferPoint *p0,ZBufferPoint *p1,ZBufferPoint *p2);
+void ZB_flushTiles(ZBuffer *zb);
+void ZB_closeTiles(ZBuffer *zb);
+#else
+#define ZB_flushTiles(zb) /* a comment */
+#endif
+
+/* zhiz.c */
+
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+void ZB_hizOpen(ZBuffer *zb);
+void ZB_hizClose(ZBuffer *zb);
+void ZB_hizClear(ZBuffer *zb, GLushort z);
+void ZB_hizInvalidate(ZBuffer *zb, GLint x0, GLint y0, GLint x1, GLint y1);
+void ZB_hizSpanWritten(ZBuffer *zb, GLint x0, GLint x1, GLint y, GLint depth_test);
+GLint ZB_hizOccluded(ZBuffer *zb, GLint x0, GLint y0, GLint x1, GLint y1, GLuint z, GLint refine);
+GLuint ZB_hizTriangleDepth(ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2, GLint dzdx, GLint dzdy);
+GLint ZB_hizTriangleOccluded(ZBuffer *zb, ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2, GLuint z);
+#else
+#define ZB_hizInvalidate(zb, x0, y0, x1, y1) /* a comment */
+#endif
+
+/* zdirty.c */
+
+#if TGL_FEATURE_DIRTY_RECTS == 1
+void ZB_dirtyOpen(ZBuffer *zb);
+void ZB_dirtyClose(ZBuffer *zb);
+void ZB_dirtyClear(ZBuffer *zb, GLuint pixel);
+void ZB_addDirtyRect(ZBuffer *zb, GLint xmin, GLint ymin, GLint xmax, GLint ymax);
+/*
+ * Copies up to max_rects of the rectangles changed since the last ZB_clearDirtyRects() or ZB_copyDirtyFrameBuffer*()
+ * to rects. Returns how many there are.
+ */
+GLint ZB_getDirtyRects(ZBuffer *zb, ZBRect *rects, GLint max_rects);
+void ZB_clearDirtyRects(ZBuffer *zb);
+/* Like ZB_copyFrameBuffer() and ZB_copyFrameBufferARGB32(), but only the changed rectangles, which are then forgotten. */
+void ZB_copyDirtyFrameBuffer(ZBuffer *zb, void *buf, GLint linesize);
+GLint ZB_copyDirtyFrameBufferARGB32(ZBuffer *zb, void *buf, GLuint bufSize);
+#else
+#define ZB_addDirtyRect(zb, xmin, ymin, xmax, ymax) /* a comment */
+#endif
+
+/* zclear.c */
+
+#if TGL_FEATURE_FAST_CLEAR == 1
+void ZB_fastClearOpen(ZBuffer *zb);
+void ZB_fastClearClose(ZBuffer *zb);
+void ZB_fastClear(ZBuffer *zb, GLint clear_z, GLushort z, GLint clear_color, GLuint pixel);
+/*
+ * With enable set, ZB_clear() only records what to clear, and each tile is cleared when something is first drawn
+ * in it. zb->pbuf then only holds the whole frame after ZB_resolveClear(zb, 0, 1), the ZB_copy*FrameBuffer*()
+ * functions take care of it.
+ */
+void ZB_setFastClear(ZBuffer *zb, GLint enable);
+/* Clears the tiles of the zbuffer and/or the framebuffer which are still pending. */
+void ZB_resolveClear(ZBuffer *zb, GLint clear_z, GLint clear_color);
+/*
+ * Called with the rectangle (xmax and ymax exclusive) a primitive is about to draw in: clears its pending tiles and
+ * marks it dirty.
+ */
+void ZB_touchRect(ZBuffer *zb, GLint xmin, GLint ymin, GLint xmax, GLint ymax);
+#if TGL_FEATURE_RENDER_BITS == 1
+/* Copies the bytes covering pixels xmin..xmax-1 of rows ymin..ymax-1, pending tiles as the clear value. */
+void ZB_copy1BRows(ZBuffer *zb, void *buf, GLint linesize, GLint xmin, GLint ymin, GLint xmax, GLint ymax);
+#endif
+#else
+#define ZB_resolveClear(zb, clear_z, clear_color) /* a comment */
+#define ZB_touchRect(zb, xmin, ymin, xmax, ymax) ZB_addDirtyRect(zb, xmin, ymin, xmax, ymax)
+#endif
+
+#if TGL_FEATURE_FAST_CLEAR == 1 || TGL_FEATURE_DIRTY_RECTS == 1
+/* ZB_touchRect() with the pixels a triangle can be drawn in. */
+void ZB_touchTriangle(ZBuffer *zb, ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2);
+#else
+#define ZB_touchTriangle(zb, p0, p1, p2) /* a comment */
+#endif
+
+/* zband.c */
+
+#if TGL_FEATURE_BAND_RASTER == 1
+/* Called with every band once it is drawn. pbuf holds its rows y..y+height-1, linesize bytes apart. */
+typedef void (*ZB_presentBandFunc)(ZBuffer *zb, void *pbuf, GLint y, GLint height, void *user);
+/*
+ * Like ZB_open(), but zbuf and pbuf only hold band_height rows. The frame is drawn band by band on
+ * ZB_renderBands(), before a clear that follows drawing or before a texture it samples is changed or deleted, and
+ * passed to present.
+ * glDrawPixels(), glPostProcess(), glCopyTexImage2D() and the ZB_copy*FrameBuffer*() functions, which need the
+ * whole frame, aren't available.
+ */
+ZBuffer *ZB_openBanded(GLint xsize, GLint ysize, GLint mode, GLint band_height, ZB_presentBandFunc present, void *user);
+GLint ZB_bandHeight(GLint band_height, GLint ysize);
+GLint ZB_bandOpen(ZBuffer *zb, GLint band_height, ZB_presentBandFunc present, void *user);
+void ZB_bandClose(ZBuffer *zb);
+/* Draws the recorded frame and makes room for ysize rows of bands. Returns the band height. */
+GLint ZB_bandResize(ZBuffer *zb, GLint ysize);
+/* Draws the recorded primitives one band at a time. */
+void ZB_renderBands(ZBuffer *zb);
+void ZB_bandTriangle(ZBuffer *zb, ZB_fillTriangleFunc fill, ZBufferPoint *p0, ZBufferPoint *p1, ZBufferPoint *p2);
+void ZB_bandLine(ZBuffer *zb, GLint depth, ZBufferPoint *p1, ZBufferPoint *p2);
+void ZB_bandPoint(ZBuffer *zb, ZBufferPoint *p);
+void ZB_bandPixel(ZBuffer *zb, GLint x, GLint y, PIXEL pix);
+void ZB_bandClear(ZBuffer *zb, GLint clear_z, GLint z, GLint clear_color, GLuint color);
+/* Warns and returns 1 if zb is banded, for what needs the whole frame. */
+GLint ZB_bandUnsupported(ZBuffer *zb, const char *what);
+#define ZB_BANDED(zb) ((zb)->bands != NULL)
+#else
+#define ZB_renderBands(zb) /* a comment */
+#define ZB_bandUnsupported(zb, what) 0
+#define ZB_BANDED(zb) 0
+#endif
 
 /* memory.c */
 #if TGL_FEATURE_CUSTOM_MALLOC == 1
@@ -0,0 +1,191 @@
+/*
+ * Fast (lazy) clears.
+ * After ZB_setFastClear(zb, 1), ZB_clear() doesn't write the zbuffer or the framebuffer. It records the clear values
+ * and starts a new clear epoch. Every TGL_FAST_CLEAR_TILE x TGL_FAST_CLEAR_TILE tile remembers the epoch it was last
+ * cleared in, and a tile of an older epoch is cleared when something is first drawn in it (ZB_touchRect).
+ * Tiles of the zbuffer nothing is drawn in are never written. Tiles of the framebuffer are cleared by
+ * ZB_resolveClear() before it is read, except by the 1 bit framebuffer copies, which write the clear value
+ * straight to the destination.
+ */
+#include <string.h>
+#include "zbuffer.h"
+#include "msghandling.h"
+
+#if TGL_FEATURE_FAST_CLEAR == 1
+
+#define FAST_CLEAR_TILE (1 << TGL_FAST_CLEAR_TILE_POW2)
+
+void ZB_fastClearOpen(ZBuffer* zb) {
+	GLint n;
+	zb->fast_xsize = (zb->xsize + FAST_CLEAR_TILE - 1) >> TGL_FAST_CLEAR_TILE_POW2;
+	zb->fast_ysize = (zb->ysize + FAST_CLEAR_TILE - 1) >> TGL_FAST_CLEAR_TILE_POW2;
+	n = zb->fast_xsize * zb->fast_ysize;
+	zb->fast_z_epochs = gl_malloc(n);
+	zb->fast_color_epochs = gl_malloc(n);
+	if (zb->fast_z_epochs == NULL || zb->fast_color_epochs == NULL) {
+		tgl_warning("\nTinyGL: Not enough memory for the fast clear tiles, clears are done immediately.");
+		ZB_fastClearClose(zb);
+		zb->fast_clear = 0;
+		return;
+	}
+	/* nothing is pending */
+	memset(zb->fast_z_epochs, 0, n);
+	memset(zb->fast_color_epochs, 0, n);
+	zb->fast_z_epoch = 0;
+	zb->fast_color_epoch = 0;
+	zb->fast_pending = 0;
+}
+
+void ZB_fastClearClose(ZBuffer* zb) {
+	if (zb->fast_z_epochs)
+		gl_free(zb->fast_z_epochs);
+	if (zb->fast_color_epochs)
+		gl_free(zb->fast_color_epochs);
+	zb->fast_z_epochs = NULL;
+	zb->fast_color_epochs = NULL;
+}
+
+/* Starts a new epoch, in which every tile is pending. Returns the new epoch. */
+static GLubyte gl_next_epoch(ZBuffer* zb, GLubyte epoch, GLubyte* epochs) {
+	if (++epoch == 0) {
+		/* wrapped around, tiles last cleared 256 epochs ago would look up to date */
+		memset(epochs, 0, zb->fast_xsize * zb->fast_ysize);
+		epoch = 1;
+	}
+	return epoch;
+}
+
+void ZB_fastClear(ZBuffer* zb, GLint clear_z, GLushort z, GLint clear_color, GLuint pixel) {
+	if (clear_z) {
+		zb->fast_z = z;
+		zb->fast_z_epoch = gl_next_epoch(zb, zb->fast_z_epoch, zb->fast_z_epochs);
+	}
+	if (clear_color) {
+		zb->fast_color = pixel;
+		zb->fast_color_epoch = gl_next_epoch(zb, zb->fast_color_epoch, zb->fast_color_epochs);
+	}
+	zb->fast_pending = 1;
+}
+
+/* Clears the tile tx, ty of the zbuffer and/or the framebuffer if it is pending. */
+static void gl_clear_tile(ZBuffer* zb, GLint tx, GLint ty, GLint clear_z, GLint clear_color) {
+	GLint i = ty * zb->fast_xsize + tx;
+	GLint x0 = tx << TGL_FAST_CLEAR_TILE_POW2, y0 = ty << TGL_FAST_CLEAR_TILE_POW2;
+	GLint w = FAST_CLEAR_TILE, h = FAST_CLEAR_TILE, x, y;
+	if (x0 + w > zb->xsize)
+		w = zb->xsize - x0;
+	if (y0 + h > zb->ysize)
+		h = zb->ysize - y0;
+	if (clear_z && zb->fast_z_epochs[i] != zb->fast_z_epoch) {
+		GLushort* pz = zb->zbuf + y0 * zb->xsize + x0;
+		GLushort z = zb->fast_z;
+		/* rows of whole tiles have a constant length, which lets the compiler unroll them */
+		if (w == FAST_CLEAR_TILE) {
+			for (y = 0; y < h; y++, pz += zb->xsize)
+				for (x = 0; x < FAST_CLEAR_TILE; x++)
+					pz[x] = z;
+		} else {
+			for (y = 0; y < h; y++, pz += zb->xsize)
+				for (x = 0; x < w; x++)
+					pz[x] = z;
+		}
+		zb->fast_z_epochs[i] = zb->fast_z_epoch;
+	}
+	if (clear_color && zb->fast_color_epochs[i] != zb->fast_color_epoch) {
+#if TGL_FEATURE_RENDER_BITS == 1
+		/* tiles are whole bytes of 8 pixels */
+		GLubyte* pp = zb->pbuf + (y0 * zb->xsize + x0) / 8;
+		for (y = 0; y < h; y++, pp += zb->linesize)
+			memset(pp, zb->fast_color, w / 8);
+#else
+		PIXEL* pp = (PIXEL*)((GLbyte*)zb->pbuf + y0 * zb->linesize) + x0;
+		PIXEL color = zb->fast_color;
+		if (w == FAST_CLEAR_TILE) {
+			for (y = 0; y < h; y++, pp = (PIXEL*)((GLbyte*)pp + zb->linesize))
+				for (x = 0; x < FAST_CLEAR_TILE; x++)
+					pp[x] = color;
+		} else {
+			for (y = 0; y < h; y++, pp = (PIXEL*)((GLbyte*)pp + zb->linesize))
+				for (x = 0; x < w; x++)
+					pp[x] = color;
+		}
+#endif
+		zb->fast_color_epochs[i] = zb->fast_color_epoch;
+	}
+}
+
+void ZB_touchRect(ZBuffer* zb, GLint xmin, GLint ymin, GLint xmax, GLint ymax) {
+	GLint tx, ty, tx0, tx1, ty1;
+	ZB_addDirtyRect(zb, xmin, ymin, xmax, ymax);
+	if (!zb->fast_pending)
+		return;
+	if (xmin < 0)
+		xmin = 0;
+	if (ymin < 0)
+		ymin = 0;
+	if (xmax > zb->xsize)
+		xmax = zb->xsize;
+	if (ymax > zb->ysize)
+		ymax = zb->ysize;
+	if (xmin >= xmax || ymin >= ymax)
+		return;
+	tx0 = xmin >> TGL_FAST_CLEAR_TILE_POW2;
+	tx1 = (xmax - 1) >> TGL_FAST_CLEAR_TILE_POW2;
+	ty1 = (ymax - 1) >> TGL_FAST_CLEAR_TILE_POW2;
+	for (ty = ymin >> TGL_FAST_CLEAR_TILE_POW2; ty <= ty1; ty++) {
+		GLubyte* ze = zb->fast_z_epochs + ty * zb->fast_xsize;
+		GLubyte* ce = zb->fast_color_epochs + ty * zb->fast_xsize;
+		for (tx = tx0; tx <= tx1; tx++)
+			if (ze[tx] != zb->fast_z_epoch || ce[tx] != zb->fast_color_epoch)
+				gl_clear_tile(zb, tx, ty, 1, 1);
+	}
+}
+
+void ZB_resolveClear(ZBuffer* zb, GLint clear_z, GLint clear_color) {
+	GLint tx, ty;
+	if (!zb->fast_pending)
+		return;
+	for (ty = 0; ty < zb->fast_ysize; ty++)
+		for (tx = 0; tx < zb->fast_xsize; tx++)
+			gl_clear_tile(zb, tx, ty, clear_z, clear_color);
+	if (clear_z && clear_color)
+		zb->fast_pending = 0;
+}
+
+void ZB_setFastClear(ZBuffer* zb, GLint enable) {
+	ZB_flushTiles(zb);
+	if (!enable)
+		ZB_resolveClear(zb, 1, 1);
+	zb->fast_clear = enable && zb->fast_z_epochs != NULL && !ZB_BANDED(zb);
+}
+
+#if TGL_FEATURE_RENDER_BITS == 1
+void ZB_copy1BRows(ZBuffer* zb, void* buf, GLint linesize, GLint xmin, GLint ymin, GLint xmax, GLint ymax) {
+	GLint x, y, x0 = xmin >> 3, x1 = (xmax + 7) >> 3;
+	for (y = ymin; y < ymax; y++) {
+		GLubyte* src = zb->pbuf + y * zb->linesize;
+		GLubyte* dst = (GLubyte*)buf + y * linesize;
+		GLubyte* epochs = zb->fast_color_epochs + (y >> TGL_FAST_CLEAR_TILE_POW2) * zb->fast_xsize;
+		if (!zb->fast_pending) {
+			memcpy(dst + x0, src + x0, x1 - x0);
+			continue;
+		}
+		/* runs of pending and of up to date tiles, FAST_CLEAR_TILE / 8 bytes each */
+		for (x = x0; x < x1;) {
+			GLint pending = epochs[x >> (TGL_FAST_CLEAR_TILE_POW2 - 3)] != zb->fast_color_epoch;
+			GLint end = x;
+			while (end < x1 && (epochs[end >> (TGL_FAST_CLEAR_TILE_POW2 - 3)] != zb->fast_color_epoch) == pending)
+				end = ((end >> (TGL_FAST_CLEAR_TILE_POW2 - 3)) + 1) << (TGL_FAST_CLEAR_TILE_POW2 - 3);
+			if (end > x1)
+				end = x1;
+			if (pending)
+				memset(dst + x, zb->fast_color, end - x);
+			else
+				memcpy(dst + x, src + x, end - x);
+			x = end;
+		}
+	}
+}
+#endif
+
+#endif
@@ -0,0 +1,244 @@
+/*
+ * Dirty rectangle tracking.
+ * Everything that writes to the framebuffer marks the TGL_DIRTY_TILE x TGL_DIRTY_TILE tiles it touched, so that
+ * a display which keeps its own copy of the frame only needs the changed regions (ZB_copyDirtyFrameBuffer).
+ * Marking is a few byte writes per primitive. The tiles are turned into at most TGL_DIRTY_RECTS_MAX
+ * rectangles only when they are queried or copied.
+ *
+ * Every tile has two flags. DIRTY_CHANGED is set until the tile is copied. DIRTY_DRAWN is set until the
+ * next color clear: clearing changes every pixel that isn't already the clear color, and only the tiles drawn
+ * since the previous clear can differ from it. So a clear with the same color only dirties those, any other
+ * clear dirties the whole frame.
+ */
+#include <string.h>
+#include "zbuffer.h"
+#include "msghandling.h"
+
+#if TGL_FEATURE_DIRTY_RECTS == 1
+
+#define DIRTY_TILE (1 << TGL_DIRTY_TILE_POW2)
+#define DIRTY_CHANGED 1
+#define DIRTY_DRAWN 2
+
+static GLint gl_rect_area(const ZBRect* r) { return (r->xmax - r->xmin) * (r->ymax - r->ymin); }
+
+static void gl_rect_merge(ZBRect* a, const ZBRect* b) {
+	if (b->xmin < a->xmin)
+		a->xmin = b->xmin;
+	if (b->ymin < a->ymin)
+		a->ymin = b->ymin;
+	if (b->xmax > a->xmax)
+		a->xmax = b->xmax;
+	if (b->ymax > a->ymax)
+		a->ymax = b->ymax;
+}
+
+/* The area of the bounding box of a and b. */
+static GLint gl_rect_union_area(const ZBRect* a, const ZBRect* b) {
+	ZBRect u = *a;
+	gl_rect_merge(&u, b);
+	return gl_rect_area(&u);
+}
+
+/*
+ * Adds r to a list of rectangles. Rectangles whose bounding box with r is no larger than the two of them
+ * are merged into r. When the list is full, r is merged with the rectangle it grows the least.
+ */
+static void gl_rect_list_add(ZBRect* rects, GLint* count, ZBRect r) {
+	GLint i;
+	for (;;) {
+		GLint merged = 0;
+		for (i = 0; i < *count; i++) {
+			if (gl_rect_union_area(&rects[i], &r) <= gl_rect_area(&rects[i]) + gl_rect_area(&r)) {
+				gl_rect_merge(&r, &rects[i]);
+				rects[i--] = rects[--*count];
+				merged = 1;
+			}
+		}
+		if (*count < TGL_DIRTY_RECTS_MAX) {
+			rects[(*count)++] = r;
+			return;
+		}
+		if (!merged) {
+			GLint best = 0, best_growth = 0x7fffffff;
+			for (i = 0; i < *count; i++) {
+				GLint growth = gl_rect_union_area(&rects[i], &r) - gl_rect_area(&rects[i]);
+				if (growth < best_growth) {
+					best_growth = growth;
+					best = i;
+				}
+			}
+			gl_rect_merge(&r, &rects[best]);
+			rects[best] = rects[--*count];
+		}
+		/* the grown r may now overlap other rectangles */
+	}
+}
+
+void ZB_dirtyOpen(ZBuffer* zb) {
+	zb->dirty_xsize = (zb->xsize + DIRTY_TILE - 1) >> TGL_DIRTY_TILE_POW2;
+	zb->dirty_ysize = (zb->ysize + DIRTY_TILE - 1) >> TGL_DIRTY_TILE_POW2;
+	zb->dirty_tiles = gl_malloc(zb->dirty_xsize * zb->dirty_ysize);
+	if (zb->dirty_tiles == NULL) {
+		tgl_warning("\nTinyGL: Not enough memory for the dirty tiles, the whole frame is always dirty.");
+		return;
+	}
+	/* the content of the framebuffer is unknown */
+	memset(zb->dirty_tiles, DIRTY_CHANGED, zb->dirty_xsize * zb->dirty_ysize);
+	zb->clear_valid = 0;
+}
+
+void ZB_dirtyClose(ZBuffer* zb) {
+	if (zb->dirty_tiles)
+		gl_free(zb->dirty_tiles);
+	zb->dirty_tiles = NULL;
+}
+
+void ZB_addDirtyRect(ZBuffer* zb, GLint xmin, GLint ymin, GLint xmax, GLint ymax) {
+	GLint tx, ty;
+	GLubyte* row;
+	if (zb->dirty_tiles == NULL)
+		return;
+	if (xmin < 0)
+		xmin = 0;
+	if (ymin < 0)
+		ymin = 0;
+	if (xmax > zb->xsize)
+		xmax = zb->xsize;
+	if (ymax > zb->ysize)
+		ymax = zb->ysize;
+	if (xmin >= xmax || ymin >= ymax)
+		return;
+	row = zb->dirty_tiles + (ymin >> TGL_DIRTY_TILE_POW2) * zb->dirty_xsize;
+	for (ty = ymin >> TGL_DIRTY_TILE_POW2; ty <= ((ymax - 1) >> TGL_DIRTY_TILE_POW2); ty++, row += zb->dirty_xsize)
+		for (tx = xmin >> TGL_DIRTY_TILE_POW2; tx <= ((xmax - 1) >> TGL_DIRTY_TILE_POW2); tx++)
+			row[tx] = DIRTY_CHANGED | DIRTY_DRAWN;
+}
+
+void ZB_dirtyClear(ZBuffer* zb, GLuint pixel) {
+	GLint i, n = zb->dirty_xsize * zb->dirty_ysize;
+	if (zb->dirty_tiles == NULL)
+		return;
+	if (zb->clear_valid && zb->clear_pixel == pixel) {
+		for (i = 0; i < n; i++)
+			if (zb->dirty_tiles[i] & DIRTY_DRAWN)
+				zb->dirty_tiles[i] = DIRTY_CHANGED;
+	} else {
+		memset(zb->dirty_tiles, DIRTY_CHANGED, n);
+	}
+	zb->clear_valid = 1;
+	zb->clear_pixel = pixel;
+}
+
+GLint ZB_getDirtyRects(ZBuffer* zb, ZBRect* rects, GLint max_rects) {
+	ZBRect list[TGL_DIRTY_RECTS_MAX];
+	GLint count = 0, tx, ty;
+	if (zb->dirty_tiles == NULL) {
+		list[0].xmin = 0;
+		list[0].ymin = 0;
+		list[0].xmax = zb->xsize;
+		list[0].ymax = zb->ysize;
+		count = 1;
+	} else {
+		/* every run of changed tiles in a row, merged with the runs around it */
+		for (ty = 0; ty < zb->dirty_ysize; ty++) {
+			GLubyte* row = zb->dirty_tiles + ty * zb->dirty_xsize;
+			for (tx = 0; tx < zb->dirty_xsize; tx++) {
+				ZBRect r;
+				if (!(row[tx] & DIRTY_CHANGED))
+					continue;
+				r.xmin = tx << TGL_DIRTY_TILE_POW2;
+				r.ymin = ty << TGL_DIRTY_TILE_POW2;
+				while (tx < zb->dirty_xsize && (row[tx] & DIRTY_CHANGED))
+					tx++;
+				r.xmax = (tx << TGL_DIRTY_TILE_POW2 < zb->xsize) ? tx << TGL_DIRTY_TILE_POW2 : zb->xsize;
+				r.ymax = ((ty + 1) << TGL_DIRTY_TILE_POW2 < zb->ysize) ? (ty + 1) << TGL_DIRTY_TILE_POW2 : zb->ysize;
+				gl_rect_list_add(list, &count, r);
+			}
+		}
+	}
+	if (max_rects > count)
+		max_rects = count;
+	if (max_rects > 0)
+		memcpy(rects, list, max_rects * sizeof(ZBRect));
+	return count;
+}
+
+void ZB_clearDirtyRects(ZBuffer* zb) {
+	GLint i, n = zb->dirty_xsize * zb->dirty_ysize;
+	if (zb->dirty_tiles == NULL)
+		return;
+	for (i = 0; i < n; i++)
+		zb->dirty_tiles[i] &= ~DIRTY_CHANGED;
+}
+
+void ZB_copyDirtyFrameBuffer(ZBuffer* zb, void* buf, GLint linesize) {
+	ZBRect rects[TGL_DIRTY_RECTS_MAX];
+	GLint i, count;
+	if (ZB_bandUnsupported(zb, "ZB_copyDirtyFrameBuffer()"))
+		return;
+	ZB_flushTiles(zb);
+#if TGL_FEATURE_RENDER_BITS != 1
+	ZB_resolveClear(zb, 0, 1);
+#endif
+	count = ZB_getDirtyRects(zb, rects, TGL_DIRTY_RECTS_MAX);
+	for (i = 0; i < count; i++) {
+		ZBRect* r = &rects[i];
+#if TGL_FEATURE_RENDER_BITS == 1 && TGL_FEATURE_FAST_CLEAR == 1
+		ZB_copy1BRows(zb, buf, linesize, r->xmin, r->ymin, r->xmax, r->ymax);
+#elif TGL_FEATURE_RENDER_BITS == 1
+		/* whole bytes of 8 pixels */
+		GLint x0 = r->xmin >> 3, n = ((r->xmax + 7) >> 3) - x0, y;
+		for (y = r->ymin; y < r->ymax; y++)
+			memcpy((GLubyte*)buf + y * linesize + x0, (GLubyte*)zb->pbuf + y * zb->linesize + x0, n);
+#else
+		GLint y;
+		for (y = r->ymin; y < r->ymax; y++) {
+			PIXEL* q = zb->pbuf + y * zb->xsize + r->xmin;
+			PIXEL* p1 = (PIXEL*)((GLubyte*)buf + y * linesize) + r->xmin;
+#if TGL_FEATURE_NO_COPY_COLOR == 1
+			GLint x;
+			for (x = 0; x < r->xmax - r->xmin; x++) {
+				if ((q[x] & TGL_COLOR_MASK) != TGL_NO_COPY_COLOR)
+					p1[x] = q[x];
+			}
+#else
+			memcpy(p1, q, (r->xmax - r->xmin) * PSZB);
+#endif
+		}
+#endif
+	}
+	ZB_clearDirtyRects(zb);
+}
+
+GLint ZB_copyDirtyFrameBufferARGB32(ZBuffer* zb, void* buf, GLuint bufSize) {
+	ZBRect rects[TGL_DIRTY_RECTS_MAX];
+	GLint i, y, count;
+	if (bufSize < (GLuint)(zb->xsize * zb->ysize * 4) || ZB_bandUnsupported(zb, "ZB_copyDirtyFrameBufferARGB32()"))
+		return 0;
+	ZB_flushTiles(zb);
+	ZB_resolveClear(zb, 0, 1);
+	count = ZB_getDirtyRects(zb, rects, TGL_DIRTY_RECTS_MAX);
+	for (i = 0; i < count; i++) {
+		ZBRect* r = &rects[i];
+		for (y = r->ymin; y < r->ymax; y++) {
+#if TGL_FEATURE_RENDER_BITS == 1
+			GLubyte* p = (GLubyte*)buf + (y * zb->xsize + r->xmin) * 4;
+			GLint x;
+			for (x = r->xmin; x < r->xmax; x++, p += 4) {
+				GLbyte val = (zb->pbuf[y * zb->linesize + x / 8] >> (x % 8)) & 1;
+				p[3] = 0xff;
+				p[2] = val ? 0xff : 0x00;
+				p[1] = val ? 0xbf : 0x00;
+				p[0] = 0x00;
+			}
+#elif TGL_FEATURE_RENDER_BITS == 32
+			memcpy((GLubyte*)buf + (y * zb->xsize + r->xmin) * 4, zb->pbuf + y * zb->xsize + r->xmin, (r->xmax - r->xmin) * 4);
+#endif
+		}
+	}
+	ZB_clearDirtyRects(zb);
+	return 1;
+}
+
+#endif
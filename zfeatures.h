@@ -46,10 +46,41 @@ the maximum number of vertices in a polygon is defined in zgl.h
 #define TGL_FEATURE_BLEND 			1
 
 #define TGL_FEATURE_BLEND_DRAW_PIXELS 0
-/*The width of textures as a power of 2. The default is 8, or 256x256 textures.*/
+/*
+Compile a copy of the triangle fill functions for every combination of depth test, depth write and stipple
+state (1), and also of blend equation and factors (2), so that none of them are tested per pixel.
+Triangles are drawn with the copy for the current state. 2 makes the blending fills 27 times bigger, over 2 MB
+of code, so it is only worth it where blending is used a lot and code size doesn't matter.
+*/
+#define TGL_FEATURE_SPECIALIZED_FILLS 1
+/*
+The largest width and height of textures as a power of 2. The default is 8, or 256x256 textures. Textures are stored
+at their own size, images larger than this or whose sizes aren't powers of 2 are resized on upload. In 1 bit mode
+texels are 8 bit luminance, scaled by the lighting and dithered like the shaded fills.
+*/
 #define TGL_FEATURE_TEXTURE_POW2	8
 #define TGL_FEATURE_TEXTURE_DIM		(1<<TGL_FEATURE_TEXTURE_POW2)
 
+/*
+Make a mip chain of half sized images down to 1x1 when a texture's image is specified, and draw each textured triangle
+with the level nearest to one texel per pixel. A third more texture memory, far away textures read less of it.
+*/
+#define TGL_FEATURE_MIPMAPS        1
+
+/*
+Textures stored in 4x4 texel tiles, so spans that don't run along a texture's rows, on rotated or steep triangles,
+read texels that share cache lines. The layout of a texture is chosen when its image is specified, with tiles while
+glSetTextureTiles(1) is in effect, or rows. Sampling takes two more shifts and masks per texel.
+*/
+#define TGL_FEATURE_TEXTURE_TILES  1
+
+/*
+Palettized textures, glTexImage2D() with GL_COLOR_INDEX8_EXT or GL_COLOR_INDEX4_EXT and a palette from
+glColorTableEXT(). The images keep 8 or 4 bit indices, a half to an eighth of the memory of PIXEL textures, which the
+fills look up in the palette per texel. Adds a copy of each textured fill for them.
+*/
+#define TGL_FEATURE_INDEXED_TEXTURES 1
+
 /*A stipple pattern is 128 bytes in size.*/
 #define TGL_POLYGON_STIPPLE_BYTES 128
 /*A stipple pattern is 2^5 (32) bits wide.*/
@@ -57,8 +88,13 @@ the maximum number of vertices in a polygon is defined in zgl.h
 #define TGL_POLYGON_STIPPLE_MASK_X 31
 #define TGL_POLYGON_STIPPLE_MASK_Y 31
 
-/*Use lookup tables for calculating specular light.*/
+/*Use lookup tables for calculating specular light, up to 32 per context, made as shininess values are used.*/
 #define TGL_FEATURE_SPECULAR_BUFFERS 0
+/*
+Use a lookup table for the falloff of every spot light with a spot exponent, from the cosine of its cutoff to 1,
+instead of pow() per vertex. Costs about 1KB per such light.
+*/
+#define TGL_FEATURE_SPOT_BUFFERS 1
 
 /*Prevent ZB_copyFrameBuffer from copying certain colors.*/
 #define TGL_FEATURE_NO_COPY_COLOR 0
@@ -81,6 +117,109 @@ the maximum number of vertices in a polygon is defined in zgl.h
 
 #define TGL_FEATURE_MULTITHREADED_ZB_COPYBUFFER 0
 
+/*
+Tile-binned triangle rasterization. When ZB_setRasterMode(zb, ZB_RASTER_TILED) is used, triangles are
+binned into screen tiles and rasterized on glFlush()/glFinish() or before anything else touches the framebuffer.
+Tiles are rasterized in parallel with OpenMP, if it is available.
+The result is identical to the immediate mode rasterizer.
+*/
+#define TGL_FEATURE_TILED_RASTER 1
+/*Tiles are 2^6 (64) pixels wide and tall. Must be at least 3 so that tiles never share a byte in 1 bit mode.*/
+#define TGL_RASTER_TILE_POW2 6
+
+/*
+Guard-band clipping. Triangles which only cross the left/right/top/bottom clip planes, and lie within
+TGL_GUARD_BAND pixels of the viewport, are not split by the polygon clipper, the rasterizer scissors them
+to the viewport instead. The band can be changed at runtime with glSetGuardBand().
+*/
+#define TGL_FEATURE_GUARD_BAND 1
+#define TGL_GUARD_BAND 1024
+/*The largest guard band, which keeps the rasterizer's fixed point edge and area computations from overflowing.*/
+#define TGL_GUARD_BAND_MAX 8192
+
+/*
+Half-space (edge function) triangle rasterizer, selected at runtime with ZB_setRasterBackend(zb, ZB_BACKEND_HALFSPACE).
+Walks triangles in 8x8 blocks, using SSE2 or NEON for the edge tests when the compiler targets them.
+Not pixel-identical to the scanline rasterizer, interpolation is done with plane equations.
+*/
+#define TGL_FEATURE_HALFSPACE_RASTER 1
+
+/*
+Hierarchical Z. Keeps a lower bound of the depth of every 8x8 block of the zbuffer, so that triangles, blocks
+of the half-space rasterizer and scanline spans which are entirely behind what's already drawn are skipped
+without reading the zbuffer. Costs 3 bytes per block.
+*/
+#define TGL_FEATURE_HIERARCHICAL_Z 1
+/*Blocks are 2^3 (8) pixels wide and tall.*/
+#define TGL_HIZ_TILE_POW2 3
+
+/*
+Dirty rectangle tracking. The regions of the framebuffer changed since the last copy can be queried with
+ZB_getDirtyRects() or copied alone with ZB_copyDirtyFrameBuffer(), for displays that are updated partially.
+*/
+#define TGL_FEATURE_DIRTY_RECTS 1
+/*Changes are tracked in tiles of 2^4 (16) pixels, costing 1 byte per tile.*/
+#define TGL_DIRTY_TILE_POW2 4
+/*The changed tiles are returned as at most this many rectangles.*/
+#define TGL_DIRTY_RECTS_MAX 16
+
+/*
+Fast clears. After ZB_setFastClear(zb, 1), glClear() doesn't write the zbuffer or the framebuffer, every tile is
+cleared when something is first drawn in it, and the zbuffer of tiles nothing is drawn in is never written.
+*/
+#define TGL_FEATURE_FAST_CLEAR 1
+/*
+Tiles are 2^4 (16) pixels wide and tall, costing 2 bytes per tile. Must be at least 3 so that tiles are whole bytes
+in 1 bit mode, and at least TGL_HIZ_TILE_POW2.
+*/
+#define TGL_FAST_CLEAR_TILE_POW2 4
+
+/*
+Band rendering. A zbuffer opened with ZB_openBanded() only holds a band of the screen's rows, which saves memory
+when the whole frame doesn't fit. Primitives are recorded per band and drawn on glFlush()/glFinish() or the next
+clear, one band at a time, every band being handed to a callback. Costs 132 bytes per primitive on 32 bit targets
+(136 on 64 bit hosts), plus 4 bytes for every band the primitive touches.
+*/
+#define TGL_FEATURE_BAND_RASTER 1
+
+/*
+Several contexts. glCreateContext() makes a context of its own for a zbuffer, which glMakeCurrent() makes current
+for the calling thread, so independent views can be rendered concurrently on different threads. Every gl call
+fetches the current context from thread-local storage, which costs a load on every call and, on bare metal
+targets, runtime support from the C library (__aeabi_read_tp on ARM), so it is off by default. glInit() and
+glClose() then drive the only context. Contexts sharing objects must be created and destroyed by one thread at a time.
+*/
+#define TGL_FEATURE_MULTI_CONTEXT 0
+
+/*
+Render thread. After glSetRenderThread(1), gl calls only queue their ops, which a thread of the context's own
+executes, so that the application can prepare the next frame while the previous one is rasterized. glFinish(),
+glFlush() and the calls which read the context wait until the queue is empty. Needs pthreads.
+*/
+#define TGL_FEATURE_RENDER_THREAD 0
+/*The queue holds 16384 GLParams, ops are 1 to 10 of them.*/
+#define TGL_RENDER_QUEUE_SIZE 16384
+
+/*
+Display list optimizer. glEndList() merges the list's matrix ops, transforms the primitives drawn under them ahead
+so that the matrix doesn't change between them, and drops state ops which don't change anything. Lists which rely
+on the modelview matrix being current when they are called keep their ops as compiled too, for the other modes.
+*/
+#define TGL_FEATURE_LIST_OPTIMIZER 1
+
+/*
+glDrawElements() transforms and lights an element once while it stays in a cache of 32 vertices, a power of two,
+which the element's index selects. Costs about 150 bytes per vertex in the context.
+*/
+#define TGL_VERTEX_CACHE_SIZE 32
+
+/*
+Vertex arrays and display list batches are transformed TGL_VERTEX_BLOCK vertices at a time, four per vector where
+the compiler targets SSE2 or NEON, and lit so too when every light is at infinity. A multiple of 4. Costs 84 bytes
+per vertex in the context.
+*/
+#define TGL_VERTEX_BLOCK 8
+
 /*
 !!!!!WARNING!!!!!
 TGL_FEATURE_ALIGNAS assumes that the implementation's malloc (AND REALLOC) are 16-byte aligned.
@@ -102,6 +241,18 @@ Optimization hint- cost of branching.
 #ifdef __TINYC__
 #undef TGL_FEATURE_ALIGNAS
 #define TGL_FEATURE_ALIGNAS 0
+#undef TGL_FEATURE_MULTI_CONTEXT
+#define TGL_FEATURE_MULTI_CONTEXT 0
+#endif
+
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+#if defined(_MSC_VER)
+#define TGL_THREAD_LOCAL __declspec(thread)
+#elif defined(__STDC_VERSION__) && __STDC_VERSION__ >= 201112L
+#define TGL_THREAD_LOCAL _Thread_local
+#else
+#define TGL_THREAD_LOCAL __thread
+#endif
 #endif
 
 
@@ -34,9 +34,13 @@ enum {
 #endif
 /* Max # of specular light pow buffers */
 #define MAX_SPECULAR_BUFFERS 32
+/* # of slots in the hash table of the specular buffers, a power of 2 larger than MAX_SPECULAR_BUFFERS */
+#define SPECULAR_HASH_SIZE 64
 
 /* # of entries in specular buffer */
 #define SPECULAR_BUFFER_SIZE 512
+/* # of entries in a spot light's falloff buffer */
+#define SPOT_BUFFER_SIZE 256
 /* specular buffer granularity */
 
 
@@ -44,7 +48,8 @@ enum {
 #define MAX_PROJECTION_STACK_DEPTH 8
 #define MAX_TEXTURE_STACK_DEPTH 8
 #define MAX_NAME_STACK_DEPTH 16
-#define MAX_TEXTURE_LEVELS 1
+#define MAX_TEXTURE_LEVELS ZB_TEXTURE_LEVELS
+#define MAX_PALETTE_SIZE 256
 #define MAX_LIGHTS 16
 
 #define VERTEX_ARRAY 0x0001
@@ -61,11 +66,18 @@ enum {
 
 typedef struct GLSpecBuf {
 	GLint shininess_i;
-	GLint last_used;
 	GLfloat buf[SPECULAR_BUFFER_SIZE + 1];
-	struct GLSpecBuf* next;
 } GLSpecBuf;
 
+/*
+The specular buffers of a context, found by shininess_i in an open addressing hash table. Each is allocated on the
+first use of its shininess, and freed with the context.
+*/
+typedef struct GLSpecBufCache {
+	GLSpecBuf* hash[SPECULAR_HASH_SIZE];
+	GLint n;
+} GLSpecBufCache;
+
 typedef struct GLLight {
 	V4 ambient;
 	V4 diffuse;
@@ -79,6 +91,10 @@ typedef struct GLLight {
 	GLfloat attenuation[3];
 	/* precomputed values */
 	GLfloat cos_spot_cutoff;
+#if TGL_FEATURE_SPOT_BUFFERS == 1
+	GLfloat* spot_buf; /* the falloff for the cosines from cos_spot_cutoff to 1 */
+	GLfloat spot_buf_scale;
+#endif
 
 	/* we use a linked list to know which are the enabled lights */
 	
@@ -86,6 +102,24 @@ typedef struct GLLight {
 	GLubyte enabled;
 } GLLight;
 
+/*
+ * An enabled light with the values gl_shade_vertex() would otherwise compute for every vertex: its colors times the
+ * material's and, for a light at infinity, the direction to it, the specular direction for a viewer at infinity
+ * and its inverse length (FISR) or length, and the spot factor. Rebuilt when the state in shade_dirty changes.
+ */
+typedef struct GLShadeLight {
+	GLLight* light;
+	V3 ambient, diffuse, specular;
+	GLint infinite;
+	V3 dir, half;
+	GLfloat half_norm;
+	GLfloat spot_att;
+	GLint spot_out; /* the spot cone leaves out every vertex */
+} GLShadeLight;
+
+#define SHADE_LIGHTS 0x1
+#define SHADE_MATERIAL 0x2
+
 typedef struct GLMaterial {
 	V4 emission;
 	V4 ambient;
@@ -102,6 +136,10 @@ typedef struct GLViewport {
 	V3 scale;
 	V3 trans;
 	GLint xmin, ymin, xsize, ysize;
+#if TGL_FEATURE_GUARD_BAND == 1
+	/* the guard band in clip coordinates, as a multiple of W */
+	GLfloat guard_x, guard_y;
+#endif
 	
 } GLViewport;
 
@@ -118,8 +156,28 @@ typedef struct GLParamBuffer {
 	struct GLParamBuffer* next;
 } GLParamBuffer;
 
+/*
+ * The vertices of a Begin/End block, which the list optimizer packs together. Every vertex is stride GLParams: a mask
+ * of the BATCH_* attributes which changed since the previous vertex, the coordinates, then the normal, color, texture
+ * coordinates and edge flag if any vertex of the block changes them, at the offsets given.
+ */
+#define BATCH_NORMAL 0x1
+#define BATCH_COLOR 0x2
+#define BATCH_TEX_COORD 0x4
+#define BATCH_EDGE_FLAG 0x8
+
+typedef struct GLBatch {
+	GLint type;
+	GLint n, stride;
+	GLint normal, color, tex_coord, edge_flag;
+	GLParam* vertices;
+} GLBatch;
+
 typedef struct GLList {
 	GLParamBuffer* first_op_buffer;
+	/* the ops as compiled, kept when the optimized ones need the modelview matrix to be current */
+	GLParamBuffer* compiled_op_buffer;
+	GLint compiled_ops, optimized_ops;
 	/* TODO: extensions for an hash table or a better allocating scheme */
 } GLList;
 
@@ -138,9 +196,33 @@ typedef struct GLVertex {
 	GLint edge_flag;
 } GLVertex;
 
+typedef struct GLVertexCacheEntry {
+	GLint index;
+	GLVertex v;
+} GLVertexCacheEntry;
+
+/* TGL_VERTEX_BLOCK vertices in structure of arrays form, for gl_vertex_transform_block() */
+typedef struct GLVertexBlock {
+	GLfloat x[TGL_VERTEX_BLOCK], y[TGL_VERTEX_BLOCK], z[TGL_VERTEX_BLOCK];
+	/* in object space, then in eye space */
+	GLfloat nx[TGL_VERTEX_BLOCK], ny[TGL_VERTEX_BLOCK], nz[TGL_VERTEX_BLOCK];
+	/* computed values, the eye coordinates with lighting only */
+	GLfloat ex[TGL_VERTEX_BLOCK], ey[TGL_VERTEX_BLOCK], ez[TGL_VERTEX_BLOCK], ew[TGL_VERTEX_BLOCK];
+	GLfloat px[TGL_VERTEX_BLOCK], py[TGL_VERTEX_BLOCK], pz[TGL_VERTEX_BLOCK], pw[TGL_VERTEX_BLOCK];
+	GLint clip_code[TGL_VERTEX_BLOCK], zx[TGL_VERTEX_BLOCK], zy[TGL_VERTEX_BLOCK], zz[TGL_VERTEX_BLOCK];
+	/* the colors, if gl_shade_block() lit the vertices */
+	GLfloat r[TGL_VERTEX_BLOCK], g[TGL_VERTEX_BLOCK], b[TGL_VERTEX_BLOCK], a;
+	GLint lit;
+} GLVertexBlock;
+
+/*
+An image of a texture, whose width and height are powers of 2, at most TGL_FEATURE_TEXTURE_DIM.
+The pixmap of an indexed texture holds its index_bits bit indices instead of PIXELs.
+*/
 typedef struct GLImage {
-	PIXEL pixmap[TGL_FEATURE_TEXTURE_DIM * TGL_FEATURE_TEXTURE_DIM];
+	PIXEL* pixmap; /* NULL until an image is specified */
 	GLint xsize, ysize;
+	GLint xsize_log2, ysize_log2;
 } GLImage;
 
 /* textures */
@@ -149,6 +231,13 @@ typedef struct GLImage {
 #define TEXTURE_HASH_TABLE_MASK 255
 typedef struct GLTexture {
 	GLImage images[MAX_TEXTURE_LEVELS];
+	GLint level_count; /* images[0] and its mip chain */
+	GLint tiled; /* the images are stored in 4x4 texel tiles */
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+	GLint index_bits; /* 8 or 4 for palettized images, 0 for PIXEL ones */
+	PIXEL* palette; /* from glColorTableEXT(), NULL until one is specified */
+	GLint palette_size;
+#endif
 	struct GLTexture *next, *prev;
 	GLint handle;
 } GLTexture;
@@ -165,6 +254,8 @@ typedef struct GLSharedState {
 	GLList** lists;
 	GLTexture** texture_hash_table;
 	GLBuffer** buffers;
+	/* how many contexts share the tables, not atomic: glCreateContext() and glDestroyContext() are serialized */
+	GLint* refcount;
 } GLSharedState;
 
 struct GLContext;
@@ -195,6 +286,11 @@ typedef struct GLContext {
 	GLSharedState shared_state;
 	ZBuffer* zb;
 	GLLight* first_light;
+	GLShadeLight shade_lights[MAX_LIGHTS];
+	GLint shade_light_n;
+	GLint shade_dirty;
+	V3 shade_base; /* emission + ambient times the light model's */
+	GLint shade_infinite; /* every light and the viewer are at infinity */
 	GLTexture* current_texture;
 	GLParamBuffer* current_op_buffer;
 	M4* matrix_stack[3];
@@ -227,9 +323,19 @@ typedef struct GLContext {
 
 	GLint texture_2d_enabled;
 
+#if TGL_FEATURE_GUARD_BAND == 1
+	/* in pixels, see gl_draw_triangle() */
+	GLint guard_band;
+#endif
+
+	/* triangle fill functions for the current state, see gl_draw_triangle_fill() */
+	ZB_fillTriangleFunc fill_funcs[ZB_FILL_KINDS];
+	GLint fill_funcs_dirty;
+
 	/* current list */
 
 	GLint current_op_buffer_index;
+	GLuint current_list;
 	GLint exec_flag, compile_flag, print_flag;
 	GLuint listbase;
 	/* matrix */
@@ -286,6 +392,10 @@ typedef struct GLContext {
 	GLint in_begin;
 	GLint begin_type;
 	GLint vertex_n, vertex_cnt;
+	/* glDrawElements() post-transform cache */
+	GLVertexCacheEntry vertex_cache[TGL_VERTEX_CACHE_SIZE];
+	/* vertices of vertex arrays and display list batches being transformed together */
+	GLVertexBlock vertex_block;
 
 	/* opengl 1.1 arrays  */
 
@@ -307,14 +417,12 @@ typedef struct GLContext {
 	/* opengl blending */
 	
 
-	/* specular buffer. could probably be shared between contexts,
-	  but that wouldn't be 100% thread safe */
+	/* specular buffer. one per context: the cache fills while rendering, which contexts may do concurrently */
 #if TGL_FEATURE_SPECULAR_BUFFERS == 1
-	GLSpecBuf* specbuf_first;
-	GLint specbuf_used_counter;
-	GLint specbuf_num_buffers;
+	GLSpecBufCache specbufs;
 #endif
 	GLint zEnableSpecular; 
+	GLint texture_tiles; /* glSetTextureTiles() */
 
 	/* raster position */
 	GLint rasterpos_zz;
@@ -332,20 +440,56 @@ typedef struct GLContext {
 #if TGL_FEATURE_ERROR_CHECK == 1
 	GLenum error_flag;
 #endif
+#if TGL_FEATURE_RENDER_THREAD == 1
+	/* ops are queued for the render thread (queue.c) */
+	struct GLRenderQueue* render_queue;
+#endif
 } GLContext;
 
 extern GLContext gl_ctx;
+#if TGL_FEATURE_MULTI_CONTEXT == 1
+/* the context made current by the calling thread, threads which didn't make one current use gl_ctx */
+extern TGL_THREAD_LOCAL GLContext* gl_current_ctx;
+static GLContext* gl_get_context(void) { return gl_current_ctx ? gl_current_ctx : &gl_ctx; }
+#else
 static GLContext* gl_get_context(void) { return &gl_ctx; }
+#endif
 
 extern void (*op_table_func[])(GLParam*);
 extern GLint op_table_size[];
 extern void gl_compile_op(GLParam* p);
+/* Frees the op buffers of l, its ops as compiled and its batches too, and l. */
+void gl_free_list(GLList* l);
+
+/* listopt.c */
+#if TGL_FEATURE_LIST_OPTIMIZER == 1
+void gl_optimize_list(GLList* l);
+void gl_free_list_batches(GLParamBuffer* pb);
+#endif
+
+/* queue.c */
+#if TGL_FEATURE_RENDER_THREAD == 1
+/* Queues p for the render thread. Returns 0 when it has to be executed right away. */
+GLint gl_render_queue_op(GLContext* c, GLParam* p);
+/* Waits until the render thread of the current context has executed everything queued. */
+void gl_render_sync(void);
+/* gl_render_sync(), if ops reading the client arrays were queued since the last one. */
+void gl_render_sync_arrays(void);
+#else
+#define gl_render_sync() /* a comment */
+#define gl_render_sync_arrays() /* a comment */
+#endif
+
 static void gl_add_op(GLParam* p) {
 	GLContext* c = gl_get_context();
 #if TGL_FEATURE_ERROR_CHECK == 1
 #include "error_check.h"
 #endif
 	GLint op;
+#if TGL_FEATURE_RENDER_THREAD == 1
+	if (c->render_queue != NULL && gl_render_queue_op(c, p))
+		return;
+#endif
 	op = p[0].op;
 	if (c->exec_flag) {
 		op_table_func[op](p);
@@ -419,6 +563,13 @@ void gl_draw_triangle_select(GLVertex* p0, GLVertex* p1, GLVertex* p2);
 void gl_draw_triangle_feedback(GLVertex* p0, GLVertex* p1, GLVertex* p2);
 /* matrix.c */
 void gl_print_matrix(const GLfloat* m);
+void gl_matrix_op(M4* m, GLParam* p);
+
+/* vertex.c */
+void gl_vertex_process(GLVertex* v);
+void gl_vertex_transform_block(GLVertexBlock* b, GLint n);
+void gl_vertex_from_block(GLVertex* v, GLVertexBlock* b, GLint k);
+void gl_vertex_assemble(void);
 /*
 void glopLoadIdentity(GLParam *p);
 void glopTranslate(GLParam *p);*/
@@ -426,23 +577,38 @@ void glopTranslate(GLParam *p);*/
 /* light.c */
 void gl_enable_disable_light(GLint light, GLint v);
 void gl_shade_vertex(GLVertex* v);
+void gl_shade_block(GLVertexBlock* b, GLint n);
 
 void glInitTextures();
 void glEndTextures();
 GLTexture* alloc_texture(GLint h);
+void gl_free_texture_images(GLTexture* t);
+/* Draws what the tile and band rasterizers hold, before a texture it may sample is changed or freed. */
+void gl_flush_texture_users(GLContext* c);
 
 /* image_util.c */
 void gl_convertRGB_to_5R6G5B(GLushort* pixmap, GLubyte* rgb, GLint xsize, GLint ysize);
 void gl_convertRGB_to_8A8R8G8B(GLuint* pixmap, GLubyte* rgb, GLint xsize, GLint ysize);
+void gl_convertRGB_to_L8(GLubyte* pixmap, GLubyte* rgb, GLint xsize, GLint ysize);
 void gl_resizeImage(GLubyte* dest, GLint xsize_dest, GLint ysize_dest, GLubyte* src, GLint xsize_src, GLint ysize_src);
 void gl_resizeImageNoInterpolate(GLubyte* dest, GLint xsize_dest, GLint ysize_dest, GLubyte* src, GLint xsize_src, GLint ysize_src);
+void gl_halveImage(PIXEL* dest, PIXEL* src, GLint xsize_log2_src, GLint ysize_log2_src);
+void gl_tileImage(PIXEL* dest, PIXEL* src, GLint xsize_log2, GLint ysize_log2);
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+void gl_packIndexImage(GLubyte* dest, GLint xsize_log2, GLint ysize_log2, GLubyte* src, GLint xsize_src, GLint ysize_src, GLint index_shift);
+void gl_halveIndexImage(GLubyte* dest, GLubyte* src, GLint xsize_log2_src, GLint ysize_log2_src, GLint index_shift);
+void gl_tileIndexImage(GLubyte* dest, GLubyte* src, GLint xsize_log2, GLint ysize_log2, GLint index_shift);
+#endif
 
 
 
 void gl_fatal_error(char* format, ...);
 
 /* specular buffer "api" */
-GLSpecBuf* specbuf_get_buffer(const GLint shininess_i, const GLfloat shininess);
+GLSpecBuf* specbuf_get_buffer(GLContext* c, const GLint shininess_i, const GLfloat shininess);
+#if TGL_FEATURE_SPOT_BUFFERS == 1
+void spotbuf_calc(GLLight* l);
+#endif
 
 
 
@@ -468,6 +634,13 @@ static void gl_eval_viewport() {
 	v->scale.X = (v->xsize - 0.5) / 2.0;
 	v->scale.Y = -(v->ysize - 0.5) / 2.0;
 	v->scale.Z = -((zsize - 0.5) / 2.0);
+
+	/* triangles are scissored to the viewport by the rasterizer */
+	ZB_setClipRect(c->zb, v->xmin, v->ymin, v->xmin + v->xsize, v->ymin + v->ysize);
+#if TGL_FEATURE_GUARD_BAND == 1
+	v->guard_x = 1 + c->guard_band / v->scale.X;
+	v->guard_y = 1 - c->guard_band / v->scale.Y;
+#endif
 }
 
 #endif /* _tgl_zgl_h_ */
@@ -0,0 +1,165 @@
+/*
+ * Hierarchical Z.
+ * For every HIZ_TILE x HIZ_TILE block of the zbuffer hiz_min holds a lower bound of its depth values.
+ * A fragment passes the depth test when its z is >= the stored z, so anything whose z is below
+ * the bound of every block it covers can't be visible, and is rejected without reading the zbuffer.
+ *
+ * The bound stays valid while depth tested writes only raise the depth values of a block, so they
+ * just set its dirty flag. ZB_hizOccluded() recomputes the bound of dirty blocks from the zbuffer
+ * when it needs a tighter one. Writes without a depth test may lower values, so they reset the bound to 0.
+ */
+#include <string.h>
+#include "zbuffer.h"
+#include "msghandling.h"
+
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+
+#define HIZ_TILE (1 << TGL_HIZ_TILE_POW2)
+#define HIZ_REFINE_AREA (16 * HIZ_TILE * HIZ_TILE)
+
+void ZB_hizOpen(ZBuffer* zb) {
+	GLint n;
+	zb->hiz_xsize = (zb->xsize + HIZ_TILE - 1) >> TGL_HIZ_TILE_POW2;
+	zb->hiz_ysize = (zb->ysize + HIZ_TILE - 1) >> TGL_HIZ_TILE_POW2;
+	n = zb->hiz_xsize * zb->hiz_ysize;
+	zb->hiz_min = gl_malloc(n * sizeof(GLushort));
+	zb->hiz_dirty = gl_malloc(n);
+	if (zb->hiz_min == NULL || zb->hiz_dirty == NULL) {
+		tgl_warning("\nTinyGL: Not enough memory for the hierarchical z buffer, disabling it.");
+		ZB_hizClose(zb);
+		return;
+	}
+	/* the zbuffer content is unknown */
+	memset(zb->hiz_min, 0, n * sizeof(GLushort));
+	memset(zb->hiz_dirty, 1, n);
+}
+
+void ZB_hizClose(ZBuffer* zb) {
+	if (zb->hiz_min)
+		gl_free(zb->hiz_min);
+	if (zb->hiz_dirty)
+		gl_free(zb->hiz_dirty);
+	zb->hiz_min = NULL;
+	zb->hiz_dirty = NULL;
+}
+
+void ZB_hizClear(ZBuffer* zb, GLushort z) {
+	GLint i, n = zb->hiz_xsize * zb->hiz_ysize;
+	if (zb->hiz_min == NULL)
+		return;
+	for (i = 0; i < n; i++)
+		zb->hiz_min[i] = z;
+	memset(zb->hiz_dirty, 0, n);
+}
+
+/* Forgets the bounds of the blocks touching the pixel rectangle x0,y0 - x1,y1 (inclusive). */
+void ZB_hizInvalidate(ZBuffer* zb, GLint x0, GLint y0, GLint x1, GLint y1) {
+	GLint tx, ty;
+	if (zb->hiz_min == NULL)
+		return;
+	if (x0 < 0) x0 = 0;
+	if (y0 < 0) y0 = 0;
+	if (x1 >= zb->xsize) x1 = zb->xsize - 1;
+	if (y1 >= zb->ysize) y1 = zb->ysize - 1;
+	if (x0 > x1 || y0 > y1)
+		return;
+	for (ty = y0 >> TGL_HIZ_TILE_POW2; ty <= (y1 >> TGL_HIZ_TILE_POW2); ty++)
+		for (tx = x0 >> TGL_HIZ_TILE_POW2; tx <= (x1 >> TGL_HIZ_TILE_POW2); tx++) {
+			zb->hiz_min[ty * zb->hiz_xsize + tx] = 0;
+			zb->hiz_dirty[ty * zb->hiz_xsize + tx] = 1;
+		}
+}
+
+/* Called by the rasterizers after writing the depth of the span x0..x1 of row y. */
+void ZB_hizSpanWritten(ZBuffer* zb, GLint x0, GLint x1, GLint y, GLint depth_test) {
+	GLint i = (y >> TGL_HIZ_TILE_POW2) * zb->hiz_xsize + (x0 >> TGL_HIZ_TILE_POW2);
+	GLint n = (x1 >> TGL_HIZ_TILE_POW2) - (x0 >> TGL_HIZ_TILE_POW2) + 1;
+	memset(zb->hiz_dirty + i, 1, n);
+	if (!depth_test)
+		memset(zb->hiz_min + i, 0, n * sizeof(GLushort));
+}
+
+static GLushort gl_hiz_recompute(ZBuffer* zb, GLint tx, GLint ty) {
+	GLint x0 = tx << TGL_HIZ_TILE_POW2, y0 = ty << TGL_HIZ_TILE_POW2;
+	GLint w = HIZ_TILE, h = HIZ_TILE, x, y;
+	GLushort m = 0xffff;
+	GLushort* pz;
+	if (x0 + w > zb->xsize)
+		w = zb->xsize - x0;
+	if (y0 + h > zb->ysize)
+		h = zb->ysize - y0;
+	pz = zb->zbuf + y0 * zb->xsize + x0;
+	for (y = 0; y < h; y++) {
+		for (x = 0; x < w; x++)
+			if (pz[x] < m)
+				m = pz[x];
+		pz += zb->xsize;
+	}
+	zb->hiz_min[ty * zb->hiz_xsize + tx] = m;
+	zb->hiz_dirty[ty * zb->hiz_xsize + tx] = 0;
+	return m;
+}
+
+/*
+ * Returns 1 when depth z (same scale as the zbuffer) fails the depth test everywhere in the pixel
+ * rectangle x0,y0 - x1,y1 (inclusive, already clipped to the zbuffer).
+ * With refine set the bounds of dirty blocks are recomputed when they alone can't reject z.
+ */
+GLint ZB_hizOccluded(ZBuffer* zb, GLint x0, GLint y0, GLint x1, GLint y1, GLuint z, GLint refine) {
+	GLint tx, ty;
+	for (ty = y0 >> TGL_HIZ_TILE_POW2; ty <= (y1 >> TGL_HIZ_TILE_POW2); ty++)
+		for (tx = x0 >> TGL_HIZ_TILE_POW2; tx <= (x1 >> TGL_HIZ_TILE_POW2); tx++) {
+			GLint i = ty * zb->hiz_xsize + tx;
+			if (z < zb->hiz_min[i])
+				continue;
+			if (!refine || !zb->hiz_dirty[i] || z >= gl_hiz_recompute(zb, tx, ty))
+				return 0;
+		}
+	return 1;
+}
+
+/*
+ * An upper bound of the depth (same scale as the zbuffer) the rasterizers can write for a triangle.
+ * Pixels at the edges may be one pixel outside of it, hence the gradients.
+ */
+GLuint ZB_hizTriangleDepth(ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2, GLint dzdx, GLint dzdy) {
+	GLuint z = p0->z, margin;
+	if ((GLuint)p1->z > z)
+		z = p1->z;
+	if ((GLuint)p2->z > z)
+		z = p2->z;
+	if (dzdx <= -(1 << 28) || dzdx >= (1 << 28) || dzdy <= -(1 << 28) || dzdy >= (1 << 28))
+		return 0xffffffff;
+	margin = ((dzdx < 0) ? -dzdx : dzdx) + ((dzdy < 0) ? -dzdy : dzdy);
+	return ((z + margin) >> ZB_POINT_Z_FRAC_BITS) + 1;
+}
+
+/* Returns 1 when a triangle with the depth bound z can't be visible anywhere in the clip rectangle. */
+GLint ZB_hizTriangleOccluded(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2, GLuint z) {
+	GLint xmin, xmax, ymin, ymax;
+	if (z > 0xffff)
+		return 0;
+	xmin = xmax = p0->x;
+	ymin = ymax = p0->y;
+	if (p1->x < xmin) xmin = p1->x;
+	if (p1->x > xmax) xmax = p1->x;
+	if (p2->x < xmin) xmin = p2->x;
+	if (p2->x > xmax) xmax = p2->x;
+	if (p1->y < ymin) ymin = p1->y;
+	if (p1->y > ymax) ymax = p1->y;
+	if (p2->y < ymin) ymin = p2->y;
+	if (p2->y > ymax) ymax = p2->y;
+	/* The scanline rasterizer may round a span one pixel past the bounding box. */
+	xmin--;
+	xmax++;
+	if (xmin < zb->clip_xmin) xmin = zb->clip_xmin;
+	if (ymin < zb->clip_ymin) ymin = zb->clip_ymin;
+	if (xmax >= zb->clip_xmax) xmax = zb->clip_xmax - 1;
+	if (ymax >= zb->clip_ymax) ymax = zb->clip_ymax - 1;
+	if (xmin > xmax || ymin > ymax)
+		return 0;
+	/* recomputing a bound reads a whole block, only worth it when the triangle is much larger than that */
+	return ZB_hizOccluded(zb, xmin, ymin, xmax, ymax, z, (xmax - xmin + 1) * (ymax - ymin + 1) >= HIZ_REFINE_AREA);
+}
+
+#endif
@@ -7,7 +7,21 @@
 /* TODO: Implement blending for lines and points. */
 
 #if TGL_FEATURE_RENDER_BITS == 1
-#define PUT_PIXEL_1B(val) (*(zb->pbuf + ((GLuint)pp >> 3)) |= (val ? (1 << ((GLuint)pp & 7)) : 0))
+/*
+ * Lines and points only ever set bits. They are gathered in a mask of up to 32 pixels starting at span_pix,
+ * which is written with ZB_put1BSpan() once a pixel falls outside of it, and by FLUSH_PIXELS_1B() at the end.
+ */
+#define PUT_PIXEL_1B(val)                                                                                           \
+	{                                                                                                               \
+		if (pp - span_pix >= 32) {                                                                                  \
+			ZB_put1BSpan(zb, span_pix, span_val, span_val);                                                         \
+			span_pix = pp & ~7u;                                                                                    \
+			span_val = 0;                                                                                           \
+		}                                                                                                           \
+		if (val)                                                                                                    \
+			span_val |= 1u << (pp - span_pix);                                                                      \
+	}
+#define FLUSH_PIXELS_1B() ZB_put1BSpan(zb, span_pix, span_val, span_val)
 #endif
 
 void ZB_plot(ZBuffer* zb, ZBufferPoint* p) {
@@ -16,14 +30,31 @@ void ZB_plot(ZBuffer* zb, ZBufferPoint* p) {
 	GLubyte zbdw = zb->depth_write;
 	GLubyte zbdt = zb->depth_test;
 	GLfloat zbps = zb->pointsize;
+#if TGL_FEATURE_RENDER_BITS == 1
+	GLuint span_pix = 0, span_val = 0;
+#endif
 	TGL_BLEND_VARS
+#if TGL_FEATURE_BAND_RASTER == 1
+	if (zb->band_recording) {
+		ZB_bandPoint(zb, p);
+		return;
+	}
+#endif
+	ZB_flushTiles(zb);
 	zz = p->z >> ZB_POINT_Z_FRAC_BITS;
+	if (zbdw)
+		ZB_hizInvalidate(zb, p->x - (GLint)zbps, p->y - (GLint)zbps, p->x + (GLint)zbps, p->y + (GLint)zbps);
+	ZB_touchRect(zb, p->x - (GLint)zbps, p->y - (GLint)zbps, p->x + (GLint)zbps + 1, p->y + (GLint)zbps + 1);
 	
 	if (zbps == 1) {
 		GLushort* pz;
+#if TGL_FEATURE_BAND_RASTER == 1
+		if (p->y < zb->band_ymin || p->y >= zb->band_ymax)
+			return;
+#endif
 		pz = zb->zbuf + (p->y * zb->xsize + p->x);
 #if TGL_FEATURE_RENDER_BITS == 1
-		PIXEL* pp = (PIXEL*)(zb->xsize * p->y + p->x);
+		GLuint pp = zb->xsize * p->y + p->x;
 #else		
 		PIXEL* pp = (PIXEL*)((GLbyte*)zb->pbuf + zb->linesize * p->y + p->x * PSZB);
 #endif
@@ -54,17 +85,22 @@ void ZB_plot(ZBuffer* zb, ZBufferPoint* p) {
 		GLint by = (GLfloat)p->y - hzbps;
 		GLint ey = (GLfloat)p->y + hzbps;
 		bx = (bx < 0) ? 0 : bx;
-		by = (by < 0) ? 0 : by;
 		ex = (ex > zb->xsize) ? zb->xsize : ex;
+#if TGL_FEATURE_BAND_RASTER == 1
+		by = (by < zb->band_ymin) ? zb->band_ymin : by;
+		ey = (ey > zb->band_ymax) ? zb->band_ymax : ey;
+#else
+		by = (by < 0) ? 0 : by;
 		ey = (ey > zb->ysize) ? zb->ysize : ey;
+#endif
 		for (y = by; y < ey; y++)
 			for (x = bx; x < ex; x++) {
 				GLushort* pz = zb->zbuf + (y * zb->xsize + x);
 
 #if TGL_FEATURE_RENDER_BITS == 1
-				PIXEL* pp = (PIXEL*)(zb->xsize * p->y + p->x);
+				GLuint pp = zb->xsize * y + x;
 #else		
-				PIXEL* pp = (PIXEL*)((GLbyte*)zb->pbuf + zb->linesize * p->y + p->x * PSZB);
+				PIXEL* pp = (PIXEL*)((GLbyte*)zb->pbuf + zb->linesize * y + x * PSZB);
 #endif
 				
 				if (ZCMP(zz, *pz)) {
@@ -87,6 +123,35 @@ void ZB_plot(ZBuffer* zb, ZBufferPoint* p) {
 				}
 			}
 	}
+#if TGL_FEATURE_RENDER_BITS == 1
+	FLUSH_PIXELS_1B();
+#endif
+}
+
+void ZB_plotPixel(ZBuffer* zb, GLint x, GLint y, PIXEL pix) {
+#if TGL_FEATURE_BAND_RASTER == 1
+	if (zb->band_recording) {
+		ZB_bandPixel(zb, x, y, pix);
+		return;
+	}
+	if (y < zb->band_ymin || y >= zb->band_ymax)
+		return;
+#endif
+	ZB_flushTiles(zb);
+	ZB_touchRect(zb, x, y, x + 1, y + 1);
+
+#if TGL_FEATURE_RENDER_BITS == 1
+	{
+		GLuint pix_id = x + y * zb->xsize;
+		GLubyte bit = 1 << (pix_id & 7);
+		if (pix >= ZB_DITHER_ROW(zb, y)[ZB_DITHER_COLUMN(zb, x)])
+			zb->pbuf[pix_id >> 3] |= bit;
+		else
+			zb->pbuf[pix_id >> 3] &= ~bit;
+	}
+#else
+	zb->pbuf[x + y * zb->xsize] = pix;
+#endif
 }
 
 #define INTERP_Z
@@ -121,12 +186,73 @@ static void ZB_line_interp(ZBuffer* zb, ZBufferPoint* p1, ZBufferPoint* p2) {
 #include "zline.h"
 }
 
+#if TGL_FEATURE_BAND_RASTER == 1
+/* the same, only drawing the pixels of the rows of the current band, for lines leaving it */
+#define LINE_ROWS
+#define INTERP_Z
+static void ZB_line_flat_z_rows(ZBuffer* zb, ZBufferPoint* p1, ZBufferPoint* p2, GLint color) {
+	GLubyte zbdt = zb->depth_test;
+	GLubyte zbdw = zb->depth_write;
+#include "zline.h"
+}
+
+#define LINE_ROWS
+#define INTERP_Z
+#define INTERP_RGB
+static void ZB_line_interp_z_rows(ZBuffer* zb, ZBufferPoint* p1, ZBufferPoint* p2) {
+	GLubyte zbdt = zb->depth_test;
+	GLubyte zbdw = zb->depth_write;
+#include "zline.h"
+}
+
+#define LINE_ROWS
+static void ZB_line_flat_rows(ZBuffer* zb, ZBufferPoint* p1, ZBufferPoint* p2, GLint color) {
+#include "zline.h"
+}
+
+#define LINE_ROWS
+#define INTERP_RGB
+static void ZB_line_interp_rows(ZBuffer* zb, ZBufferPoint* p1, ZBufferPoint* p2) {
+#include "zline.h"
+}
+
+/* The line leaves the rows of the current band. */
+#define LINE_LEAVES_BAND(zb, p1, p2)                                                                                \
+	((p1)->y < (zb)->band_ymin || (p1)->y >= (zb)->band_ymax || (p2)->y < (zb)->band_ymin || (p2)->y >= (zb)->band_ymax)
+#endif
+
+/* Prepares the bounding box of a line for drawing. */
+static void ZB_line_touch(ZBuffer* zb, ZBufferPoint* p1, ZBufferPoint* p2) {
+	ZB_touchRect(zb, (p1->x < p2->x) ? p1->x : p2->x, (p1->y < p2->y) ? p1->y : p2->y, ((p1->x > p2->x) ? p1->x : p2->x) + 1,
+					((p1->y > p2->y) ? p1->y : p2->y) + 1);
+}
+
 void ZB_line_z(ZBuffer* zb, ZBufferPoint* p1, ZBufferPoint* p2) {
 	GLint color1, color2;
-	
+#if TGL_FEATURE_BAND_RASTER == 1
+	if (zb->band_recording) {
+		ZB_bandLine(zb, 1, p1, p2);
+		return;
+	}
+#endif
+	ZB_flushTiles(zb);
+	if (zb->depth_write)
+		ZB_hizInvalidate(zb, (p1->x < p2->x) ? p1->x : p2->x, (p1->y < p2->y) ? p1->y : p2->y, (p1->x > p2->x) ? p1->x : p2->x,
+						 (p1->y > p2->y) ? p1->y : p2->y);
+	ZB_line_touch(zb, p1, p2);
+
 	color1 = RGB_TO_PIXEL(p1->r, p1->g, p1->b);
 	color2 = RGB_TO_PIXEL(p2->r, p2->g, p2->b);
 
+#if TGL_FEATURE_BAND_RASTER == 1
+	if (LINE_LEAVES_BAND(zb, p1, p2)) {
+		if (color1 == color2)
+			ZB_line_flat_z_rows(zb, p1, p2, color1);
+		else
+			ZB_line_interp_z_rows(zb, p1, p2);
+		return;
+	}
+#endif
 	/* choose if the line should have its color GLinterpolated or not */
 	if (color1 == color2) {
 		ZB_line_flat_z(zb, p1, p2, color1);
@@ -137,10 +263,27 @@ void ZB_line_z(ZBuffer* zb, ZBufferPoint* p1, ZBufferPoint* p2) {
 
 void ZB_line(ZBuffer* zb, ZBufferPoint* p1, ZBufferPoint* p2) {
 	GLint color1, color2;
+#if TGL_FEATURE_BAND_RASTER == 1
+	if (zb->band_recording) {
+		ZB_bandLine(zb, 0, p1, p2);
+		return;
+	}
+#endif
+	ZB_flushTiles(zb);
+	ZB_line_touch(zb, p1, p2);
 
 	color1 = RGB_TO_PIXEL(p1->r, p1->g, p1->b);
 	color2 = RGB_TO_PIXEL(p2->r, p2->g, p2->b);
 
+#if TGL_FEATURE_BAND_RASTER == 1
+	if (LINE_LEAVES_BAND(zb, p1, p2)) {
+		if (color1 == color2)
+			ZB_line_flat_rows(zb, p1, p2, color1);
+		else
+			ZB_line_interp_rows(zb, p1, p2);
+		return;
+	}
+#endif
 	/* choose if the line should have its color GLinterpolated or not */
 	if (color1 == color2) {
 		ZB_line_flat(zb, p1, p2, color1);
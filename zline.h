@@ -2,7 +2,12 @@
 {
 	GLint n, dx, dy, sx, pp_inc_1, pp_inc_2;
 	register GLint a;
+#if TGL_FEATURE_RENDER_BITS == 1
+	/* the 1 bit framebuffer is packed, so pp is the index of the pixel, not a pointer */
+	register GLuint pp;
+#else
 	register PIXEL* pp;
+#endif
 #if defined(INTERP_RGB)
 	register GLuint r, g, b;
 #endif
@@ -14,6 +19,12 @@
 	GLint zinc;
 	register GLint z, zz;
 #endif
+#if TGL_FEATURE_RENDER_BITS == 1
+	GLuint span_pix, span_val = 0;
+#endif
+#ifdef LINE_ROWS
+	GLint y;
+#endif
 
 	if (p1->y > p2->y || (p1->y == p2->y && p1->x > p2->x)) {
 		ZBufferPoint* tmp;
@@ -22,9 +33,13 @@
 		p2 = tmp;
 	}
 	sx = zb->xsize;
+#ifdef LINE_ROWS
+	y = p1->y;
+#endif
 
 #if TGL_FEATURE_RENDER_BITS == 1
-	pp = (PIXEL*)(zb->xsize * p1->y + p1->x);
+	pp = zb->xsize * p1->y + p1->x;
+	span_pix = pp & ~7u;
 #else
 	pp = (PIXEL*)((GLbyte*)zb->pbuf + zb->linesize * p1->y + p1->x * PSZB);
 #endif
@@ -81,7 +96,26 @@
 #define PUTPIXEL() RGBPIXEL
 #endif /* INTERP_Z */
 
-#define DRAWLINE(dx, dy, inc_1, inc_2)                                                                              \
+#ifdef LINE_ROWS
+/* y steps by 1 with inc_1, and by yinc_2 with inc_2 */
+#define ROWS(x) x
+#define PUTROWPIXEL()                                                                                               \
+	{                                                                                                               \
+		if (y >= zb->band_ymin && y < zb->band_ymax)                                                                \
+			PUTPIXEL();                                                                                             \
+	}
+#else
+#define ROWS(x)
+#define PUTROWPIXEL() PUTPIXEL()
+#endif
+
+#if TGL_FEATURE_RENDER_BITS == 1
+#define PP_STEP(inc) pp += (inc)
+#else
+#define PP_STEP(inc) pp = (PIXEL*)((GLbyte*)pp + (inc))
+#endif
+
+#define DRAWLINE(dx, dy, inc_1, inc_2, yinc_2)                                                                      \
 	n = dx;                                                                                                         \
 	ZZ(zinc = (p2->z - p1->z) / n);                                                                                 \
 	RGB(rinc = ((p2->r - p1->r) << 8) / n; ginc = ((p2->g - p1->g) << 8) / n; binc = ((p2->b - p1->b) << 8) / n);   \
@@ -91,16 +125,18 @@
 	pp_inc_1 = (inc_1)*PSZB;                                                                                        \
 	pp_inc_2 = (inc_2)*PSZB;                                                                                        \
 	do {                                                                                                            \
-		PUTPIXEL();                                                                                                 \
+		PUTROWPIXEL();                                                                                              \
 		ZZ(z += zinc);                                                                                              \
 		RGB(r += rinc; g += ginc; b += binc);                                                                       \
 		if (a > 0) {                                                                                                \
-			pp = (PIXEL*)((GLbyte*)pp + pp_inc_1);                                                                  \
+			PP_STEP(pp_inc_1);                                                                                      \
 			ZZ(pz += (inc_1));                                                                                      \
+			ROWS(y++);                                                                                              \
 			a -= dx;                                                                                                \
 		} else {                                                                                                    \
-			pp = (PIXEL*)((GLbyte*)pp + pp_inc_2);                                                                  \
+			PP_STEP(pp_inc_2);                                                                                      \
 			ZZ(pz += (inc_2));                                                                                      \
+			ROWS(y += (yinc_2));                                                                                    \
 			a += dy;                                                                                                \
 		}                                                                                                           \
 	} while (--n >= 0);
@@ -109,29 +145,36 @@
 	/* fin macro */
 
 	if (dx == 0 && dy == 0) {
-		PUTPIXEL();
+		PUTROWPIXEL();
 	} else if (dx > 0) {
 		if (dx >= dy) {
-			DRAWLINE(dx, dy, sx + 1, 1);
+			DRAWLINE(dx, dy, sx + 1, 1, 0);
 		} else {
-			DRAWLINE(dy, dx, sx + 1, sx);
+			DRAWLINE(dy, dx, sx + 1, sx, 1);
 		}
 	} else {
 		dx = -dx;
 		if (dx >= dy) {
-			DRAWLINE(dx, dy, sx - 1, -1);
+			DRAWLINE(dx, dy, sx - 1, -1, 0);
 		} else {
-			DRAWLINE(dy, dx, sx - 1, sx);
+			DRAWLINE(dy, dx, sx - 1, sx, 1);
 		}
 	}
+#if TGL_FEATURE_RENDER_BITS == 1
+	FLUSH_PIXELS_1B();
+#endif
 }
 
 #undef INTERP_Z
 #undef INTERP_RGB
+#undef LINE_ROWS
 
 /* GLinternal defines */
 #undef DRAWLINE
+#undef PP_STEP
 #undef PUTPIXEL
+#undef PUTROWPIXEL
+#undef ROWS
 #undef ZZ
 #undef RGB
 #undef RGBPIXEL
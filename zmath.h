@@ -71,13 +71,13 @@ static int gl_V3_Norm_Fast(V3* a) {
 	GLfloat n;
 #if TGL_FEATURE_FISR == 1
 	n = fastInvSqrt(a->X * a->X + a->Y * a->Y + a->Z * a->Z); 
-	if (n > 1E+3)
+	if (n > 1E+3f)
 		return 1;
 #else
-	n = sqrt(a->X * a->X + a->Y * a->Y + a->Z * a->Z); 
+	n = sqrtf(a->X * a->X + a->Y * a->Y + a->Z * a->Z); 
 	if (n == 0)
 		return 1;
-	n = 1.0 / n;
+	n = 1.0f / n;
 #endif
 	a->X *= n;
 	a->Y *= n;
@@ -5,6 +5,12 @@
 void glPostProcess(GLuint (*postprocess)(GLint x, GLint y, GLuint pixel, GLushort z)) {
 	GLint i, j;
 	GLContext* c = gl_get_context();
+	gl_render_sync();
+	if (ZB_bandUnsupported(c->zb, "glPostProcess()"))
+		return;
+	ZB_flushTiles(c->zb);
+	/* clears the pending tiles too, the whole zbuffer is read */
+	ZB_touchRect(c->zb, 0, 0, c->zb->xsize, c->zb->ysize);
 #ifdef _OPENMP
 #pragma omp parallel for collapse(2)
 #endif
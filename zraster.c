@@ -98,6 +98,7 @@ void glDrawPixels(GLsizei width, GLsizei height, GLenum format, GLenum type, voi
 	p[2].i = height;
 	p[3].p = data;
 	gl_add_op(p);
+	gl_render_sync();
 }
 #define ZCMP(z, zpix) (!(zbdt) || z >= (zpix))
 #define CLIPTEST(_x, _y, _w, _h) ((0 <= _x) && (_w > _x) && (0 <= _y) && (_h > _y))
@@ -110,6 +111,9 @@ void glopDrawPixels(GLParam* p) {
 	V4 rastpos = c->rasterpos;
 	ZBuffer* zb = c->zb;
 	PIXEL* d = p[3].p;
+	if (ZB_bandUnsupported(zb, "glDrawPixels()"))
+		return;
+	ZB_flushTiles(zb);
 	PIXEL* pbuf = zb->pbuf;
 	GLushort* zbuf = zb->zbuf;
 
@@ -140,6 +144,18 @@ void glopDrawPixels(GLParam* p) {
 		return;
 	}
 #endif
+	/* the pixels may land anywhere, forget the hierarchical z of the whole zbuffer */
+	if (zbdw)
+		ZB_hizInvalidate(zb, 0, 0, tw - 1, th - 1);
+#if TGL_FEATURE_FAST_CLEAR == 1 || TGL_FEATURE_DIRTY_RECTS == 1
+	{
+		/* the zoomed image spans w * pzoomx pixels right and h * pzoomy pixels up from the raster position */
+		GLfloat x0 = rastpos.v[0], x1 = rastpos.v[0] + w * pzoomx;
+		GLfloat y0 = rastpos.v[1] - h * pzoomy, y1 = rastpos.v[1];
+		ZB_touchRect(zb, (GLint)floor((x0 < x1) ? x0 : x1), (GLint)floor((y0 < y1) ? y0 : y1), (GLint)ceil((x0 > x1) ? x0 : x1) + 1,
+						(GLint)ceil((y0 > y1) ? y0 : y1) + 1);
+	}
+#endif
 
 #if TGL_FEATURE_MULTITHREADED_DRAWPIXELS == 1
 
@@ -0,0 +1,117 @@
+#ifndef __ZSIMD__
+#define __ZSIMD__
+#include "zgl.h"
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/*
+Lanes for the block vertex transform and lighting.
+The LANE_ macros work on TGL_LANES floats at a time: four per vector with SSE2 or NEON, one otherwise. GLLaneMask is
+the result of a comparison, GLLaneInt holds integers.
+
+LANE_IF(m, a) gives a where m is set and 0 elsewhere, LANE_IF_NOT(m, a) the other way around.
+LANE_CLIP(a, w, lo, hi) gives lo where a < -w and hi where a > w.
+LANE_IF_IN(code, a) gives a where the clip code is 0 and 0 elsewhere.
+*/
+#if defined(__SSE2__)
+#define TGL_LANES 4
+typedef __m128 GLLane;
+typedef __m128 GLLaneMask;
+typedef __m128i GLLaneInt;
+#define LANE_LOAD(p) _mm_loadu_ps(p)
+#define LANE_STORE(p, a) _mm_storeu_ps(p, a)
+#define LANE_SET(f) _mm_set1_ps(f)
+#define LANE_ADD(a, b) _mm_add_ps(a, b)
+#define LANE_SUB(a, b) _mm_sub_ps(a, b)
+#define LANE_MUL(a, b) _mm_mul_ps(a, b)
+#define LANE_DIV(a, b) _mm_div_ps(a, b)
+#define LANE_MIN(a, b) _mm_min_ps(a, b)
+#define LANE_MAX(a, b) _mm_max_ps(a, b)
+#define LANE_ABS(a) _mm_andnot_ps(_mm_set1_ps(-0.0f), a)
+#define LANE_GT(a, b) _mm_cmpgt_ps(a, b)
+#define LANE_MASK_AND(m, n) _mm_and_ps(m, n)
+#define LANE_MASK_ANY(m) (_mm_movemask_ps(m) != 0)
+#define LANE_IF(m, a) _mm_and_ps(m, a)
+#define LANE_IF_NOT(m, a) _mm_andnot_ps(m, a)
+#define LANE_CLIP(a, w, lo, hi)                                                                                           \
+	_mm_or_si128(_mm_and_si128(_mm_castps_si128(_mm_cmplt_ps(a, _mm_sub_ps(_mm_setzero_ps(), w))), _mm_set1_epi32(lo)), \
+				 _mm_and_si128(_mm_castps_si128(_mm_cmpgt_ps(a, w)), _mm_set1_epi32(hi)))
+#define LANE_OR(a, b) _mm_or_si128(a, b)
+#define LANE_IF_IN(code, a) _mm_and_ps(_mm_castsi128_ps(_mm_cmpeq_epi32(code, _mm_setzero_si128())), a)
+#define LANE_STORE_INT(p, a) _mm_storeu_si128((__m128i*)(p), a)
+#define LANE_STORE_MASK(p, m) _mm_storeu_si128((__m128i*)(p), _mm_castps_si128(m))
+#define LANE_STORE_TRUNC(p, a) _mm_storeu_si128((__m128i*)(p), _mm_cvttps_epi32(a))
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#define TGL_LANES 4
+typedef float32x4_t GLLane;
+typedef uint32x4_t GLLaneMask;
+typedef uint32x4_t GLLaneInt;
+#define LANE_LOAD(p) vld1q_f32(p)
+#define LANE_STORE(p, a) vst1q_f32(p, a)
+#define LANE_SET(f) vdupq_n_f32(f)
+#define LANE_ADD(a, b) vaddq_f32(a, b)
+#define LANE_SUB(a, b) vsubq_f32(a, b)
+#define LANE_MUL(a, b) vmulq_f32(a, b)
+#if defined(__aarch64__)
+#define LANE_DIV(a, b) vdivq_f32(a, b)
+#else
+/* ARMv7 NEON has no division, only an estimate */
+static GLLane lane_div(GLLane a, GLLane b) {
+	GLfloat f[4], g[4];
+	vst1q_f32(f, a);
+	vst1q_f32(g, b);
+	f[0] /= g[0];
+	f[1] /= g[1];
+	f[2] /= g[2];
+	f[3] /= g[3];
+	return vld1q_f32(f);
+}
+#define LANE_DIV(a, b) lane_div(a, b)
+#endif
+#define LANE_MIN(a, b) vminq_f32(a, b)
+#define LANE_MAX(a, b) vmaxq_f32(a, b)
+#define LANE_ABS(a) vabsq_f32(a)
+#define LANE_GT(a, b) vcgtq_f32(a, b)
+#define LANE_MASK_AND(m, n) vandq_u32(m, n)
+#define LANE_MASK_ANY(m) ((vgetq_lane_u32(m, 0) | vgetq_lane_u32(m, 1) | vgetq_lane_u32(m, 2) | vgetq_lane_u32(m, 3)) != 0)
+#define LANE_IF(m, a) vreinterpretq_f32_u32(vandq_u32(m, vreinterpretq_u32_f32(a)))
+#define LANE_IF_NOT(m, a) vreinterpretq_f32_u32(vbicq_u32(vreinterpretq_u32_f32(a), m))
+#define LANE_CLIP(a, w, lo, hi) vorrq_u32(vandq_u32(vcltq_f32(a, vnegq_f32(w)), vdupq_n_u32(lo)), vandq_u32(vcgtq_f32(a, w), vdupq_n_u32(hi)))
+#define LANE_OR(a, b) vorrq_u32(a, b)
+#define LANE_IF_IN(code, a) vreinterpretq_f32_u32(vandq_u32(vceqq_u32(code, vdupq_n_u32(0)), vreinterpretq_u32_f32(a)))
+#define LANE_STORE_INT(p, a) vst1q_s32(p, vreinterpretq_s32_u32(a))
+#define LANE_STORE_MASK(p, m) vst1q_s32(p, vreinterpretq_s32_u32(m))
+#define LANE_STORE_TRUNC(p, a) vst1q_s32(p, vcvtq_s32_f32(a))
+#else
+#define TGL_LANES 1
+typedef GLfloat GLLane;
+typedef GLint GLLaneMask;
+typedef GLint GLLaneInt;
+#define LANE_LOAD(p) (*(p))
+#define LANE_STORE(p, a) (*(p) = (a))
+#define LANE_SET(f) (f)
+#define LANE_ADD(a, b) ((a) + (b))
+#define LANE_SUB(a, b) ((a) - (b))
+#define LANE_MUL(a, b) ((a) * (b))
+#define LANE_DIV(a, b) ((a) / (b))
+#define LANE_MIN(a, b) (((a) < (b)) ? (a) : (b))
+#define LANE_MAX(a, b) (((a) > (b)) ? (a) : (b))
+#define LANE_ABS(a) (((a) < 0) ? -(a) : (a))
+#define LANE_GT(a, b) ((a) > (b))
+#define LANE_MASK_AND(m, n) ((m) && (n))
+#define LANE_MASK_ANY(m) (m)
+#define LANE_IF(m, a) ((m) ? (a) : 0.0f)
+#define LANE_IF_NOT(m, a) ((m) ? 0.0f : (a))
+#define LANE_CLIP(a, w, lo, hi) ((((a) < -(w)) ? (lo) : 0) | (((a) > (w)) ? (hi) : 0))
+#define LANE_OR(a, b) ((a) | (b))
+#define LANE_IF_IN(code, a) (((code) == 0) ? (a) : 0.0f)
+#define LANE_STORE_INT(p, a) (*(p) = (a))
+#define LANE_STORE_MASK(p, m) (*(p) = (m))
+#define LANE_STORE_TRUNC(p, a) (*(p) = (GLint)(a))
+#endif
+
+#endif
@@ -43,25 +43,13 @@ static void renderchar(GLbyte* bitmap, GLint _x, GLint _y, GLuint p) {
 void glopPlotPixel(GLParam* p) {
 	GLContext* c = gl_get_context();
 	GLint x = p[1].i;
-	PIXEL pix = p[2].ui;
-
-#if TGL_FEATURE_RENDER_BITS == 1
-	#define DM_X(pix_id) ((pix_id % c->zb->xsize) % c->zb->dither_map_size)
-	#define DM_Y(pix_id) ((pix_id / c->zb->xsize) % c->zb->dither_map_size)
-	#define DM_VAL(pix_id) (c->zb->dither_map[c->zb->dither_map_size * DM_Y(pix_id) + DM_X(pix_id)])
-	#define PUT_PIXEL_1B_SET(pix_id) (*(c->zb->pbuf + (pix_id >> 3)) |= (1 << (pix_id & 7)))
-	#define PUT_PIXEL_1B_UNSET(pix_id) (*(c->zb->pbuf + (pix_id >> 3)) &= ~(1 << (pix_id & 7)))
-	#define PUT_PIXEL_1B(pix_id, cval) (cval >= DM_VAL(pix_id) ? PUT_PIXEL_1B_SET(pix_id) : PUT_PIXEL_1B_UNSET(pix_id))
-	
-	PUT_PIXEL_1B(x, pix);
-	// c->zb->pbuf[x >> 3] |= (pix >= DM_VAL(x) ? (1 << (x & 7)) : 0);
-#else
-	c->zb->pbuf[x] = pix;
-#endif
+	GLint y = p[2].i;
+	PIXEL pix = p[3].ui;
+	ZB_plotPixel(c->zb, x, y, pix);
 }
 
 void glPlotPixel(GLint x, GLint y, GLuint pix) {
-	GLParam p[3];
+	GLParam p[4];
 	GLContext* c = gl_get_context();
 #include "error_check.h"
 	
@@ -75,8 +63,9 @@ void glPlotPixel(GLint x, GLint y, GLuint pix) {
 #elif TGL_FEATURE_RENDER_BITS == 1
 		pix = RGB_TO_PIXEL(pix, pix << 8, pix << 16);
 #endif
-		p[1].i = x + y * w;
-		p[2].ui = pix;
+		p[1].i = x;
+		p[2].i = y;
+		p[3].ui = pix;
 		gl_add_op(p);
 	}
 }
@@ -84,6 +73,7 @@ void glDrawText(const GLubyte* text, GLint x, GLint y, GLuint p) {
 	GLContext* c = gl_get_context();
 	GLint i = 0;
 #include "error_check.h"
+	gl_render_sync();
 
 #if TGL_FEATURE_ERROR_CHECK == 1
 	if (!text)
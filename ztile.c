@@ -0,0 +1,287 @@
+/*
+ * Tile-binned triangle rasterizer.
+ * In ZB_RASTER_TILED mode gl_draw_triangle_fill() does not rasterize triangles right away,
+ * it stores them (along with the zbuffer state they need) in the bins of every screen tile
+ * their bounding box touches. ZB_flushTiles() then rasterizes every tile with the regular
+ * ZB_fillTriangle* functions, clipped to the tile. Tiles never share pixels, so they can
+ * be rasterized in parallel, and the triangles of a tile are drawn in submission order,
+ * so the result is the same as in immediate mode.
+ */
+#include <string.h>
+#include "zbuffer.h"
+#include "msghandling.h"
+
+#if TGL_FEATURE_TILED_RASTER == 1
+
+#ifdef _OPENMP
+#include <omp.h>
+#endif
+
+#define TILE_SIZE (1 << TGL_RASTER_TILE_POW2)
+
+/* the zbuffer state a triangle is rasterized with */
+typedef struct {
+	ZBTexture texture;
+	GLint depth_test;
+	GLint depth_write;
+	GLint enable_blend;
+	GLenum blendeq, sfactor, dfactor;
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+	GLuint dostipple;
+#endif
+} ZBTileState;
+
+typedef struct {
+	ZB_fillTriangleFunc fill;
+	GLint state;
+	ZBufferPoint p[3];
+} ZBTileTriangle;
+
+typedef struct {
+	GLint* tris;
+	GLint count, allocated;
+} ZBTile;
+
+struct ZBTileBins {
+	GLint tiles_x, tiles_y;
+	ZBTile* tiles;
+	ZBTileTriangle* tris;
+	GLint tri_count, tri_allocated;
+	ZBTileState* states;
+	GLint state_count, state_allocated;
+};
+
+/* Grows a bin array to hold at least one more element. Returns 0 when out of memory. */
+static GLint gl_tile_grow(void** array, GLint* allocated, GLint count, GLint elem_size) {
+	void* n;
+	GLint i;
+	if (count < *allocated)
+		return 1;
+	i = (*allocated) ? (*allocated * 2) : 64;
+	n = gl_malloc(i * elem_size);
+	if (n == NULL)
+		return 0;
+	if (*array) {
+		memcpy(n, *array, count * elem_size);
+		gl_free(*array);
+	}
+	*array = n;
+	*allocated = i;
+	return 1;
+}
+
+static void gl_tile_free_bins(struct ZBTileBins* b) {
+	GLint i;
+	if (b == NULL)
+		return;
+	for (i = 0; i < b->tiles_x * b->tiles_y; i++)
+		if (b->tiles[i].tris)
+			gl_free(b->tiles[i].tris);
+	if (b->tiles)
+		gl_free(b->tiles);
+	if (b->tris)
+		gl_free(b->tris);
+	if (b->states)
+		gl_free(b->states);
+	gl_free(b);
+}
+
+static struct ZBTileBins* gl_tile_alloc_bins(ZBuffer* zb) {
+	struct ZBTileBins* b = gl_zalloc(sizeof(struct ZBTileBins));
+	if (b == NULL)
+		return NULL;
+	b->tiles_x = (zb->xsize + TILE_SIZE - 1) >> TGL_RASTER_TILE_POW2;
+	b->tiles_y = (zb->ysize + TILE_SIZE - 1) >> TGL_RASTER_TILE_POW2;
+	b->tiles = gl_zalloc(sizeof(ZBTile) * b->tiles_x * b->tiles_y);
+	if (b->tiles == NULL) {
+		gl_free(b);
+		return NULL;
+	}
+	return b;
+}
+
+void ZB_setRasterMode(ZBuffer* zb, GLint mode) {
+	ZB_flushTiles(zb);
+	/* bands are binned already */
+	if (ZB_BANDED(zb))
+		mode = ZB_RASTER_IMMEDIATE;
+	if (mode == ZB_RASTER_TILED) {
+		if (zb->tile_bins == NULL)
+			zb->tile_bins = gl_tile_alloc_bins(zb);
+		if (zb->tile_bins == NULL) {
+			tgl_warning("\nTinyGL: Not enough memory for the tiled rasterizer, staying in immediate mode.");
+			mode = ZB_RASTER_IMMEDIATE;
+		}
+	}
+	zb->raster_mode = mode;
+}
+
+void ZB_setRasterThreads(ZBuffer* zb, GLint num_threads) {
+	ZB_flushTiles(zb);
+	zb->raster_threads = (num_threads < 1) ? 1 : num_threads;
+}
+
+/* Draws anything still binned and frees the bins. Leaves the zbuffer in immediate mode. */
+void ZB_closeTiles(ZBuffer* zb) {
+	ZB_flushTiles(zb);
+	gl_tile_free_bins(zb->tile_bins);
+	zb->tile_bins = NULL;
+	zb->raster_mode = ZB_RASTER_IMMEDIATE;
+}
+
+static GLint gl_tile_state(ZBuffer* zb, struct ZBTileBins* b) {
+	ZBTileState* st;
+	if (b->state_count) {
+		st = b->states + b->state_count - 1;
+		if (st->texture.pixmap == zb->current_texture.pixmap && st->texture.s_shift == zb->current_texture.s_shift &&
+			st->texture.t_shift == zb->current_texture.t_shift && st->depth_test == zb->depth_test && st->depth_write == zb->depth_write &&
+			st->enable_blend == zb->enable_blend && st->blendeq == zb->blendeq && st->sfactor == zb->sfactor && st->dfactor == zb->dfactor
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+			&& st->dostipple == zb->dostipple
+#endif
+		)
+			return b->state_count - 1;
+	}
+	if (!gl_tile_grow((void**)&b->states, &b->state_allocated, b->state_count, sizeof(ZBTileState)))
+		return -1;
+	st = b->states + b->state_count;
+	st->texture = zb->current_texture;
+	st->depth_test = zb->depth_test;
+	st->depth_write = zb->depth_write;
+	st->enable_blend = zb->enable_blend;
+	st->blendeq = zb->blendeq;
+	st->sfactor = zb->sfactor;
+	st->dfactor = zb->dfactor;
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+	st->dostipple = zb->dostipple;
+#endif
+	return b->state_count++;
+}
+
+void ZB_binTriangle(ZBuffer* zb, ZB_fillTriangleFunc fill, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+	struct ZBTileBins* b = zb->tile_bins;
+	ZBTileTriangle* tri;
+	GLint xmin, xmax, ymin, ymax, tx, ty, state, ok;
+
+	xmin = xmax = p0->x;
+	ymin = ymax = p0->y;
+	if (p1->x < xmin) xmin = p1->x;
+	if (p1->x > xmax) xmax = p1->x;
+	if (p2->x < xmin) xmin = p2->x;
+	if (p2->x > xmax) xmax = p2->x;
+	if (p1->y < ymin) ymin = p1->y;
+	if (p1->y > ymax) ymax = p1->y;
+	if (p2->y < ymin) ymin = p2->y;
+	if (p2->y > ymax) ymax = p2->y;
+	/* The scanline rasterizer may round a span one pixel past the bounding box. */
+	xmin--;
+	xmax++;
+	if (xmin < zb->clip_xmin) xmin = zb->clip_xmin;
+	if (ymin < zb->clip_ymin) ymin = zb->clip_ymin;
+	if (xmax >= zb->clip_xmax) xmax = zb->clip_xmax - 1;
+	if (ymax >= zb->clip_ymax) ymax = zb->clip_ymax - 1;
+	if (xmin > xmax || ymin > ymax)
+		return;
+
+	xmin >>= TGL_RASTER_TILE_POW2;
+	xmax >>= TGL_RASTER_TILE_POW2;
+	ymin >>= TGL_RASTER_TILE_POW2;
+	ymax >>= TGL_RASTER_TILE_POW2;
+
+	/* make room everywhere first, so that a triangle is never binned only partially */
+	state = gl_tile_state(zb, b);
+	ok = (state >= 0) && gl_tile_grow((void**)&b->tris, &b->tri_allocated, b->tri_count, sizeof(ZBTileTriangle));
+	for (ty = ymin; ok && ty <= ymax; ty++)
+		for (tx = xmin; ok && tx <= xmax; tx++) {
+			ZBTile* tile = b->tiles + ty * b->tiles_x + tx;
+			ok = gl_tile_grow((void**)&tile->tris, &tile->allocated, tile->count, sizeof(GLint));
+		}
+	if (!ok) {
+		/* out of memory, draw what we have and this triangle right away */
+		ZB_flushTiles(zb);
+		fill(zb, p0, p1, p2);
+		return;
+	}
+
+	tri = b->tris + b->tri_count;
+	tri->fill = fill;
+	tri->state = state;
+	tri->p[0] = *p0;
+	tri->p[1] = *p1;
+	tri->p[2] = *p2;
+	for (ty = ymin; ty <= ymax; ty++)
+		for (tx = xmin; tx <= xmax; tx++) {
+			ZBTile* tile = b->tiles + ty * b->tiles_x + tx;
+			tile->tris[tile->count++] = b->tri_count;
+		}
+	b->tri_count++;
+}
+
+static void gl_tile_rasterize(ZBuffer* zb, struct ZBTileBins* b, GLint tile_id) {
+	ZBTile* tile = b->tiles + tile_id;
+	ZBuffer tzb;
+	GLint i, tx, ty;
+
+	if (tile->count == 0)
+		return;
+	tx = (tile_id % b->tiles_x) << TGL_RASTER_TILE_POW2;
+	ty = (tile_id / b->tiles_x) << TGL_RASTER_TILE_POW2;
+	/* every tile works on its own copy of the zbuffer, only the clip rectangle and state differ */
+	tzb = *zb;
+	if (tx > tzb.clip_xmin)
+		tzb.clip_xmin = tx;
+	if (ty > tzb.clip_ymin)
+		tzb.clip_ymin = ty;
+	if (tx + TILE_SIZE < tzb.clip_xmax)
+		tzb.clip_xmax = tx + TILE_SIZE;
+	if (ty + TILE_SIZE < tzb.clip_ymax)
+		tzb.clip_ymax = ty + TILE_SIZE;
+
+	for (i = 0; i < tile->count; i++) {
+		ZBTileTriangle* tri = b->tris + tile->tris[i];
+		ZBTileState* st = b->states + tri->state;
+		/* the fill functions sort and modify the points, so every tile needs its own copies */
+		ZBufferPoint p0 = tri->p[0], p1 = tri->p[1], p2 = tri->p[2];
+		tzb.current_texture = st->texture;
+		tzb.depth_test = st->depth_test;
+		tzb.depth_write = st->depth_write;
+		tzb.enable_blend = st->enable_blend;
+		tzb.blendeq = st->blendeq;
+		tzb.sfactor = st->sfactor;
+		tzb.dfactor = st->dfactor;
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+		tzb.dostipple = st->dostipple;
+#endif
+		tri->fill(&tzb, &p0, &p1, &p2);
+	}
+	tile->count = 0;
+}
+
+void ZB_flushTiles(ZBuffer* zb) {
+	struct ZBTileBins* b = zb->tile_bins;
+	GLint i, n;
+
+	if (b == NULL || b->tri_count == 0)
+		return;
+	n = b->tiles_x * b->tiles_y;
+#ifdef _OPENMP
+	{
+		GLint threads = zb->raster_threads;
+#if TGL_FEATURE_RENDER_BITS == 1
+		/* pixels of different rows share bytes unless the rows are a whole number of bytes */
+		if (zb->xsize & 7)
+			threads = 1;
+#endif
+#pragma omp parallel for schedule(dynamic, 1) num_threads(threads)
+		for (i = 0; i < n; i++)
+			gl_tile_rasterize(zb, b, i);
+	}
+#else
+	for (i = 0; i < n; i++)
+		gl_tile_rasterize(zb, b, i);
+#endif
+	b->tri_count = 0;
+	b->state_count = 0;
+}
+
+#endif
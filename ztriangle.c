@@ -5,11 +5,92 @@
 
 
 
-/* TODO: Switch from scanline rasterizer to easily parallelized cross product rasterizer.*/
-static GLfloat edgeFunction(GLfloat ax, GLfloat ay, GLfloat bx, GLfloat by, GLfloat cx, GLfloat cy) {
-	return (cx - ax) * (by - ay) - (cy - ay) * (bx - ax);
+#if TGL_FEATURE_HALFSPACE_RASTER == 1
+
+#if defined(__SSE2__)
+#include <emmintrin.h>
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+#include <arm_neon.h>
+#endif
+
+/* Block size of the half-space rasterizer (ztriangle_hs.h). Rows are evaluated as two 4-wide vectors. */
+#define HS_BLOCK 8
+
+/*
+Coverage of one HS_BLOCK wide row for the half-space rasterizer: bit k is set when pixel k is inside all three edges.
+e0, e1 and e2 are the edge functions at the first pixel, steps holds k * (x step) for every edge and pixel.
+*/
+static GLuint hs_row_mask(GLint e0, GLint e1, GLint e2, const GLint* steps) {
+#if defined(__SSE2__)
+	const __m128i neg = _mm_set1_epi32(-1);
+	__m128i lo, hi, v0, v1, v2;
+	v0 = _mm_set1_epi32(e0);
+	v1 = _mm_set1_epi32(e1);
+	v2 = _mm_set1_epi32(e2);
+	lo = _mm_cmpgt_epi32(_mm_add_epi32(v0, _mm_loadu_si128((const __m128i*)(steps))), neg);
+	lo = _mm_and_si128(lo, _mm_cmpgt_epi32(_mm_add_epi32(v1, _mm_loadu_si128((const __m128i*)(steps + HS_BLOCK))), neg));
+	lo = _mm_and_si128(lo, _mm_cmpgt_epi32(_mm_add_epi32(v2, _mm_loadu_si128((const __m128i*)(steps + 2 * HS_BLOCK))), neg));
+	hi = _mm_cmpgt_epi32(_mm_add_epi32(v0, _mm_loadu_si128((const __m128i*)(steps + 4))), neg);
+	hi = _mm_and_si128(hi, _mm_cmpgt_epi32(_mm_add_epi32(v1, _mm_loadu_si128((const __m128i*)(steps + HS_BLOCK + 4))), neg));
+	hi = _mm_and_si128(hi, _mm_cmpgt_epi32(_mm_add_epi32(v2, _mm_loadu_si128((const __m128i*)(steps + 2 * HS_BLOCK + 4))), neg));
+	return (GLuint)_mm_movemask_ps(_mm_castsi128_ps(lo)) | ((GLuint)_mm_movemask_ps(_mm_castsi128_ps(hi)) << 4);
+#elif defined(__ARM_NEON) || defined(__ARM_NEON__)
+	static const uint32_t bits[HS_BLOCK] = {1, 2, 4, 8, 16, 32, 64, 128};
+	const int32x4_t zero = vdupq_n_s32(0);
+	int32x4_t v0, v1, v2;
+	uint32x4_t lo, hi;
+	uint32x2_t r;
+	v0 = vdupq_n_s32(e0);
+	v1 = vdupq_n_s32(e1);
+	v2 = vdupq_n_s32(e2);
+	lo = vcgeq_s32(vaddq_s32(v0, vld1q_s32(steps)), zero);
+	lo = vandq_u32(lo, vcgeq_s32(vaddq_s32(v1, vld1q_s32(steps + HS_BLOCK)), zero));
+	lo = vandq_u32(lo, vcgeq_s32(vaddq_s32(v2, vld1q_s32(steps + 2 * HS_BLOCK)), zero));
+	hi = vcgeq_s32(vaddq_s32(v0, vld1q_s32(steps + 4)), zero);
+	hi = vandq_u32(hi, vcgeq_s32(vaddq_s32(v1, vld1q_s32(steps + HS_BLOCK + 4)), zero));
+	hi = vandq_u32(hi, vcgeq_s32(vaddq_s32(v2, vld1q_s32(steps + 2 * HS_BLOCK + 4)), zero));
+	lo = vorrq_u32(vandq_u32(lo, vld1q_u32(bits)), vandq_u32(hi, vld1q_u32(bits + 4)));
+	r = vorr_u32(vget_low_u32(lo), vget_high_u32(lo));
+	return vget_lane_u32(r, 0) | vget_lane_u32(r, 1);
+#else
+	GLuint m = 0;
+	GLint k;
+	for (k = 0; k < HS_BLOCK; k++)
+		if (((e0 + steps[k]) | (e1 + steps[HS_BLOCK + k]) | (e2 + steps[2 * HS_BLOCK + k])) >= 0)
+			m |= 1 << k;
+	return m;
+#endif
 }
 
+/* m is never 0 */
+static GLint hs_first_bit(GLuint m) {
+#if defined(__GNUC__)
+	return __builtin_ctz(m);
+#else
+	GLint i = 0;
+	while (!(m & 1)) {
+		m >>= 1;
+		i++;
+	}
+	return i;
+#endif
+}
+
+static GLint hs_last_bit(GLuint m) {
+#if defined(__GNUC__)
+	return 31 - __builtin_clz(m);
+#else
+	GLint i = -1;
+	while (m) {
+		m >>= 1;
+		i++;
+	}
+	return i;
+#endif
+}
+
+#endif
+
 #if TGL_FEATURE_RENDER_BITS == 32
 #elif TGL_FEATURE_RENDER_BITS == 16
 #elif TGL_FEATURE_RENDER_BITS == 1
@@ -19,9 +100,7 @@ static GLfloat edgeFunction(GLfloat ax, GLfloat ay, GLfloat bx, GLfloat by, GLfl
 
 #if TGL_FEATURE_POLYGON_STIPPLE == 1
 
-#define TGL_STIPPLEVARS                                                                                                                                        \
-	GLubyte* zbstipplepattern = zb->stipplepattern;                                                                                                            \
-	GLubyte zbdostipple = zb->dostipple;
+#define TGL_STIPPLEVARS GLubyte* zbstipplepattern = zb->stipplepattern;
 #define THE_X ((GLint)(pp - pp1))
 #define XSTIP(_a) ((THE_X + _a) & TGL_POLYGON_STIPPLE_MASK_X)
 #define YSTIP (the_y & TGL_POLYGON_STIPPLE_MASK_Y)
@@ -45,28 +124,80 @@ static GLfloat edgeFunction(GLfloat ax, GLfloat ay, GLfloat bx, GLfloat by, GLfl
 #define ZCMP(z, zpix, _a, c) (((!zbdt) || (z >= zpix)) STIPTEST(_a) NODRAWTEST(c))
 #define ZCMPSIMP(z, zpix, _a, crabapple) (((!zbdt) || (z >= zpix)) STIPTEST(_a))
 
+/*
+ * The fill functions take the zbuffer state their inner loops test as parameters. ZB_fillTriangle*() call
+ * them with the current state, ZB_getFillFunc() returns copies made with that state as constants
+ * (see the end of this file), so the depth, stipple and blend tests are folded away at compile time.
+ */
+#define TGL_FILL_STATE_PARAMS                                                                                       \
+	const GLubyte zbdt, const GLubyte zbdw, const GLubyte zbdostipple, const GLuint zbblendeq, const GLuint sfactor, \
+		const GLuint dfactor
+/* not every fill tests every piece of state, this keeps the parameters it ignores from warning */
+#define TGL_FILL_STATE_UNUSED                                                                                       \
+	(void)zbdostipple;                                                                                              \
+	(void)zbblendeq;                                                                                                \
+	(void)sfactor;                                                                                                  \
+	(void)dfactor;
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+#define TGL_FILL_STATE(zb) (zb)->depth_test, (zb)->depth_write, (zb)->dostipple, (zb)->blendeq, (zb)->sfactor, (zb)->dfactor
+#else
+#define TGL_FILL_STATE(zb) (zb)->depth_test, (zb)->depth_write, 0, (zb)->blendeq, (zb)->sfactor, (zb)->dfactor
+#endif
+#if defined(__GNUC__)
+#define TGL_FILL_INLINE inline __attribute__((always_inline))
+#else
+#define TGL_FILL_INLINE /* a comment */
+#endif
 
-#if TGL_FEATURE_RENDER_BITS == 1
-
-#define DM_X(pix_id) ((pix_id % zb->xsize) % zb->dither_map_size)
-#define DM_Y(pix_id) ((pix_id / zb->xsize) % zb->dither_map_size)
-#define DM_VAL(pix_id) (zb->dither_map[zb->dither_map_size * DM_Y(pix_id) + DM_X(pix_id)])
 
-#define PUT_PIXEL_1B_SET(pix_id) (*(zb->pbuf + (pix_id >> 3)) |= (1 << (pix_id & 7)))
-#define PUT_PIXEL_1B_UNSET(pix_id) (*(zb->pbuf + (pix_id >> 3)) &= ~(1 << (pix_id & 7)))
-#define PUT_PIXEL_1B(pix_id, cval) (cval >= DM_VAL(pix_id) ? PUT_PIXEL_1B_SET(pix_id) : PUT_PIXEL_1B_UNSET(pix_id))
+#if TGL_FEATURE_RENDER_BITS == 1
 
-#define PUT_PIXEL_1B_BLEND(pix_id, cval) (*(zb->pbuf + (pix_id >> 3)) |= (cval >= DM_VAL(pix_id) ? (1 << (pix_id & 7)) : 0))
+/*
+ * Packed span writer for the 1 bit NOBLEND fills, for the span starting at screen pixel x, y.
+ * The row of dither thresholds is fetched once per span and indexed with a wrapping column.
+ * The depth test and dithering are still done per pixel, but the results are gathered in coverage
+ * and value masks of up to 32 pixels starting at a byte boundary, which ZB_put1BSpan() writes
+ * a whole byte at a time instead of doing a read-modify-write per pixel.
+ * SPAN_1B_COLOR is the color of the current pixel, SPAN_1B_STEP() advances the color interpolants.
+ */
+#define DRAW_SPAN_1B(x, y)                                                                      \
+	{                                                                                           \
+		const GLubyte* dm_row = ZB_DITHER_ROW(zb, y);                                           \
+		GLuint dm_x = ZB_DITHER_COLUMN(zb, x), dm_mask = zb->dither_map_mask;                   \
+		while (n >= 0) {                                                                        \
+			GLuint span_pix = (GLuint)pp & ~7u, span_cov = 0, span_val = 0;                     \
+			GLuint span_bit = 1u << ((GLuint)pp & 7);                                           \
+			GLint span_cnt = 32 - (GLint)((GLuint)pp & 7);                                      \
+			if (span_cnt > n + 1)                                                               \
+				span_cnt = n + 1;                                                               \
+			n -= span_cnt;                                                                      \
+			do {                                                                                \
+				register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                                 \
+				if (ZCMPSIMP(zz, *pz, 0, 0)) {                                                  \
+					span_cov |= span_bit;                                                       \
+					if (SPAN_1B_COLOR >= dm_row[dm_x])                                          \
+						span_val |= span_bit;                                                   \
+					if (zbdw)                                                                   \
+						*pz = zz;                                                               \
+				}                                                                               \
+				z += dzdx;                                                                      \
+				SPAN_1B_STEP();                                                                 \
+				dm_x = (dm_x + 1) & dm_mask;                                                    \
+				pz++;                                                                           \
+				pp++;                                                                           \
+				span_bit <<= 1;                                                                 \
+			} while (--span_cnt);                                                               \
+			ZB_put1BSpan(zb, span_pix, span_cov, span_val);                                     \
+		}                                                                                       \
+	}
 
 #endif
 
 
-void ZB_fillTriangleFlat(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
-	GLubyte zbdt = zb->depth_test;
-	GLubyte zbdw = zb->depth_write;
+static TGL_FILL_INLINE void gl_fillTriangleFlat(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2, TGL_FILL_STATE_PARAMS) {
 	GLuint color;
-	TGL_BLEND_VARS
 	TGL_STIPPLEVARS
+	TGL_FILL_STATE_UNUSED
 
 #undef INTERP_Z
 #undef INTERP_RGB
@@ -79,6 +210,20 @@ void ZB_fillTriangleFlat(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBuffe
 #define DRAW_INIT()                                                                                                                                            \
 	{ color = RGB_TO_PIXEL(p2->r, p2->g, p2->b); }
 
+#if TGL_FEATURE_RENDER_BITS == 1
+
+/* there is no blending in 1 bit mode, spans are drawn whole by DRAW_SPAN like the NOBLEND fill does */
+#define PUT_PIXEL(_a)                                                                                                                                          \
+	{}
+
+#undef SPAN_1B_COLOR
+#undef SPAN_1B_STEP
+#define SPAN_1B_COLOR RGB_TO_PIXEL(color, color << 8, color << 16)
+#define SPAN_1B_STEP() /* a comment */
+#define DRAW_SPAN(x, y) DRAW_SPAN_1B(x, y)
+
+#else
+
 #define PUT_PIXEL(_a)                                                                                                                                          \
 	{                                                                                                                                                          \
 		{                                                                                                                                                      \
@@ -92,14 +237,21 @@ void ZB_fillTriangleFlat(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBuffe
 		z += dzdx;                                                                                                                                             \
 	}
 
+#endif
+
+#if TGL_FEATURE_HALFSPACE_RASTER == 1
+	if (zb->raster_backend == ZB_BACKEND_HALFSPACE) {
+#include "ztriangle_hs.h"
+		return;
+	}
+#endif
 #include "ztriangle.h"
 }
 
-void ZB_fillTriangleFlatNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+static TGL_FILL_INLINE void gl_fillTriangleFlatNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2, TGL_FILL_STATE_PARAMS) {
 	PIXEL color = RGB_TO_PIXEL(p2->r, p2->g, p2->b);
-	GLubyte zbdw = zb->depth_write;
-	GLubyte zbdt = zb->depth_test;
 	TGL_STIPPLEVARS
+	TGL_FILL_STATE_UNUSED
 #undef INTERP_Z
 #undef INTERP_RGB
 #undef INTERP_ST
@@ -111,18 +263,15 @@ void ZB_fillTriangleFlatNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1,
 
 #if TGL_FEATURE_RENDER_BITS == 1
 
+/* spans are drawn whole by DRAW_SPAN */
 #define PUT_PIXEL(_a)                                                                           \
-	{                                                                                           \
-		{                                                                                       \
-			register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                                     \
-			if (ZCMPSIMP(zz, pz[_a], _a, 0)) {                                                  \
-				PUT_PIXEL_1B((GLuint)(pp + _a), RGB_TO_PIXEL(color, color << 8, color << 16));  \
-				if (zbdw)                                                                       \
-					pz[_a] = zz;                                                                \
-			}                                                                                   \
-		}                                                                                       \
-		z += dzdx;                                                                              \
-	}
+	{}
+
+#undef SPAN_1B_COLOR
+#undef SPAN_1B_STEP
+#define SPAN_1B_COLOR RGB_TO_PIXEL(color, color << 8, color << 16)
+#define SPAN_1B_STEP() /* a comment */
+#define DRAW_SPAN(x, y) DRAW_SPAN_1B(x, y)
 
 #else
 
@@ -141,6 +290,12 @@ void ZB_fillTriangleFlatNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1,
 
 #endif
 
+#if TGL_FEATURE_HALFSPACE_RASTER == 1
+	if (zb->raster_backend == ZB_BACKEND_HALFSPACE) {
+#include "ztriangle_hs.h"
+		return;
+	}
+#endif
 #include "ztriangle.h"
 }
 
@@ -149,11 +304,9 @@ void ZB_fillTriangleFlatNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1,
  * The code below is very tricky :)
  */
 
-void ZB_fillTriangleSmooth(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
-	GLubyte zbdw = zb->depth_write;
-	GLubyte zbdt = zb->depth_test;
-	TGL_BLEND_VARS
+static TGL_FILL_INLINE void gl_fillTriangleSmooth(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2, TGL_FILL_STATE_PARAMS) {
 	TGL_STIPPLEVARS
+	TGL_FILL_STATE_UNUSED
 
 #define INTERP_Z
 #define INTERP_RGB
@@ -209,20 +362,36 @@ void ZB_fillTriangleSmooth(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBuf
 #define DRAW_INIT()                                                                                                                                            \
 	{}
 
+/* there is no blending in 1 bit mode, spans are drawn whole by DRAW_SPAN like the NOBLEND fill does */
 #define PUT_PIXEL(_a)                                                                                                                                          \
 	{}
 
+#undef SPAN_1B_COLOR
+#undef SPAN_1B_STEP
+#define SPAN_1B_COLOR RGB_TO_PIXEL(or1, og1, ob1)
+#define SPAN_1B_STEP()                                                                                                                                         \
+	{                                                                                                                                                          \
+		og1 += dgdx;                                                                                                                                           \
+		or1 += drdx;                                                                                                                                           \
+		ob1 += dbdx;                                                                                                                                           \
+	}
+#define DRAW_SPAN(x, y) DRAW_SPAN_1B(x, y)
 
 #endif
 
+#if TGL_FEATURE_HALFSPACE_RASTER == 1
+	if (zb->raster_backend == ZB_BACKEND_HALFSPACE) {
+#include "ztriangle_hs.h"
+		return;
+	}
+#endif
 #include "ztriangle.h"
 } 
 
-void ZB_fillTriangleSmoothNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+static TGL_FILL_INLINE void gl_fillTriangleSmoothNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2, TGL_FILL_STATE_PARAMS) {
 
-	GLubyte zbdw = zb->depth_write;
-	GLubyte zbdt = zb->depth_test;
 	TGL_STIPPLEVARS
+	TGL_FILL_STATE_UNUSED
 
 #define INTERP_Z
 #define INTERP_RGB
@@ -296,26 +465,31 @@ void ZB_fillTriangleSmoothNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p
 #define DRAW_INIT()                                                                  \
 	{}
 
+/* spans are drawn whole by DRAW_SPAN */
 #define PUT_PIXEL(_a)                                                                \
+	{}
+
+#undef SPAN_1B_COLOR
+#undef SPAN_1B_STEP
+#define SPAN_1B_COLOR RGB_TO_PIXEL(or1, og1, ob1)
+#define SPAN_1B_STEP()                                                               \
 	{                                                                                \
-		{                                                                            \
-			register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                          \
-			if (ZCMPSIMP(zz, pz[_a], _a, 0)) {                                       \
-				PUT_PIXEL_1B((GLuint)(pp + _a), RGB_TO_PIXEL(or1, og1, ob1));        \
-				if (zbdw)                                                            \
-					pz[_a] = zz;                                                     \
-			}                                                                        \
-		}                                                                            \
-		z += dzdx;                                                                   \
 		og1 += dgdx;                                                                 \
 		or1 += drdx;                                                                 \
 		ob1 += dbdx;                                                                 \
 	}
+#define DRAW_SPAN(x, y) DRAW_SPAN_1B(x, y)
 
 
 #endif
 
 /* End of 1 bit mode stuff*/
+#if TGL_FEATURE_HALFSPACE_RASTER == 1
+	if (zb->raster_backend == ZB_BACKEND_HALFSPACE) {
+#include "ztriangle_hs.h"
+		return;
+	}
+#endif
 #include "ztriangle.h"
 } 
 
@@ -329,89 +503,356 @@ void ZB_fillTriangleSmoothNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p
 
 
 */
-void ZB_setTexture(ZBuffer* zb, PIXEL* texture) { zb->current_texture = texture; }
+/* Samples texture from pixmap, 2^xsize_log2 x 2^ysize_log2 pixels, in the layout set in texture. */
+static void gl_texture_level(ZBTexture* texture, PIXEL* pixmap, GLint xsize_log2, GLint ysize_log2) {
+	/* the shifts that make S and T texel columns and rows */
+	GLint s_texel = ZB_POINT_S_FRAC_BITS + 1 + TGL_FEATURE_TEXTURE_POW2 - xsize_log2;
+	GLint t_texel = ZB_POINT_T_FRAC_BITS + 1 + TGL_FEATURE_TEXTURE_POW2 - ysize_log2;
+#if TGL_FEATURE_TEXTURE_TILES == 1
+	/* rows are tiles as wide and tall as the texture, whose tile masks are 0 */
+	GLint tw = (!texture->tiled || xsize_log2 < 2) ? xsize_log2 : 2;
+	GLint th = (!texture->tiled || ysize_log2 < 2) ? ysize_log2 : 2;
+	texture->s_tile_shift = s_texel - th;
+	texture->s_tile_mask = (((1 << xsize_log2) - 1) & ~((1 << tw) - 1)) << th;
+	texture->t_tile_shift = t_texel - xsize_log2;
+	texture->t_tile_mask = (((1 << ysize_log2) - 1) & ~((1 << th) - 1)) << xsize_log2;
+#else
+	GLint tw = xsize_log2, th = ysize_log2;
+#endif
+	texture->pixmap = pixmap;
+	texture->s_shift = s_texel;
+	texture->s_mask = (1 << tw) - 1;
+	texture->t_shift = t_texel - tw;
+	texture->t_mask = ((1 << th) - 1) << tw;
+}
+
+void ZB_setTexture(ZBuffer* zb, PIXEL** levels, GLint level_count, GLint xsize_log2, GLint ysize_log2, GLint tiled) {
+	/* a texture without an image is black, like the zeroed images textures were made with */
+	static PIXEL no_texel = 0;
+	static PIXEL* no_levels[1] = {&no_texel};
+	ZBTexture* t = &zb->current_texture;
+#if TGL_FEATURE_MIPMAPS == 1
+	GLint i;
+#endif
+	if (level_count == 0 || levels[0] == NULL) {
+		levels = no_levels;
+		level_count = 1;
+		xsize_log2 = ysize_log2 = 0;
+	}
+#if TGL_FEATURE_TEXTURE_TILES == 1
+	t->tiled = tiled;
+#endif
+	gl_texture_level(t, levels[0], xsize_log2, ysize_log2);
+#if TGL_FEATURE_MIPMAPS == 1
+	for (i = 0; i < level_count; i++)
+		t->levels[i] = levels[i];
+	t->level_count = level_count;
+	t->xsize_log2 = xsize_log2;
+	t->ysize_log2 = ysize_log2;
+#endif
+}
 
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+void ZB_setTexturePalette(ZBuffer* zb, PIXEL* palette, GLint size, GLint index_bits) {
+	static PIXEL no_color = 0;
+	ZBTexture* t = &zb->current_texture;
+	if (palette == NULL) {
+		palette = &no_color;
+		size = 1;
+	}
+	t->palette = palette;
+	t->index_shift = (index_bits == 4);
+	t->index_mask = (GLuint)(size - 1) & (0xff >> (t->index_shift << 2));
+}
+
+/* zbindexed is a constant in each copy of the textured fills, see gl_fillTriangleMappingIndexed() */
+#define FILL_TEXTURE_SAMPLE(texture, s, t) (zbindexed ? TEXTURE_SAMPLE_INDEXED(texture, s, t) : TEXTURE_SAMPLE(texture, s, t))
+#else
+#define FILL_TEXTURE_SAMPLE(texture, s, t) TEXTURE_SAMPLE(texture, s, t)
+#endif
+
+#if TGL_FEATURE_MIPMAPS == 1
+/*
+Samples texture from the mip level nearest to one texel per pixel on the triangle p0 p1 p2, like GL_NEAREST_MIPMAP_NEAREST
+with the S and T derivatives of the whole triangle. fdx1, fdy1, fdx2 and fdy2 are its edges from p0 over its doubled area.
+*/
+static void gl_texture_lod(ZBTexture* texture, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2, GLfloat fdx1, GLfloat fdy1, GLfloat fdx2,
+						   GLfloat fdy2) {
+	/* S and T to texels of levels[0] */
+	GLfloat s_scale = (GLfloat)(1 << texture->xsize_log2) / ((GLfloat)(1 << (ZB_POINT_S_FRAC_BITS + 1)) * TGL_FEATURE_TEXTURE_DIM);
+	GLfloat t_scale = (GLfloat)(1 << texture->ysize_log2) / ((GLfloat)(1 << (ZB_POINT_T_FRAC_BITS + 1)) * TGL_FEATURE_TEXTURE_DIM);
+	GLfloat ds1 = ((GLfloat)p1->s - (GLfloat)p0->s) * s_scale, ds2 = ((GLfloat)p2->s - (GLfloat)p0->s) * s_scale;
+	GLfloat dt1 = ((GLfloat)p1->t - (GLfloat)p0->t) * t_scale, dt2 = ((GLfloat)p2->t - (GLfloat)p0->t) * t_scale;
+	GLfloat dsdx = fdy2 * ds1 - fdy1 * ds2, dtdx = fdy2 * dt1 - fdy1 * dt2;
+	GLfloat dsdy = fdx1 * ds2 - fdx2 * ds1, dtdy = fdx1 * dt2 - fdx2 * dt1;
+	GLfloat rho2x = dsdx * dsdx + dtdx * dtdx, rho2y = dsdy * dsdy + dtdy * dtdy;
+	/* the level is log2(rho) rounded, which is log2(2 * rho^2) / 2 rounded down */
+	GLfloat r = 2 * ((rho2x > rho2y) ? rho2x : rho2y);
+	GLint level = 0;
+	while (level < texture->level_count - 1 && r >= 4) {
+		r *= 0.25f;
+		level++;
+	}
+	if (level > 0)
+		gl_texture_level(texture, texture->levels[level], (texture->xsize_log2 > level) ? texture->xsize_log2 - level : 0,
+						 (texture->ysize_log2 > level) ? texture->ysize_log2 - level : 0);
+}
+#define TEXTURE_INIT()                                                                                                                                         \
+	{                                                                                                                                                          \
+		texture = zb->current_texture;                                                                                                                         \
+		if (texture.level_count > 1)                                                                                                                           \
+			gl_texture_lod(&texture, p0, p1, p2, fdx1, fdy1, fdx2, fdy2);                                                                                      \
+	}
+#else
+#define TEXTURE_INIT() texture = zb->current_texture;
+#endif
+
+void ZB_setRasterBackend(ZBuffer* zb, GLint backend) {
+#if TGL_FEATURE_TILED_RASTER == 1
+	/* binned triangles are drawn with the backend that is current when they are flushed */
+	ZB_flushTiles(zb);
+#endif
+#if TGL_FEATURE_HALFSPACE_RASTER == 1
+	zb->raster_backend = backend;
+#endif
+}
+
+
+void ZB_setClipRect(ZBuffer* zb, GLint xmin, GLint ymin, GLint xmax, GLint ymax) {
+	if (xmin < 0)
+		xmin = 0;
+	if (ymin < 0)
+		ymin = 0;
+	if (xmax > zb->xsize)
+		xmax = zb->xsize;
+	if (ymax > zb->ysize)
+		ymax = zb->ysize;
+	if (xmin == zb->clip_xmin && ymin == zb->clip_ymin && xmax == zb->clip_xmax && ymax == zb->clip_ymax)
+		return;
+#if TGL_FEATURE_TILED_RASTER == 1
+	/* binned triangles are drawn with the clip rectangle that is current when they are flushed */
+	ZB_flushTiles(zb);
+#endif
+	zb->clip_xmin = xmin;
+	zb->clip_ymin = ymin;
+	zb->clip_xmax = xmax;
+	zb->clip_ymax = ymax;
+}
+
+#if TGL_FEATURE_FAST_CLEAR == 1 || TGL_FEATURE_DIRTY_RECTS == 1
+void ZB_touchTriangle(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+	GLint xmin, xmax, ymin, ymax;
+	xmin = xmax = p0->x;
+	ymin = ymax = p0->y;
+	if (p1->x < xmin) xmin = p1->x;
+	if (p1->x > xmax) xmax = p1->x;
+	if (p2->x < xmin) xmin = p2->x;
+	if (p2->x > xmax) xmax = p2->x;
+	if (p1->y < ymin) ymin = p1->y;
+	if (p1->y > ymax) ymax = p1->y;
+	if (p2->y < ymin) ymin = p2->y;
+	if (p2->y > ymax) ymax = p2->y;
+	/* The scanline rasterizer may round a span one pixel past the bounding box. */
+	xmin--;
+	xmax++;
+	if (xmin < zb->clip_xmin) xmin = zb->clip_xmin;
+	if (ymin < zb->clip_ymin) ymin = zb->clip_ymin;
+	if (xmax >= zb->clip_xmax) xmax = zb->clip_xmax - 1;
+	if (ymax >= zb->clip_ymax) ymax = zb->clip_ymax - 1;
+	ZB_touchRect(zb, xmin, ymin, xmax + 1, ymax + 1);
+}
+#endif
 
 #if 1
 
+#define DRAW_LINE_TRI_TEXTURED_ST()                                                                            \
+	{                                                                                                             \
+		GLfloat ss, tt;                                                                                              \
+		ss = (sz * zinv);                                                                                            \
+		tt = (tz * zinv);                                                                                            \
+		s = (GLint)ss;                                                                                               \
+		t = (GLint)tt;                                                                                               \
+		dsdx = (GLint)((dszdx - ss * fdzdx) * zinv);                                                                 \
+		dtdx = (GLint)((dtzdx - tt * fdzdx) * zinv);                                                                 \
+	}
+
 #if TGL_FEATURE_RENDER_BITS == 1
 
-#define DRAW_LINE_TRI_TEXTURED()
+/* s, t and their steps for the NB_INTERP pixels from the current one, moving sz, tz and zinv to the next block */
+#define DRAW_LINE_TRI_TEXTURED_BLOCK()                                                                       \
+	{                                                                                                            \
+		DRAW_LINE_TRI_TEXTURED_ST()                                                                                 \
+		fzl += fndzdx;                                                                                              \
+		zinv = 1.0 / fzl;                                                                                           \
+		sz += ndszdx;                                                                                               \
+		tz += ndtzdx;                                                                                               \
+	}
+
+/*
+ * The 1 bit textured span goes through the packed span writer. The perspective correction is redone every
+ * NB_INTERP pixels from x1 as in the other modes, k counting the pixels of the current block. The texels are
+ * 8 bit luminance (see gl_convertRGB_to_L8()), scaled by the interpolated intensity before being dithered.
+ */
+#undef SPAN_1B_COLOR
+#undef SPAN_1B_STEP
+#define SPAN_1B_COLOR RGB_MIX_FUNC(or1, og1, ob1, FILL_TEXTURE_SAMPLE(texture, s, t))
+#define SPAN_1B_STEP()                                                                                       \
+	{                                                                                                            \
+		s += dsdx;                                                                                                  \
+		t += dtdx;                                                                                                  \
+		OR1G1B1INCR                                                                                                 \
+		if (++k == NB_INTERP) {                                                                                     \
+			k = 0;                                                                                                     \
+			DRAW_LINE_TRI_TEXTURED_BLOCK()                                                                             \
+		}                                                                                                           \
+	}
+
+#define DRAW_LINE_TRI_TEXTURED()                                                                             \
+	{                                                                                                            \
+		register GLushort* pz;                                                                                      \
+		register GLint pp;                                                                                          \
+		register GLuint s, t, z;                                                                                    \
+		register GLint n, skip, k;                                                                                  \
+		register GLint dsdx, dtdx;                                                                                  \
+		OR1OG1OB1DECL                                                                                               \
+		GLfloat sz, tz, fzl, zinv;                                                                                  \
+		n = xr - x1;                                                                                                \
+		skip = xl - x1;                                                                                             \
+		fzl = (GLfloat)z1;                                                                                          \
+		zinv = 1.0 / fzl;                                                                                           \
+		pp = pp1 + x1;                                                                                              \
+		pz = pz1 + x1;                                                                                              \
+		z = z1;                                                                                                     \
+		sz = sz1;                                                                                                   \
+		tz = tz1;                                                                                                   \
+		while (skip >= NB_INTERP) {                                                                                 \
+			fzl += fndzdx;                                                                                             \
+			zinv = 1.0 / fzl;                                                                                          \
+			z += NB_INTERP * dzdx;                                                                                     \
+			OR1G1B1SKIP(NB_INTERP)                                                                                     \
+			pz += NB_INTERP;                                                                                           \
+			pp += NB_INTERP;                                                                                           \
+			n -= NB_INTERP;                                                                                            \
+			skip -= NB_INTERP;                                                                                         \
+			sz += ndszdx;                                                                                              \
+			tz += ndtzdx;                                                                                              \
+		}                                                                                                           \
+		DRAW_LINE_TRI_TEXTURED_BLOCK()                                                                              \
+		for (k = 0; k < skip; k++) {                                                                                \
+			z += dzdx;                                                                                                 \
+			s += dsdx;                                                                                                 \
+			t += dtdx;                                                                                                 \
+			OR1G1B1INCR                                                                                                \
+			pz++;                                                                                                      \
+			pp++;                                                                                                      \
+			n--;                                                                                                       \
+		}                                                                                                           \
+		DRAW_SPAN_1B(xl, cur_y)                                                                                     \
+	}
 
 #else
 
+/* Pixels left of the clip rectangle (skip) are stepped over without being drawn.
+   Whole NB_INTERP blocks are skipped at once, so the perspective correction of the
+   visible pixels stays the same as if the span had not been clipped. */
 #define DRAW_LINE_TRI_TEXTURED()                                                                               \
-	{                                                                                                          \
-		register GLushort* pz;                                                                                 \
-		register PIXEL* pp;                                                                                    \
-		register GLuint s, t, z;                                                                               \
-		register GLint n;                                                                                      \
-		OR1OG1OB1DECL                                                                                          \
-		GLfloat sz, tz, fzl, zinv;                                                                             \
-		n = (x2 >> 16) - x1;                                                                                   \
-		fzl = (GLfloat)z1;                                                                                     \
-		zinv = 1.0 / fzl;                                                                                      \
-		pp = (PIXEL*)((GLbyte*)pp1 + x1 * PSZB);                                                               \
-		pz = pz1 + x1;                                                                                         \
-		z = z1;                                                                                                \
-		sz = sz1;                                                                                              \
-		tz = tz1;                                                                                              \
-		while (n >= (NB_INTERP - 1)) {                                                                         \
-			register GLint dsdx, dtdx;                                                                         \
-			{                                                                                                  \
-				GLfloat ss, tt;                                                                                \
-				ss = (sz * zinv);                                                                              \
-				tt = (tz * zinv);                                                                              \
-				s = (GLint)ss;                                                                                 \
-				t = (GLint)tt;                                                                                 \
-				dsdx = (GLint)((dszdx - ss * fdzdx) * zinv);                                                   \
-				dtdx = (GLint)((dtzdx - tt * fdzdx) * zinv);                                                   \
-			}                                                                                                  \
-			fzl += fndzdx;                                                                                     \
-			zinv = 1.0 / fzl;                                                                                  \
-			PUT_PIXEL(0); /*the_x++;*/                                                                         \
-			PUT_PIXEL(1); /*the_x++;*/                                                                         \
-			PUT_PIXEL(2); /*the_x++;*/                                                                         \
-			PUT_PIXEL(3); /*the_x++;*/                                                                         \
-			PUT_PIXEL(4); /*the_x++;*/                                                                         \
-			PUT_PIXEL(5); /*the_x++;*/                                                                         \
-			PUT_PIXEL(6); /*the_x++;*/                                                                         \
-			PUT_PIXEL(7); /*the_x-=7;*/                                                                        \
-			pz += NB_INTERP;                                                                                   \
-			pp += NB_INTERP; /*the_x+=NB_INTERP * PSZB;*/                                                      \
-			n -= NB_INTERP;                                                                                    \
-			sz += ndszdx;                                                                                      \
-			tz += ndtzdx;                                                                                      \
-		}                                                                                                      \
-		{                                                                                                      \
-			register GLint dsdx, dtdx;                                                                         \
-			{                                                                                                  \
-				GLfloat ss, tt;                                                                                \
-				ss = (sz * zinv);                                                                              \
-				tt = (tz * zinv);                                                                              \
-				s = (GLint)ss;                                                                                 \
-				t = (GLint)tt;                                                                                 \
-				dsdx = (GLint)((dszdx - ss * fdzdx) * zinv);                                                   \
-				dtdx = (GLint)((dtzdx - tt * fdzdx) * zinv);                                                   \
-			}                                                                                                  \
-			while (n >= 0) {                                                                                   \
-				PUT_PIXEL(0);                                                                                  \
-				pz += 1;                                                                                       \
-				/*pp = (PIXEL*)((GLbyte*)pp + PSZB);*/                                                         \
-				pp++;                                                                                          \
-				n -= 1;                                                                                        \
-			}                                                                                                  \
-		}                                                                                                      \
+	{                                                                                                             \
+		register GLushort* pz;                                                                                       \
+		register PIXEL* pp;                                                                                          \
+		register GLuint s, t, z;                                                                                     \
+		register GLint n, skip;                                                                                      \
+		OR1OG1OB1DECL                                                                                                \
+		GLfloat sz, tz, fzl, zinv;                                                                                   \
+		n = xr - x1;                                                                                                 \
+		skip = xl - x1;                                                                                              \
+		fzl = (GLfloat)z1;                                                                                           \
+		zinv = 1.0 / fzl;                                                                                            \
+		pp = (PIXEL*)((GLbyte*)pp1 + x1 * PSZB);                                                                     \
+		pz = pz1 + x1;                                                                                               \
+		z = z1;                                                                                                      \
+		sz = sz1;                                                                                                    \
+		tz = tz1;                                                                                                    \
+		while (skip >= NB_INTERP) {                                                                                  \
+			fzl += fndzdx;                                                                                              \
+			zinv = 1.0 / fzl;                                                                                           \
+			z += NB_INTERP * dzdx;                                                                                      \
+			OR1G1B1SKIP(NB_INTERP)                                                                                      \
+			pz += NB_INTERP;                                                                                            \
+			pp += NB_INTERP;                                                                                            \
+			n -= NB_INTERP;                                                                                             \
+			skip -= NB_INTERP;                                                                                          \
+			sz += ndszdx;                                                                                               \
+			tz += ndtzdx;                                                                                               \
+		}                                                                                                            \
+		if (skip > 0 && n >= (NB_INTERP - 1)) {                                                                      \
+			register GLint dsdx, dtdx, k;                                                                               \
+			DRAW_LINE_TRI_TEXTURED_ST()                                                                                 \
+			fzl += fndzdx;                                                                                              \
+			zinv = 1.0 / fzl;                                                                                           \
+			for (k = 0; k < skip; k++) {                                                                                \
+				z += dzdx;                                                                                                 \
+				s += dsdx;                                                                                                 \
+				t += dtdx;                                                                                                 \
+				OR1G1B1INCR                                                                                                \
+			}                                                                                                           \
+			for (; k < NB_INTERP; k++)                                                                                  \
+				PUT_PIXEL(k);                                                                                              \
+			pz += NB_INTERP;                                                                                            \
+			pp += NB_INTERP;                                                                                            \
+			n -= NB_INTERP;                                                                                             \
+			sz += ndszdx;                                                                                               \
+			tz += ndtzdx;                                                                                               \
+			skip = 0;                                                                                                   \
+		}                                                                                                            \
+		while (n >= (NB_INTERP - 1)) {                                                                               \
+			register GLint dsdx, dtdx;                                                                                  \
+			DRAW_LINE_TRI_TEXTURED_ST()                                                                                 \
+			fzl += fndzdx;                                                                                              \
+			zinv = 1.0 / fzl;                                                                                           \
+			PUT_PIXEL(0); /*the_x++;*/                                                                                  \
+			PUT_PIXEL(1); /*the_x++;*/                                                                                  \
+			PUT_PIXEL(2); /*the_x++;*/                                                                                  \
+			PUT_PIXEL(3); /*the_x++;*/                                                                                  \
+			PUT_PIXEL(4); /*the_x++;*/                                                                                  \
+			PUT_PIXEL(5); /*the_x++;*/                                                                                  \
+			PUT_PIXEL(6); /*the_x++;*/                                                                                  \
+			PUT_PIXEL(7); /*the_x-=7;*/                                                                                 \
+			pz += NB_INTERP;                                                                                            \
+			pp += NB_INTERP; /*the_x+=NB_INTERP * PSZB;*/                                                               \
+			n -= NB_INTERP;                                                                                             \
+			sz += ndszdx;                                                                                               \
+			tz += ndtzdx;                                                                                               \
+		}                                                                                                            \
+		{                                                                                                            \
+			register GLint dsdx, dtdx;                                                                                  \
+			DRAW_LINE_TRI_TEXTURED_ST()                                                                                 \
+			while (skip > 0) {                                                                                          \
+				z += dzdx;                                                                                                 \
+				s += dsdx;                                                                                                 \
+				t += dtdx;                                                                                                 \
+				OR1G1B1INCR                                                                                                \
+				pz += 1;                                                                                                   \
+				pp++;                                                                                                      \
+				n -= 1;                                                                                                    \
+				skip -= 1;                                                                                                 \
+			}                                                                                                           \
+			while (n >= 0) {                                                                                            \
+				PUT_PIXEL(0);                                                                                              \
+				pz += 1;                                                                                                   \
+				/*pp = (PIXEL*)((GLbyte*)pp + PSZB);*/                                                                     \
+				pp++;                                                                                                      \
+				n -= 1;                                                                                                    \
+			}                                                                                                           \
+		}                                                                                                            \
 	}
 #endif
 
-void ZB_fillTriangleMappingPerspective(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
-	PIXEL* texture;
+static TGL_FILL_INLINE void gl_fillTriangleMapping(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2, TGL_FILL_STATE_PARAMS,
+											   const GLubyte zbindexed) {
+	ZBTexture texture;
 
-	GLubyte zbdw = zb->depth_write;
-	GLubyte zbdt = zb->depth_test;
-	TGL_BLEND_VARS
 	TGL_STIPPLEVARS
+	TGL_FILL_STATE_UNUSED
 #define INTERP_Z
 #define INTERP_STZ
 #define INTERP_RGB
@@ -421,7 +862,7 @@ void ZB_fillTriangleMappingPerspective(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoi
 
 #define DRAW_INIT()                                                                                                                                            \
 	{                                                                                                                                                          \
-		texture = zb->current_texture;                                                                                                                         \
+		TEXTURE_INIT()                                                                                                                                         \
 		fdzdx = (GLfloat)dzdx;                                                                                                                                 \
 		fndzdx = NB_INTERP * fdzdx;                                                                                                                            \
 		ndszdx = NB_INTERP * dszdx;                                                                                                                            \
@@ -437,9 +878,14 @@ void ZB_fillTriangleMappingPerspective(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoi
 	og1 += dgdx;                                                                                                                                               \
 	or1 += drdx;                                                                                                                                               \
 	ob1 += dbdx;
+#define OR1G1B1SKIP(_n)                                                                                                                                        \
+	og1 += (_n) * dgdx;                                                                                                                                        \
+	or1 += (_n) * drdx;                                                                                                                                        \
+	ob1 += (_n) * dbdx;
 #else
 #define OR1OG1OB1DECL /*A comment*/
 #define OR1G1B1INCR   /*Another comment*/
+#define OR1G1B1SKIP(_n) /*Yet another comment*/
 #define or1 COLOR_MULT_MASK
 #define og1 COLOR_MULT_MASK
 #define ob1 COLOR_MULT_MASK
@@ -451,8 +897,8 @@ void ZB_fillTriangleMappingPerspective(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoi
 		{                                                                                                                                                      \
 			register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                                                                                                    \
 			if (ZCMPSIMP(zz, pz[_a], _a, 0)) {                                                                                                                 \
-				/*pp[_a] = RGB_MIX_FUNC(or1, og1, ob1, TEXTURE_SAMPLE(texture, s, t));*/                                                                       \
-				TGL_BLEND_FUNC(RGB_MIX_FUNC(or1, og1, ob1, (TEXTURE_SAMPLE(texture, s, t))), (pp[_a]));                                                        \
+				/*pp[_a] = RGB_MIX_FUNC(or1, og1, ob1, FILL_TEXTURE_SAMPLE(texture, s, t));*/                                                                  \
+				TGL_BLEND_FUNC(RGB_MIX_FUNC(or1, og1, ob1, (FILL_TEXTURE_SAMPLE(texture, s, t))), (pp[_a]));                                                   \
 				if (zbdw)                                                                                                                                      \
 					pz[_a] = zz;                                                                                                                               \
 			}                                                                                                                                                  \
@@ -467,7 +913,7 @@ void ZB_fillTriangleMappingPerspective(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoi
 	{                                                                                                                                                          \
 		{                                                                                                                                                      \
 			register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                                                                                                    \
-			PIXEL c = TEXTURE_SAMPLE(texture, s, t);                                                                                                           \
+			PIXEL c = FILL_TEXTURE_SAMPLE(texture, s, t);                                                                                                      \
 			if (ZCMP(zz, pz[_a], _a, c)) {                                                                                                                     \
 				TGL_BLEND_FUNC(RGB_MIX_FUNC(or1, og1, ob1, c), (pp[_a]));                                                                                      \
 				if (zbdw)                                                                                                                                      \
@@ -483,15 +929,21 @@ void ZB_fillTriangleMappingPerspective(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoi
 #define DRAW_LINE()                                                                                                                                            \
 	{ DRAW_LINE_TRI_TEXTURED() }
 
+#if TGL_FEATURE_HALFSPACE_RASTER == 1 && TGL_FEATURE_RENDER_BITS != 1
+	if (zb->raster_backend == ZB_BACKEND_HALFSPACE) {
+#include "ztriangle_hs.h"
+		return;
+	}
+#endif
 #include "ztriangle.h"
 }
 
-void ZB_fillTriangleMappingPerspectiveNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
-	PIXEL* texture;
+static TGL_FILL_INLINE void gl_fillTriangleMappingNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2, TGL_FILL_STATE_PARAMS,
+													  const GLubyte zbindexed) {
+	ZBTexture texture;
 	
-	GLubyte zbdw = zb->depth_write;
-	GLubyte zbdt = zb->depth_test;
 	TGL_STIPPLEVARS
+	TGL_FILL_STATE_UNUSED
 #define INTERP_Z
 #define INTERP_STZ
 #define INTERP_RGB
@@ -500,7 +952,7 @@ void ZB_fillTriangleMappingPerspectiveNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBu
 
 #define DRAW_INIT()                                                                                                                                            \
 	{                                                                                                                                                          \
-		texture = zb->current_texture;                                                                                                                         \
+		TEXTURE_INIT()                                                                                                                                         \
 		fdzdx = (GLfloat)dzdx;                                                                                                                                 \
 		fndzdx = NB_INTERP * fdzdx;                                                                                                                            \
 		ndszdx = NB_INTERP * dszdx;                                                                                                                            \
@@ -516,9 +968,14 @@ void ZB_fillTriangleMappingPerspectiveNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBu
 	og1 += dgdx;                                                                                                                                               \
 	or1 += drdx;                                                                                                                                               \
 	ob1 += dbdx;
+#define OR1G1B1SKIP(_n)                                                                                                                                        \
+	og1 += (_n) * dgdx;                                                                                                                                        \
+	or1 += (_n) * drdx;                                                                                                                                        \
+	ob1 += (_n) * dbdx;
 #else
 #define OR1OG1OB1DECL /*A comment*/
 #define OR1G1B1INCR   /*Another comment*/
+#define OR1G1B1SKIP(_n) /*Yet another comment*/
 #define or1 COLOR_MULT_MASK
 #define og1 COLOR_MULT_MASK
 #define ob1 COLOR_MULT_MASK
@@ -529,7 +986,7 @@ void ZB_fillTriangleMappingPerspectiveNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBu
 		{                                                                                                                                                      \
 			register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                                                                                                    \
 			if (ZCMPSIMP(zz, pz[_a], _a, 0)) {                                                                                                                 \
-				pp[_a] = RGB_MIX_FUNC(or1, og1, ob1, TEXTURE_SAMPLE(texture, s, t));                                                                           \
+				pp[_a] = RGB_MIX_FUNC(or1, og1, ob1, FILL_TEXTURE_SAMPLE(texture, s, t));                                                                      \
 				if (zbdw)                                                                                                                                      \
 					pz[_a] = zz;                                                                                                                               \
 			}                                                                                                                                                  \
@@ -544,7 +1001,7 @@ void ZB_fillTriangleMappingPerspectiveNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBu
 	{                                                                                                                                                          \
 		{                                                                                                                                                      \
 			register GLuint zz = z >> ZB_POINT_Z_FRAC_BITS;                                                                                                    \
-			PIXEL c = TEXTURE_SAMPLE(texture, s, t);                                                                                                           \
+			PIXEL c = FILL_TEXTURE_SAMPLE(texture, s, t);                                                                                                      \
 			if (ZCMP(zz, pz[_a], _a, c)) {                                                                                                                     \
 				pp[_a] = RGB_MIX_FUNC(or1, og1, ob1, c);                                                                                                       \
 				/*TGL_BLEND_FUNC(RGB_MIX_FUNC(or1, og1, ob1, c), (pp[_a]));*/                                                                                  \
@@ -560,7 +1017,202 @@ void ZB_fillTriangleMappingPerspectiveNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBu
 #endif
 #define DRAW_LINE()                                                                                                                                            \
 	{ DRAW_LINE_TRI_TEXTURED() }
+#if TGL_FEATURE_HALFSPACE_RASTER == 1 && TGL_FEATURE_RENDER_BITS != 1
+	if (zb->raster_backend == ZB_BACKEND_HALFSPACE) {
+#include "ztriangle_hs.h"
+		return;
+	}
+#endif
 #include "ztriangle.h"
 }
 
-#endif 
+#endif
+
+/* The textured fills, with PIXEL textures and with palettized ones. */
+#define TGL_FILL_STATE_ARGS zbdt, zbdw, zbdostipple, zbblendeq, sfactor, dfactor
+static TGL_FILL_INLINE void gl_fillTriangleMappingPerspective(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2, TGL_FILL_STATE_PARAMS) {
+	gl_fillTriangleMapping(zb, p0, p1, p2, TGL_FILL_STATE_ARGS, 0);
+}
+static TGL_FILL_INLINE void gl_fillTriangleMappingPerspectiveNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2, TGL_FILL_STATE_PARAMS) {
+	gl_fillTriangleMappingNOBLEND(zb, p0, p1, p2, TGL_FILL_STATE_ARGS, 0);
+}
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+static TGL_FILL_INLINE void gl_fillTriangleMappingIndexed(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2, TGL_FILL_STATE_PARAMS) {
+	gl_fillTriangleMapping(zb, p0, p1, p2, TGL_FILL_STATE_ARGS, 1);
+}
+static TGL_FILL_INLINE void gl_fillTriangleMappingIndexedNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2, TGL_FILL_STATE_PARAMS) {
+	gl_fillTriangleMappingNOBLEND(zb, p0, p1, p2, TGL_FILL_STATE_ARGS, 1);
+}
+#endif
+
+/* Fill with the current zbuffer state. */
+void ZB_fillTriangleFlat(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) { gl_fillTriangleFlat(zb, p0, p1, p2, TGL_FILL_STATE(zb)); }
+void ZB_fillTriangleFlatNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+	gl_fillTriangleFlatNOBLEND(zb, p0, p1, p2, TGL_FILL_STATE(zb));
+}
+void ZB_fillTriangleSmooth(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) { gl_fillTriangleSmooth(zb, p0, p1, p2, TGL_FILL_STATE(zb)); }
+void ZB_fillTriangleSmoothNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+	gl_fillTriangleSmoothNOBLEND(zb, p0, p1, p2, TGL_FILL_STATE(zb));
+}
+void ZB_fillTriangleMappingPerspective(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+	gl_fillTriangleMappingPerspective(zb, p0, p1, p2, TGL_FILL_STATE(zb));
+}
+void ZB_fillTriangleMappingPerspectiveNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+	gl_fillTriangleMappingPerspectiveNOBLEND(zb, p0, p1, p2, TGL_FILL_STATE(zb));
+}
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+void ZB_fillTriangleMappingIndexed(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+	gl_fillTriangleMappingIndexed(zb, p0, p1, p2, TGL_FILL_STATE(zb));
+}
+void ZB_fillTriangleMappingIndexedNOBLEND(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {
+	gl_fillTriangleMappingIndexedNOBLEND(zb, p0, p1, p2, TGL_FILL_STATE(zb));
+}
+#endif
+
+#if TGL_FEATURE_SPECIALIZED_FILLS >= 1
+/*
+ * Specialized fill functions, one per combination of depth test, depth write, stipple and (for the
+ * blending fills, with TGL_FEATURE_SPECIALIZED_FILLS 2) blend equation and factors. Blend states other
+ * than these fall back to index 0, which is what the blend functions do with them anyway.
+ */
+#define TGL_FILL_EQ_0 GL_FUNC_ADD
+#define TGL_FILL_EQ_1 GL_FUNC_SUBTRACT
+#define TGL_FILL_EQ_2 GL_FUNC_REVERSE_SUBTRACT
+#define TGL_FILL_SF_0 GL_ONE
+#define TGL_FILL_SF_1 GL_ONE_MINUS_SRC_COLOR
+#define TGL_FILL_SF_2 GL_ZERO
+#define TGL_FILL_DF_0 GL_ONE
+#define TGL_FILL_DF_1 GL_ONE_MINUS_DST_COLOR
+#define TGL_FILL_DF_2 GL_ZERO
+
+#define TGL_FILL_DEF(kind, dt, dw, st, eq, sf, df)                                                                  \
+	static void gl_fill##kind##_##dt##dw##st##eq##sf##df(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) { \
+		gl_fillTriangle##kind(zb, p0, p1, p2, dt, dw, st, TGL_FILL_EQ_##eq, TGL_FILL_SF_##sf, TGL_FILL_DF_##df);    \
+	}
+#define TGL_FILL_REF(kind, dt, dw, st, eq, sf, df) gl_fill##kind##_##dt##dw##st##eq##sf##df,
+
+/* Expands M for every state, in table order. B expands the blend states. */
+#define TGL_FILL_BLEND_DF(M, kind, dt, dw, st, eq, sf) M(kind, dt, dw, st, eq, sf, 0) M(kind, dt, dw, st, eq, sf, 1) M(kind, dt, dw, st, eq, sf, 2)
+#define TGL_FILL_BLEND_SF(M, kind, dt, dw, st, eq)                                                                  \
+	TGL_FILL_BLEND_DF(M, kind, dt, dw, st, eq, 0) TGL_FILL_BLEND_DF(M, kind, dt, dw, st, eq, 1) TGL_FILL_BLEND_DF(M, kind, dt, dw, st, eq, 2)
+#define TGL_FILL_BLEND(M, kind, dt, dw, st)                                                                         \
+	TGL_FILL_BLEND_SF(M, kind, dt, dw, st, 0) TGL_FILL_BLEND_SF(M, kind, dt, dw, st, 1) TGL_FILL_BLEND_SF(M, kind, dt, dw, st, 2)
+#define TGL_FILL_NOBLEND(M, kind, dt, dw, st) M(kind, dt, dw, st, 0, 0, 0)
+/* the blend state is passed through instead of being a constant */
+#define TGL_FILL_DEF_DYNBLEND(kind, dt, dw, st, eq, sf, df)                                                         \
+	static void gl_fill##kind##_##dt##dw##st(ZBuffer* zb, ZBufferPoint* p0, ZBufferPoint* p1, ZBufferPoint* p2) {      \
+		gl_fillTriangle##kind(zb, p0, p1, p2, dt, dw, st, zb->blendeq, zb->sfactor, zb->dfactor);                   \
+	}
+#define TGL_FILL_REF_DYNBLEND(kind, dt, dw, st, eq, sf, df) gl_fill##kind##_##dt##dw##st,
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+#define TGL_FILL_STIPPLE_STATES 2
+#define TGL_FILL_STIPPLE(M, B, kind, dt, dw) B(M, kind, dt, dw, 0) B(M, kind, dt, dw, 1)
+#else
+#define TGL_FILL_STIPPLE_STATES 1
+#define TGL_FILL_STIPPLE(M, B, kind, dt, dw) B(M, kind, dt, dw, 0)
+#endif
+#define TGL_FILL_DEPTH_WRITE(M, B, kind, dt) TGL_FILL_STIPPLE(M, B, kind, dt, 0) TGL_FILL_STIPPLE(M, B, kind, dt, 1)
+#define TGL_FILL_ALL(M, B, kind) TGL_FILL_DEPTH_WRITE(M, B, kind, 0) TGL_FILL_DEPTH_WRITE(M, B, kind, 1)
+
+#define TGL_FILL_TABLE(DEF, REF, B, kind)                                                                           \
+	TGL_FILL_ALL(DEF, B, kind)                                                                                      \
+	static const ZB_fillTriangleFunc gl_fill##kind##_table[] = {TGL_FILL_ALL(REF, B, kind)};
+
+TGL_FILL_TABLE(TGL_FILL_DEF, TGL_FILL_REF, TGL_FILL_NOBLEND, FlatNOBLEND)
+TGL_FILL_TABLE(TGL_FILL_DEF, TGL_FILL_REF, TGL_FILL_NOBLEND, SmoothNOBLEND)
+TGL_FILL_TABLE(TGL_FILL_DEF, TGL_FILL_REF, TGL_FILL_NOBLEND, MappingPerspectiveNOBLEND)
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+TGL_FILL_TABLE(TGL_FILL_DEF, TGL_FILL_REF, TGL_FILL_NOBLEND, MappingIndexedNOBLEND)
+#endif
+#if TGL_FEATURE_BLEND == 1
+#if TGL_FEATURE_SPECIALIZED_FILLS == 2
+TGL_FILL_TABLE(TGL_FILL_DEF, TGL_FILL_REF, TGL_FILL_BLEND, Flat)
+TGL_FILL_TABLE(TGL_FILL_DEF, TGL_FILL_REF, TGL_FILL_BLEND, Smooth)
+TGL_FILL_TABLE(TGL_FILL_DEF, TGL_FILL_REF, TGL_FILL_BLEND, MappingPerspective)
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+TGL_FILL_TABLE(TGL_FILL_DEF, TGL_FILL_REF, TGL_FILL_BLEND, MappingIndexed)
+#endif
+#else
+TGL_FILL_TABLE(TGL_FILL_DEF_DYNBLEND, TGL_FILL_REF_DYNBLEND, TGL_FILL_NOBLEND, Flat)
+TGL_FILL_TABLE(TGL_FILL_DEF_DYNBLEND, TGL_FILL_REF_DYNBLEND, TGL_FILL_NOBLEND, Smooth)
+TGL_FILL_TABLE(TGL_FILL_DEF_DYNBLEND, TGL_FILL_REF_DYNBLEND, TGL_FILL_NOBLEND, MappingPerspective)
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+TGL_FILL_TABLE(TGL_FILL_DEF_DYNBLEND, TGL_FILL_REF_DYNBLEND, TGL_FILL_NOBLEND, MappingIndexed)
+#endif
+#endif
+
+#if TGL_FEATURE_SPECIALIZED_FILLS == 2
+static GLint gl_fill_blend_index(GLuint v, GLuint v1, GLuint v2) { return (v == v1) ? 1 : ((v == v2) ? 2 : 0); }
+#endif
+#endif
+
+ZB_fillTriangleFunc ZB_getFillFunc(ZBuffer* zb, GLint kind) {
+	GLint i = ((zb->depth_test != 0) * 2 + (zb->depth_write != 0)) * TGL_FILL_STIPPLE_STATES;
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+	i += (zb->dostipple != 0);
+#endif
+#if TGL_FEATURE_BLEND == 1
+	if (zb->enable_blend) {
+#if TGL_FEATURE_SPECIALIZED_FILLS == 2
+		i = i * 27 + gl_fill_blend_index(zb->blendeq, GL_FUNC_SUBTRACT, GL_FUNC_REVERSE_SUBTRACT) * 9 +
+			gl_fill_blend_index(zb->sfactor, GL_ONE_MINUS_SRC_COLOR, GL_ZERO) * 3 + gl_fill_blend_index(zb->dfactor, GL_ONE_MINUS_DST_COLOR, GL_ZERO);
+#endif
+		switch (kind) {
+		case ZB_FILL_FLAT:
+			return gl_fillFlat_table[i];
+		case ZB_FILL_SMOOTH:
+			return gl_fillSmooth_table[i];
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+		case ZB_FILL_MAPPING_INDEXED:
+			return gl_fillMappingIndexed_table[i];
+#endif
+		default:
+			return gl_fillMappingPerspective_table[i];
+		}
+	}
+#endif
+	switch (kind) {
+	case ZB_FILL_FLAT:
+		return gl_fillFlatNOBLEND_table[i];
+	case ZB_FILL_SMOOTH:
+		return gl_fillSmoothNOBLEND_table[i];
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+	case ZB_FILL_MAPPING_INDEXED:
+		return gl_fillMappingIndexedNOBLEND_table[i];
+#endif
+	default:
+		return gl_fillMappingPerspectiveNOBLEND_table[i];
+	}
+}
+#else
+ZB_fillTriangleFunc ZB_getFillFunc(ZBuffer* zb, GLint kind) {
+#if TGL_FEATURE_BLEND == 1
+	if (zb->enable_blend) {
+		switch (kind) {
+		case ZB_FILL_FLAT:
+			return ZB_fillTriangleFlat;
+		case ZB_FILL_SMOOTH:
+			return ZB_fillTriangleSmooth;
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+		case ZB_FILL_MAPPING_INDEXED:
+			return ZB_fillTriangleMappingIndexed;
+#endif
+		default:
+			return ZB_fillTriangleMappingPerspective;
+		}
+	}
+#endif
+	switch (kind) {
+	case ZB_FILL_FLAT:
+		return ZB_fillTriangleFlatNOBLEND;
+	case ZB_FILL_SMOOTH:
+		return ZB_fillTriangleSmoothNOBLEND;
+#if TGL_FEATURE_INDEXED_TEXTURES == 1
+	case ZB_FILL_MAPPING_INDEXED:
+		return ZB_fillTriangleMappingIndexedNOBLEND;
+#endif
+	default:
+		return ZB_fillTriangleMappingPerspectiveNOBLEND;
+	}
+}
+#endif
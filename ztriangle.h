@@ -22,7 +22,12 @@ Things to keep in mind:
 {
 	GLfloat fdx1, fdx2, fdy1, fdy2;
 	GLushort* pz1;
+#if TGL_FEATURE_RENDER_BITS == 1
+	/* the 1 bit framebuffer is packed, so the row start is a pixel index, not a pointer */
+	GLint pp1;
+#else
 	PIXEL* pp1;
+#endif
 
 	GLint part;
 	GLint dx1, dy1, dx2, dy2;
@@ -33,6 +38,10 @@ Things to keep in mind:
 	GLint x1, dxdy_min, dxdy_max;
 	/* warning: x2 is multiplied by 2^16 */
 	GLint x2=0, dx2dy2=0;
+	/* clip rectangle, inclusive. Spans and lines outside of it are not drawn. */
+	GLint zbcx0 = zb->clip_xmin, zbcx1 = zb->clip_xmax - 1;
+	GLint zbcy0 = zb->clip_ymin, zbcy1 = zb->clip_ymax - 1;
+	GLint cur_y;
 
 #ifdef INTERP_Z
 	GLint z1, dzdx, dzdy, dzdl_min, dzdl_max;
@@ -69,6 +78,12 @@ Things to keep in mind:
 		p2 = t;
 	}
 
+	/* trivially reject triangles which are entirely outside of the clip rectangle */
+	if (p2->y < zbcy0 || p0->y > zbcy1)
+		return;
+	if ((p0->x < zbcx0 && p1->x < zbcx0 && p2->x < zbcx0) || (p0->x > zbcx1 && p1->x > zbcx1 && p2->x > zbcx1))
+		return;
+
 	/* we compute dXdx and dXdy for all GLinterpolated values */
 	fdx1 = p1->x - p0->x; 
 	fdy1 = p1->y - p0->y; 
@@ -164,9 +179,14 @@ Things to keep in mind:
 		}
 #endif
 	} 
+#if TGL_FEATURE_HIERARCHICAL_Z == 1 && defined(INTERP_Z)
+	/* skip triangles which are entirely behind what's already drawn */
+	if (zbdt && zb->hiz_min && ZB_hizTriangleOccluded(zb, p0, p1, p2, ZB_hizTriangleDepth(p0, p1, p2, dzdx, dzdy)))
+		return;
+#endif
 	/* screen coordinates */
 #if TGL_FEATURE_RENDER_BITS == 1
-	pp1 = (PIXEL*)(zb->xsize * p0->y); 
+	pp1 = zb->xsize * p0->y;
 #else
 	pp1 = (PIXEL*)(zb->pbuf) + zb->xsize * p0->y; 
 #endif
@@ -175,6 +195,7 @@ Things to keep in mind:
 	the_y = p0->y;
 #endif
 	pz1 = zb->zbuf + p0->y * zb->xsize;
+	cur_y = p0->y;
 
 	DRAW_INIT();
 	/*
@@ -185,6 +206,18 @@ Things to keep in mind:
 	 I'd also like to figure out if the main while() loop over raster lines can be OMP parallelized, but I suspect it isn't worth it.
 	*/
 	ZBufferPoint *pr1, *pr2, *l1, *l2; 
+#if TGL_FEATURE_HIERARCHICAL_Z == 1 && defined(INTERP_Z)
+/*
+ * Skips spans whose depth fails the test in every hierarchical z block they cover.
+ * z is linear along a span, so its larger end is the bound. Steep spans, where that end could
+ * overflow, are always drawn.
+ */
+#define HIZ_SPAN_VISIBLE()                                                                                                                                     \
+	&&!(zbdt && zb->hiz_min && dzdx > -(1 << 19) && dzdx < (1 << 19) &&                                                                                        \
+		ZB_hizOccluded(zb, xl, cur_y, xr, cur_y, (GLuint)(z1 + (((dzdx > 0) ? xr : xl) - x1) * dzdx) >> ZB_POINT_Z_FRAC_BITS, 0))
+#else
+#define HIZ_SPAN_VISIBLE() /* a comment */
+#endif
 	for (part = 0; part < 2; part++) {
 		GLint nb_lines;
 		{
@@ -286,11 +319,26 @@ Things to keep in mind:
 		/* we draw all the scan line of the part */
 
 		while (nb_lines > 0) {
+			register GLint xl, xr;
 			nb_lines--;
+			if (cur_y > zbcy1)
+				return;
+			/* clipped span: xl..xr inclusive. x1 is still the unclipped left edge. */
+			xl = x1;
+			xr = x2 >> 16;
+			if (xl < zbcx0)
+				xl = zbcx0;
+			if (xr > zbcx1)
+				xr = zbcx1;
+			if (cur_y >= zbcy0 && xl <= xr HIZ_SPAN_VISIBLE()) {
 #ifndef DRAW_LINE
 			/* generic draw line */
 			{
+#if TGL_FEATURE_RENDER_BITS == 1
+				register GLint pp;
+#else
 				register PIXEL* pp;
+#endif
 				register GLint n;
 #ifdef INTERP_Z
 				register GLushort* pz;
@@ -306,26 +354,29 @@ Things to keep in mind:
 				
 #endif
 
-				n = (x2 >> 16) - x1;
+				n = xr - xl;
 				
-				pp = (PIXEL*)pp1 + x1;
+				pp = pp1 + xl;
 #ifdef INTERP_Z
-				pz = pz1 + x1;
-				z = z1;
+				pz = pz1 + xl;
+				z = z1 + (xl - x1) * dzdx;
 #endif
 #ifdef INTERP_RGB
-				or1 = r1;
-				og1 = g1;
-				ob1 = b1;
+				or1 = r1 + (xl - x1) * drdx;
+				og1 = g1 + (xl - x1) * dgdx;
+				ob1 = b1 + (xl - x1) * dbdx;
 #endif
 #ifdef INTERP_ST
-				s = s1;
-				t = t1;
+				s = s1 + (xl - x1) * dsdx;
+				t = t1 + (xl - x1) * dtdx;
 #endif
 #ifdef INTERP_STZ
 
 
 #endif
+#ifdef DRAW_SPAN
+				DRAW_SPAN(xl, cur_y);
+#else
 				while (n >= 3) {
 					PUT_PIXEL(0); /*the_x++;*/
 					PUT_PIXEL(1); /*the_x++;*/
@@ -348,10 +399,16 @@ Things to keep in mind:
 					pp++;
 					n--;
 				}
+#endif
 			}
 #else
 			DRAW_LINE();
 #endif
+#if TGL_FEATURE_HIERARCHICAL_Z == 1 && defined(INTERP_Z)
+			if (zbdw && zb->hiz_min)
+				ZB_hizSpanWritten(zb, xl, xr, cur_y, zbdt);
+#endif
+			}
 
 			/* left edge */
 			error += derror;
@@ -404,6 +461,7 @@ Things to keep in mind:
 			the_y++;
 #endif
 			pz1 += zb->xsize;
+			cur_y++;
 		}
 	}
 }
@@ -415,4 +473,6 @@ Things to keep in mind:
 
 #undef DRAW_INIT
 #undef DRAW_LINE
+#undef DRAW_SPAN
+#undef HIZ_SPAN_VISIBLE
 #undef PUT_PIXEL
@@ -0,0 +1,349 @@
+/*
+ * Half-space (edge function) triangle rasterizer, the alternative backend to ztriangle.h.
+ * It is included by the ZB_fillTriangle* functions in ztriangle.c and uses the same INTERP_*, DRAW_INIT,
+ * PUT_PIXEL and DRAW_SPAN macros, so both backends write a covered pixel the same way.
+ * Coverage follows the top-left rule: a pixel exactly on a left or top edge is drawn, one on a right or
+ * bottom edge is not, so triangles sharing an edge never draw it twice.
+
+ The bounding box of the triangle is walked in HS_BLOCK x HS_BLOCK pixel blocks.
+ For every block the three edge functions are evaluated at its corners:
+ 1) If the block is outside of any edge it is skipped.
+ 2) If the block is inside of all edges, every row is drawn without any per-pixel edge test.
+ 3) Otherwise hs_row_mask() evaluates the edges for a whole row at once (SIMD where available), and the
+    covered run of that row is drawn. Triangles are convex, so the covered pixels of a row are contiguous.
+ Interpolated values come from the plane equations at the start of each run, instead of being
+ walked along the edges like the scanline rasterizer does.
+ */
+
+{
+	GLfloat fdx1, fdx2, fdy1, fdy2, fz;
+	GLint hs_xmin, hs_xmax, hs_ymin, hs_ymax, hs_bx, hs_by;
+	/* edge functions: e = a * x + b * y + c, inside when e >= 0 (c is biased by -1 on right and bottom edges) */
+	GLint hs_a[3], hs_b[3], hs_c[3];
+	/* offsets from the block origin to the corner of the block with the largest (acc) and smallest (rej) edge value */
+	GLint hs_acc[3], hs_rej[3];
+	TGL_ALIGN GLint hs_steps[3 * HS_BLOCK];
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+	GLint the_y;
+#endif
+#if TGL_FEATURE_RENDER_BITS == 1
+	/* the 1 bit framebuffer is packed, so the row start is a pixel index, not a pointer */
+	GLint pp1;
+#else
+	PIXEL* pp1;
+#endif
+#ifdef INTERP_Z
+	GLint dzdx, dzdy;
+	GLuint hs_z0;
+#if TGL_FEATURE_HIERARCHICAL_Z == 1
+	GLuint hs_hiz_z = 0xffffffff;
+#endif
+#endif
+#ifdef INTERP_RGB
+	GLint drdx, drdy, dgdx, dgdy, dbdx, dbdy;
+	GLuint hs_r0, hs_g0, hs_b0;
+#endif
+#ifdef INTERP_STZ
+	GLfloat dszdx, dszdy, dtzdx, dtzdy;
+	GLfloat fdzdx, fndzdx, ndszdx, ndtzdx;
+#endif
+
+	/* we sort the vertex with increasing y, like ztriangle.h, so DRAW_INIT() sees the same p2 */
+	if (p1->y < p0->y) {
+		ZBufferPoint* t = p0;
+		p0 = p1;
+		p1 = t;
+	}
+	if (p2->y < p0->y) {
+		ZBufferPoint* t = p2;
+		p2 = p1;
+		p1 = p0;
+		p0 = t;
+	} else if (p2->y < p1->y) {
+		ZBufferPoint* t = p1;
+		p1 = p2;
+		p2 = t;
+	}
+
+	/* bounding box, clipped */
+	hs_xmin = hs_xmax = p0->x;
+	if (p1->x < hs_xmin)
+		hs_xmin = p1->x;
+	if (p2->x < hs_xmin)
+		hs_xmin = p2->x;
+	if (p1->x > hs_xmax)
+		hs_xmax = p1->x;
+	if (p2->x > hs_xmax)
+		hs_xmax = p2->x;
+	hs_ymin = p0->y;
+	hs_ymax = p2->y;
+	if (hs_xmin < zb->clip_xmin)
+		hs_xmin = zb->clip_xmin;
+	if (hs_ymin < zb->clip_ymin)
+		hs_ymin = zb->clip_ymin;
+	if (hs_xmax >= zb->clip_xmax)
+		hs_xmax = zb->clip_xmax - 1;
+	if (hs_ymax >= zb->clip_ymax)
+		hs_ymax = zb->clip_ymax - 1;
+	if (hs_xmin > hs_xmax || hs_ymin > hs_ymax)
+		return;
+
+	/* edge functions, oriented so that the inside is positive */
+	{
+		ZBufferPoint* ev[4];
+		GLint i, k, area;
+		ev[0] = p0;
+		ev[1] = p1;
+		ev[2] = p2;
+		ev[3] = p0;
+		area = (p1->x - p0->x) * (p2->y - p0->y) - (p2->x - p0->x) * (p1->y - p0->y);
+		if (area == 0)
+			return;
+		for (i = 0; i < 3; i++) {
+			hs_a[i] = ev[i]->y - ev[i + 1]->y;
+			hs_b[i] = ev[i + 1]->x - ev[i]->x;
+			hs_c[i] = ev[i]->x * ev[i + 1]->y - ev[i]->y * ev[i + 1]->x;
+			if (area < 0) {
+				hs_a[i] = -hs_a[i];
+				hs_b[i] = -hs_b[i];
+				hs_c[i] = -hs_c[i];
+			}
+			/* top-left rule: the inside is to the right of a left edge (a > 0) and below a top edge (a == 0, b > 0) */
+			if (!(hs_a[i] > 0 || (hs_a[i] == 0 && hs_b[i] > 0)))
+				hs_c[i] -= 1;
+			hs_acc[i] = ((hs_a[i] > 0) ? hs_a[i] : 0) * (HS_BLOCK - 1) + ((hs_b[i] > 0) ? hs_b[i] : 0) * (HS_BLOCK - 1);
+			hs_rej[i] = ((hs_a[i] < 0) ? hs_a[i] : 0) * (HS_BLOCK - 1) + ((hs_b[i] < 0) ? hs_b[i] : 0) * (HS_BLOCK - 1);
+			for (k = 0; k < HS_BLOCK; k++)
+				hs_steps[i * HS_BLOCK + k] = k * hs_a[i];
+		}
+	}
+
+	/* we compute dXdx and dXdy for all interpolated values, the same way ztriangle.h does */
+	fdx1 = p1->x - p0->x;
+	fdy1 = p1->y - p0->y;
+	fdx2 = p2->x - p0->x;
+	fdy2 = p2->y - p0->y;
+	fz = fdx1 * fdy2 - fdx2 * fdy1;
+	if (fz != 0.0)
+		fz = 1.0 / fz;
+	fdx1 *= fz;
+	fdy1 *= fz;
+	fdx2 *= fz;
+	fdy2 *= fz;
+	{
+		GLfloat d1, d2;
+#ifdef INTERP_Z
+		d1 = p1->z - p0->z;
+		d2 = p2->z - p0->z;
+		dzdx = (GLint)(fdy2 * d1 - fdy1 * d2);
+		dzdy = (GLint)(fdx1 * d2 - fdx2 * d1);
+		/* plane equation origin, wrapping unsigned arithmetic is fine here */
+		hs_z0 = (GLuint)p0->z - (GLuint)p0->x * (GLuint)dzdx - (GLuint)p0->y * (GLuint)dzdy;
+#endif
+#ifdef INTERP_RGB
+		d1 = p1->r - p0->r;
+		d2 = p2->r - p0->r;
+		drdx = (GLint)(fdy2 * d1 - fdy1 * d2);
+		drdy = (GLint)(fdx1 * d2 - fdx2 * d1);
+		hs_r0 = (GLuint)p0->r - (GLuint)p0->x * (GLuint)drdx - (GLuint)p0->y * (GLuint)drdy;
+		d1 = p1->g - p0->g;
+		d2 = p2->g - p0->g;
+		dgdx = (GLint)(fdy2 * d1 - fdy1 * d2);
+		dgdy = (GLint)(fdx1 * d2 - fdx2 * d1);
+		hs_g0 = (GLuint)p0->g - (GLuint)p0->x * (GLuint)dgdx - (GLuint)p0->y * (GLuint)dgdy;
+		d1 = p1->b - p0->b;
+		d2 = p2->b - p0->b;
+		dbdx = (GLint)(fdy2 * d1 - fdy1 * d2);
+		dbdy = (GLint)(fdx1 * d2 - fdx2 * d1);
+		hs_b0 = (GLuint)p0->b - (GLuint)p0->x * (GLuint)dbdx - (GLuint)p0->y * (GLuint)dbdy;
+#endif
+#ifdef INTERP_STZ
+		p0->sz = (GLfloat)p0->s * (GLfloat)p0->z;
+		p0->tz = (GLfloat)p0->t * (GLfloat)p0->z;
+		p1->sz = (GLfloat)p1->s * (GLfloat)p1->z;
+		p1->tz = (GLfloat)p1->t * (GLfloat)p1->z;
+		p2->sz = (GLfloat)p2->s * (GLfloat)p2->z;
+		p2->tz = (GLfloat)p2->t * (GLfloat)p2->z;
+		d1 = p1->sz - p0->sz;
+		d2 = p2->sz - p0->sz;
+		dszdx = (fdy2 * d1 - fdy1 * d2);
+		dszdy = (fdx1 * d2 - fdx2 * d1);
+		d1 = p1->tz - p0->tz;
+		d2 = p2->tz - p0->tz;
+		dtzdx = (fdy2 * d1 - fdy1 * d2);
+		dtzdy = (fdx1 * d2 - fdx2 * d1);
+#endif
+	}
+
+#if TGL_FEATURE_HIERARCHICAL_Z == 1 && defined(INTERP_Z)
+	/* skip triangles which are entirely behind what's already drawn, then blocks which are */
+	if (zbdt && zb->hiz_min) {
+		hs_hiz_z = ZB_hizTriangleDepth(p0, p1, p2, dzdx, dzdy);
+		if (ZB_hizTriangleOccluded(zb, p0, p1, p2, hs_hiz_z))
+			return;
+	}
+#endif
+
+	DRAW_INIT();
+
+	for (hs_by = hs_ymin & ~(HS_BLOCK - 1); hs_by <= hs_ymax; hs_by += HS_BLOCK) {
+		for (hs_bx = hs_xmin & ~(HS_BLOCK - 1); hs_bx <= hs_xmax; hs_bx += HS_BLOCK) {
+			GLint e0, e1, e2, hs_row, full;
+			GLuint colmask;
+			e0 = hs_a[0] * hs_bx + hs_b[0] * hs_by + hs_c[0];
+			e1 = hs_a[1] * hs_bx + hs_b[1] * hs_by + hs_c[1];
+			e2 = hs_a[2] * hs_bx + hs_b[2] * hs_by + hs_c[2];
+			/* trivial reject */
+			if (e0 + hs_acc[0] < 0 || e1 + hs_acc[1] < 0 || e2 + hs_acc[2] < 0)
+				continue;
+#if TGL_FEATURE_HIERARCHICAL_Z == 1 && defined(INTERP_Z)
+			if (hs_hiz_z <= 0xffff &&
+				ZB_hizOccluded(zb, (hs_bx > hs_xmin) ? hs_bx : hs_xmin, (hs_by > hs_ymin) ? hs_by : hs_ymin,
+							   (hs_bx + HS_BLOCK - 1 < hs_xmax) ? hs_bx + HS_BLOCK - 1 : hs_xmax,
+							   (hs_by + HS_BLOCK - 1 < hs_ymax) ? hs_by + HS_BLOCK - 1 : hs_ymax, hs_hiz_z, 0))
+				continue;
+#endif
+			/* columns of this block inside of the clipped bounding box */
+			{
+				GLint lo = hs_xmin - hs_bx, hi = hs_xmax - hs_bx;
+				if (lo < 0)
+					lo = 0;
+				if (hi > HS_BLOCK - 1)
+					hi = HS_BLOCK - 1;
+				colmask = ((0xFFu >> (HS_BLOCK - 1 - hi)) & (0xFFu << lo)) & 0xFFu;
+			}
+			/* trivial accept */
+			full = (e0 + hs_rej[0] >= 0 && e1 + hs_rej[1] >= 0 && e2 + hs_rej[2] >= 0 && colmask == 0xFFu && hs_by >= hs_ymin &&
+					hs_by + HS_BLOCK - 1 <= hs_ymax);
+
+			for (hs_row = 0; hs_row < HS_BLOCK; hs_row++) {
+				GLint hs_y = hs_by + hs_row;
+				GLint first, last;
+				if (hs_y < hs_ymin)
+					continue;
+				if (hs_y > hs_ymax)
+					break;
+				if (full) {
+					first = 0;
+					last = HS_BLOCK - 1;
+				} else {
+					GLuint m = colmask & hs_row_mask(e0 + hs_row * hs_b[0], e1 + hs_row * hs_b[1], e2 + hs_row * hs_b[2], hs_steps);
+					if (m == 0)
+						continue;
+					first = hs_first_bit(m);
+					last = hs_last_bit(m);
+				}
+				/* draw the run first..last of this row */
+				{
+#if TGL_FEATURE_RENDER_BITS == 1
+					register GLint pp;
+#else
+					register PIXEL* pp;
+#endif
+					register GLint n;
+					GLint hs_x = hs_bx + first;
+#ifdef INTERP_Z
+					register GLushort* pz;
+					register GLuint z;
+#endif
+#if TGL_FEATURE_RENDER_BITS == 1
+					pp1 = zb->xsize * hs_y;
+#else
+					pp1 = (PIXEL*)(zb->pbuf) + zb->xsize * hs_y;
+#endif
+#if TGL_FEATURE_POLYGON_STIPPLE == 1
+					the_y = hs_y;
+#endif
+					n = last - first;
+#if TGL_FEATURE_HIERARCHICAL_Z == 1 && defined(INTERP_Z)
+					if (zbdw && zb->hiz_min)
+						ZB_hizSpanWritten(zb, hs_x, hs_x + n, hs_y, zbdt);
+#endif
+					pp = pp1 + hs_x;
+#ifdef INTERP_Z
+					pz = zb->zbuf + zb->xsize * hs_y + hs_x;
+					z = hs_z0 + (GLuint)hs_x * (GLuint)dzdx + (GLuint)hs_y * (GLuint)dzdy;
+#endif
+#ifdef INTERP_STZ
+					{
+						register GLuint s, t;
+						GLint r1, g1, b1;
+						GLfloat sz, tz, fzl, zinv;
+						r1 = (GLint)(hs_r0 + (GLuint)hs_x * (GLuint)drdx + (GLuint)hs_y * (GLuint)drdy);
+						g1 = (GLint)(hs_g0 + (GLuint)hs_x * (GLuint)dgdx + (GLuint)hs_y * (GLuint)dgdy);
+						b1 = (GLint)(hs_b0 + (GLuint)hs_x * (GLuint)dbdx + (GLuint)hs_y * (GLuint)dbdy);
+						{
+							OR1OG1OB1DECL
+							fzl = (GLfloat)(GLint)z;
+							zinv = 1.0 / fzl;
+							sz = p0->sz + (hs_x - p0->x) * dszdx + (hs_y - p0->y) * dszdy;
+							tz = p0->tz + (hs_x - p0->x) * dtzdx + (hs_y - p0->y) * dtzdy;
+							while (n >= (NB_INTERP - 1)) {
+								register GLint dsdx, dtdx;
+								DRAW_LINE_TRI_TEXTURED_ST()
+								fzl += fndzdx;
+								zinv = 1.0 / fzl;
+								PUT_PIXEL(0);
+								PUT_PIXEL(1);
+								PUT_PIXEL(2);
+								PUT_PIXEL(3);
+								PUT_PIXEL(4);
+								PUT_PIXEL(5);
+								PUT_PIXEL(6);
+								PUT_PIXEL(7);
+								pz += NB_INTERP;
+								pp += NB_INTERP;
+								n -= NB_INTERP;
+								sz += ndszdx;
+								tz += ndtzdx;
+							}
+							{
+								register GLint dsdx, dtdx;
+								DRAW_LINE_TRI_TEXTURED_ST()
+								while (n >= 0) {
+									PUT_PIXEL(0);
+									pz += 1;
+									pp++;
+									n -= 1;
+								}
+							}
+						}
+					}
+#else
+					{
+#ifdef INTERP_RGB
+						register GLint or1, og1, ob1;
+						or1 = (GLint)(hs_r0 + (GLuint)hs_x * (GLuint)drdx + (GLuint)hs_y * (GLuint)drdy);
+						og1 = (GLint)(hs_g0 + (GLuint)hs_x * (GLuint)dgdx + (GLuint)hs_y * (GLuint)dgdy);
+						ob1 = (GLint)(hs_b0 + (GLuint)hs_x * (GLuint)dbdx + (GLuint)hs_y * (GLuint)dbdy);
+#endif
+#ifdef DRAW_SPAN
+						DRAW_SPAN(hs_x, hs_y);
+#else
+						while (n >= 3) {
+							PUT_PIXEL(0);
+							PUT_PIXEL(1);
+							PUT_PIXEL(2);
+							PUT_PIXEL(3);
+#ifdef INTERP_Z
+							pz += 4;
+#endif
+							pp += 4;
+							n -= 4;
+						}
+						while (n >= 0) {
+							PUT_PIXEL(0);
+#ifdef INTERP_Z
+							pz++;
+#endif
+							pp++;
+							n--;
+						}
+#endif
+					}
+#endif
+				}
+			}
+		}
+	}
+}